@@ -0,0 +1,77 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: helpers shared by the benchmarks and examples
+ last mod: $Id$
+
+ ********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sys/time.h>
+#endif
+
+double now(void){
+#ifdef _WIN32
+  LARGE_INTEGER t,f;
+  QueryPerformanceCounter(&t);
+  QueryPerformanceFrequency(&f);
+  return (double)t.QuadPart/f.QuadPart;
+#else
+  struct timeval tv;
+  gettimeofday(&tv,NULL);
+  return tv.tv_sec+tv.tv_usec*1e-6;
+#endif
+}
+
+float *load_wav(const char *name,long *samples){
+  FILE *f=fopen(name,"rb");
+  unsigned char buf[4096];
+  float *pcm=NULL;
+  long size=0,got=0,i;
+  int founddata=0;
+
+  if(!f)return NULL;
+
+  /* skip to the data chunk, as encoder_example does */
+  for(i=0;i<30 && fread(buf,1,2,f)==2;i++){
+    if(!strncmp((char *)buf,"da",2)){
+      founddata=1;
+      if(fread(buf,1,6,f)!=6)founddata=0;
+      break;
+    }
+  }
+  if(!founddata){
+    fclose(f);
+    return NULL;
+  }
+
+  for(;;){
+    long bytes=fread(buf,1,sizeof(buf),f);
+    if(bytes<4)break;
+    if(got+bytes/2>size){
+      size=(got+bytes/2)*2;
+      pcm=realloc(pcm,size*sizeof(*pcm));
+    }
+    for(i=0;i+1<bytes;i+=2)
+      pcm[got++]=((signed char)buf[i+1]*256+buf[i])/32768.f;
+  }
+  fclose(f);
+  *samples=got/2;
+  return pcm;
+}
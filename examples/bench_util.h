@@ -0,0 +1,28 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: helpers shared by the benchmarks and examples
+ last mod: $Id$
+
+ ********************************************************************/
+
+#ifndef _V_BENCH_UTIL_H_
+#define _V_BENCH_UTIL_H_
+
+/* wall clock time in seconds, from an arbitrary origin */
+extern double now(void);
+
+/* reads a stereo 16 bit WAV file as encoder_example takes into
+   interleaved floats; returns NULL if it cannot be read */
+extern float *load_wav(const char *name,long *samples);
+
+#endif
@@ -0,0 +1,242 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: comment query benchmark, scan vs. hash index
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: comment_bench [-n iterations] [file.ogg...]
+
+   Looks up a catalogue's worth of tags (some present, some not, in
+   mixed case) in each file's comments, as an ingest pass does: the
+   match count of every tag, then every match.  Without files, a
+   synthetic set of comments typical of a tagged album track is used.
+
+   Three passes are timed:
+
+   - a scan that builds the "TAG=" string with malloc() on every
+     query, as vorbis_comment_query() and vorbis_comment_query_count()
+     used to;
+   - vorbis_comment_query() and vorbis_comment_query_count();
+   - vorbis_comment_index_init(), the same queries through
+     vorbis_comment_index_query() and _query_count(), and
+     vorbis_comment_index_clear(); the build is counted in the time.
+
+   Times are nanoseconds per query.  The passes are checked to give
+   the same answers. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "vorbis/codec.h"
+#include "vorbis/vorbisfile.h"
+#include "bench_util.h"
+
+static const char *tags[]={
+  "TITLE","artist","Album","ALBUMARTIST","TRACKNUMBER","TRACKTOTAL",
+  "DISCNUMBER","DATE","GENRE","COMPOSER","PERFORMER","CONDUCTOR",
+  "LABEL","ISRC","COPYRIGHT","LICENSE","DESCRIPTION","COMMENT",
+  "LYRICS","LANGUAGE","REPLAYGAIN_TRACK_GAIN","replaygain_track_peak",
+  "REPLAYGAIN_ALBUM_GAIN","REPLAYGAIN_ALBUM_PEAK","MUSICBRAINZ_TRACKID",
+  "MUSICBRAINZ_ALBUMID","MUSICBRAINZ_ARTISTID","BARCODE","CATALOGNUMBER",
+  "ENCODER","ENCODED_BY","METADATA_BLOCK_PICTURE"
+};
+#define TAGS (int)(sizeof(tags)/sizeof(*tags))
+
+static void synthetic(vorbis_comment *vc){
+  static const char *c[]={
+    "TITLE=Movement II: Adagio","ARTIST=Some Orchestra","ARTIST=A Soloist",
+    "ALBUM=Concertos","AlbumArtist=Some Orchestra","TRACKNUMBER=2",
+    "TRACKTOTAL=9","DATE=1998","GENRE=Classical","composer=A Composer",
+    "PERFORMER=A Soloist (violin)","PERFORMER=Some Orchestra",
+    "CONDUCTOR=A Conductor","LABEL=A Label","ISRC=XX0009800002",
+    "COPYRIGHT=(c) 1998 A Label","REPLAYGAIN_TRACK_GAIN=-3.21 dB",
+    "REPLAYGAIN_TRACK_PEAK=0.98","REPLAYGAIN_ALBUM_GAIN=-4.02 dB",
+    "REPLAYGAIN_ALBUM_PEAK=0.99",
+    "MUSICBRAINZ_TRACKID=0b0f57c6-4fe4-4b4b-bf7a-0c9a1b5e3f2d",
+    "MUSICBRAINZ_ALBUMID=6e2a7b1a-2b7f-4b8e-9b0c-0d1f2e3a4b5c",
+    "MUSICBRAINZ_ARTISTID=1f2e3d4c-5b6a-4978-8695-a4b3c2d1e0f9",
+    "BARCODE=0123456789012","ENCODER=an encoder",
+    "COMMENT=Recorded live","COMMENT=Remastered"
+  };
+  int i;
+  vorbis_comment_init(vc);
+  for(i=0;i<(int)(sizeof(c)/sizeof(*c));i++)
+    vorbis_comment_add(vc,c[i]);
+}
+
+/* the query as it was before it stopped allocating */
+static int old_tagcompare(const char *s1, const char *s2, int n){
+  int c=0;
+  while(c < n){
+    if(toupper(s1[c]) != toupper(s2[c]))
+      return !0;
+    c++;
+  }
+  return 0;
+}
+
+static char *old_query(vorbis_comment *vc, const char *tag, int count){
+  long i;
+  int found = 0;
+  int taglen = strlen(tag)+1;
+  char *fulltag = malloc(taglen+1);
+
+  strcpy(fulltag, tag);
+  strcat(fulltag, "=");
+
+  for(i=0;i<vc->comments;i++){
+    if(!old_tagcompare(vc->user_comments[i], fulltag, taglen)){
+      if(count == found) {
+        free(fulltag);
+        return vc->user_comments[i] + taglen;
+      } else {
+        found++;
+      }
+    }
+  }
+  free(fulltag);
+  return NULL;
+}
+
+static int old_query_count(vorbis_comment *vc, const char *tag){
+  int i,count=0;
+  int taglen = strlen(tag)+1;
+  char *fulltag = malloc(taglen+1);
+  strcpy(fulltag,tag);
+  strcat(fulltag, "=");
+
+  for(i=0;i<vc->comments;i++){
+    if(!old_tagcompare(vc->user_comments[i], fulltag, taglen))
+      count++;
+  }
+
+  free(fulltag);
+  return count;
+}
+
+#define PASS_OLD   0
+#define PASS_SCAN  1
+#define PASS_INDEX 2
+#define PASSES     3
+
+static const char *pass_name[PASSES]={
+  "malloc + scan (previous)",
+  "vorbis_comment_query",
+  "index (build included)"
+};
+
+/* one ingest of vc; returns the number of queries, and a checksum of
+   the answers in *sum */
+static long ingest(vorbis_comment *vc,int pass,unsigned long *sum){
+  vorbis_comment_index vci;
+  long queries=0;
+  int i,j,n;
+
+  if(pass==PASS_INDEX && vorbis_comment_index_init(&vci,vc))return -1;
+  for(i=0;i<TAGS;i++){
+    switch(pass){
+    case PASS_OLD:
+      n=old_query_count(vc,tags[i]);
+      break;
+    case PASS_SCAN:
+      n=vorbis_comment_query_count(vc,tags[i]);
+      break;
+    default:
+      n=vorbis_comment_index_query_count(&vci,tags[i]);
+      break;
+    }
+    queries++;
+    for(j=0;j<n;j++){
+      char *v;
+      switch(pass){
+      case PASS_OLD:
+        v=old_query(vc,tags[i],j);
+        break;
+      case PASS_SCAN:
+        v=vorbis_comment_query(vc,tags[i],j);
+        break;
+      default:
+        v=vorbis_comment_index_query(&vci,tags[i],j);
+        break;
+      }
+      queries++;
+      *sum=*sum*31+(v?(unsigned char)v[0]+1:0);
+      *sum=*sum*31+(v && v[0]?(unsigned char)v[1]:0);
+    }
+    *sum=*sum*31+n;
+  }
+  if(pass==PASS_INDEX)vorbis_comment_index_clear(&vci);
+  return queries;
+}
+
+static int bench(const char *name,vorbis_comment *vc,int iterations){
+  unsigned long sum[PASSES];
+  int p,i;
+
+  printf("%s: %d comments\n",name,vc->comments);
+  for(p=0;p<PASSES;p++){
+    double t;
+    long queries=0;
+    sum[p]=0;
+    t=now();
+    for(i=0;i<iterations;i++){
+      unsigned long s=0;
+      long q=ingest(vc,p,&s);
+      if(q<0)return -1;
+      queries+=q;
+      sum[p]=s;
+    }
+    t=now()-t;
+    printf("  %-26s %10.1f ns/query\n",pass_name[p],t/queries*1e9);
+  }
+  for(p=1;p<PASSES;p++)
+    if(sum[p]!=sum[0]){
+      fprintf(stderr,"%s: %s gives different answers\n",name,pass_name[p]);
+      return -1;
+    }
+  return 0;
+}
+
+int main(int argc,char **argv){
+  int iterations=20000,files=0,i;
+
+  for(i=1;i<argc;i++){
+    OggVorbis_File vf;
+    if(!strcmp(argv[i],"-n") && i+1<argc){
+      iterations=atoi(argv[++i]);
+      if(iterations<1)iterations=1;
+      continue;
+    }
+    if(ov_fopen(argv[i],&vf)<0){
+      fprintf(stderr,"Unable to open %s as a Vorbis file\n",argv[i]);
+      continue;
+    }
+    if(bench(argv[i],ov_comment(&vf,0),iterations)){
+      ov_clear(&vf);
+      return 1;
+    }
+    ov_clear(&vf);
+    files++;
+  }
+
+  if(files==0){
+    vorbis_comment vc;
+    synthetic(&vc);
+    i=bench("synthetic",&vc,iterations);
+    vorbis_comment_clear(&vc);
+    if(i)return 1;
+  }
+  return 0;
+}
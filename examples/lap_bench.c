@@ -0,0 +1,167 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: seek+splice latency benchmark for the lapping functions
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: lap_bench [-n iterations] file.ogg [next.ogg]
+
+   Plays a little of the first file, then jumps to a pseudo-random
+   position with each seek flavour and reads the first samples after
+   the jump.  Each pass is timed per iteration:
+
+   - ov_pcm_seek(), the plain seek, as the baseline;
+   - ov_pcm_seek_lap() and ov_time_seek_lap(), which splice the
+     outgoing audio onto the new position;
+   - ov_crosslap() from the first file into the second (or into a
+     second handle on the same file), as a playlist does when it
+     moves to the next track, after an ov_pcm_seek() of the
+     second file.
+
+   The difference between a lap pass and the baseline is the cost of
+   the splice itself.  Times are wall clock averages in microseconds
+   from just before the seek to the first samples read after it. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "vorbis/codec.h"
+#include "vorbis/vorbisfile.h"
+#include "bench_util.h"
+
+#define PASS_SEEK     0
+#define PASS_PCMLAP   1
+#define PASS_TIMELAP  2
+#define PASS_CROSSLAP 3
+#define PASSES        4
+
+static const char *pass_name[PASSES]={
+  "ov_pcm_seek",
+  "ov_pcm_seek_lap",
+  "ov_time_seek_lap",
+  "ov_pcm_seek+ov_crosslap"
+};
+
+/* the same positions for every pass */
+static unsigned long lcg;
+
+static double next_fraction(void){
+  lcg=lcg*1664525UL+1013904223UL;
+  return ((lcg>>8)&0xffffff)/16777216.;
+}
+
+static int run(OggVorbis_File *vf,OggVorbis_File *next,int pass,
+               int iterations,double *seconds){
+  ogg_int64_t total=ov_pcm_total(vf,-1);
+  ogg_int64_t nexttotal=ov_pcm_total(next,-1);
+  double timetotal=ov_time_total(vf,-1);
+  float **pcm;
+  int i,ret=0;
+
+  lcg=1;
+  *seconds=0;
+  for(i=0;i<iterations;i++){
+    double f=next_fraction(),t;
+
+    /* a little playback, so that there is something to lap from */
+    if(ov_read_float(vf,&pcm,1024,NULL)<0)return -1;
+
+    t=now();
+    switch(pass){
+    case PASS_SEEK:
+      ret=ov_pcm_seek(vf,(ogg_int64_t)(f*total));
+      break;
+    case PASS_PCMLAP:
+      ret=ov_pcm_seek_lap(vf,(ogg_int64_t)(f*total));
+      break;
+    case PASS_TIMELAP:
+      ret=ov_time_seek_lap(vf,f*timetotal);
+      break;
+    case PASS_CROSSLAP:
+      ret=ov_pcm_seek(next,(ogg_int64_t)(f*nexttotal));
+      if(!ret)ret=ov_crosslap(vf,next);
+      break;
+    }
+    if(ret)return ret;
+    if(ov_read_float(pass==PASS_CROSSLAP?next:vf,&pcm,1024,NULL)<0)
+      return -1;
+    *seconds+=now()-t;
+
+    /* the playlist moves back to the first file for the next jump */
+    if(pass==PASS_CROSSLAP &&
+       ov_pcm_seek(vf,(ogg_int64_t)(next_fraction()*total)))
+      return -1;
+  }
+  return 0;
+}
+
+int main(int argc,char **argv){
+  OggVorbis_File vf,next;
+  const char *name=NULL,*nextname=NULL;
+  int iterations=1000,i;
+
+  for(i=1;i<argc;i++){
+    if(!strcmp(argv[i],"-n") && i+1<argc){
+      iterations=atoi(argv[++i]);
+      if(iterations<1)iterations=1;
+    }else if(!name)
+      name=argv[i];
+    else
+      nextname=argv[i];
+  }
+  if(!name){
+    fprintf(stderr,"usage: lap_bench [-n iterations] file.ogg [next.ogg]\n");
+    return 1;
+  }
+  if(!nextname)nextname=name;
+
+  if(ov_fopen(name,&vf)<0){
+    fprintf(stderr,"Unable to open %s as a Vorbis file\n",name);
+    return 1;
+  }
+  if(ov_fopen(nextname,&next)<0){
+    fprintf(stderr,"Unable to open %s as a Vorbis file\n",nextname);
+    ov_clear(&vf);
+    return 1;
+  }
+  if(!ov_seekable(&vf) || !ov_seekable(&next)){
+    fprintf(stderr,"Both files must be seekable\n");
+    ov_clear(&next);
+    ov_clear(&vf);
+    return 1;
+  }
+
+  printf("%s -> %s, %d iterations\n",name,nextname,iterations);
+  printf("  %-24s %12s %12s\n","pass","usec","splice usec");
+  {
+    double base=0;
+    for(i=0;i<PASSES;i++){
+      double seconds;
+      if(run(&vf,&next,i,iterations,&seconds)){
+        fprintf(stderr,"%s failed\n",pass_name[i]);
+        break;
+      }
+      seconds=seconds/iterations*1e6;
+      if(i==PASS_SEEK){
+        base=seconds;
+        printf("  %-24s %12.1f %12s\n",pass_name[i],seconds,"-");
+      }else
+        printf("  %-24s %12.1f %12.1f\n",pass_name[i],seconds,seconds-base);
+    }
+  }
+
+  ov_clear(&next);
+  ov_clear(&vf);
+  return 0;
+}
@@ -0,0 +1,213 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: link switch cost of an unseekable chained stream
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: link_bench [-n iterations] chained.ogg
+
+   Plays a chained file through as an unseekable stream from memory,
+   as a live ingest of internet radio with a link per song does, and
+   times the reads that cross into a new link (reading its headers
+   and readying the decoder for it) apart from the others:
+
+   - ov_read_float(), decoding;
+   - ov_read_packet(), taking the packets as they are.
+
+   Times are wall clock averages in microseconds.  The switch cost is
+   that of a crossing read over that of a plain one.  A link with the
+   same setup as the one before it keeps the decoder, so links are
+   counted apart by whether their id header matches the last one's,
+   which is as near as an application can tell the setups apart. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "vorbis/codec.h"
+#include "vorbis/vorbisfile.h"
+#include "bench_util.h"
+
+/* an unseekable stream from memory */
+typedef struct {
+  unsigned char *data;
+  long bytes;
+  long pos;
+} stream;
+
+static size_t read_func(void *ptr,size_t size,size_t nmemb,void *datasource){
+  stream *s=datasource;
+  long n=size*nmemb;
+  if(n>s->bytes-s->pos)n=s->bytes-s->pos;
+  memcpy(ptr,s->data+s->pos,n);
+  s->pos+=n;
+  return n/size;
+}
+
+#define PASS_DECODE 0
+#define PASS_PACKET 1
+#define PASSES      2
+
+static const char *pass_name[PASSES]={
+  "ov_read_float",
+  "ov_read_packet"
+};
+
+typedef struct {
+  double read;        /* seconds in reads within a link */
+  long   reads;
+  double same;        /* seconds in reads crossing to a link with the
+                         id header of the one before */
+  long   sames;
+  double other;       /* and to one with a different setup */
+  long   others;
+} timing;
+
+/* the id header fields to compare links by */
+typedef struct {
+  int  channels;
+  long rate;
+  long bitrate_nominal;
+  long blocksizes[2];
+} id;
+
+static void id_get(OggVorbis_File *vf,id *d){
+  vorbis_info *vi=ov_info(vf,-1);
+  memset(d,0,sizeof(*d)); /* padding, for memcmp() */
+  d->channels=vi->channels;
+  d->rate=vi->rate;
+  d->bitrate_nominal=vi->bitrate_nominal;
+  d->blocksizes[0]=vorbis_info_blocksize(vi,0);
+  d->blocksizes[1]=vorbis_info_blocksize(vi,1);
+}
+
+static int run(stream *s,int pass,timing *t){
+  ov_callbacks callbacks={read_func,NULL,NULL,NULL};
+  OggVorbis_File vf;
+  id last;
+  int link=0;
+  double pending=0;
+
+  s->pos=0;
+  if(ov_open_callbacks(s,&vf,NULL,0,callbacks))return -1;
+  id_get(&vf,&last);
+
+  while(1){
+    double t0=now();
+    long ret;
+    int bitstream=link;
+
+    if(pass==PASS_DECODE){
+      float **pcm;
+      ret=ov_read_float(&vf,&pcm,1024,&bitstream);
+    }else{
+      ogg_packet op;
+      ret=ov_read_packet(&vf,&op,NULL,NULL,&bitstream);
+    }
+    t0=now()-t0;
+    if(ret==0)break;
+    if(ret==OV_HOLE){
+      /* a hole is counted with the read that follows it */
+      pending+=t0;
+      continue;
+    }
+    if(ret<0){
+      ov_clear(&vf);
+      return -1;
+    }
+    t0+=pending;
+    pending=0;
+
+    if(bitstream!=link){
+      id next;
+      id_get(&vf,&next);
+      if(!memcmp(&next,&last,sizeof(next))){
+        t->same+=t0;
+        t->sames++;
+      }else{
+        t->other+=t0;
+        t->others++;
+      }
+      last=next;
+      link=bitstream;
+    }else{
+      t->read+=t0;
+      t->reads++;
+    }
+  }
+  ov_clear(&vf);
+  return 0;
+}
+
+int main(int argc,char **argv){
+  const char *name=NULL;
+  int iterations=20,i,p;
+  stream s;
+  FILE *f;
+
+  for(i=1;i<argc;i++){
+    if(!strcmp(argv[i],"-n") && i+1<argc){
+      iterations=atoi(argv[++i]);
+      if(iterations<1)iterations=1;
+    }else
+      name=argv[i];
+  }
+  if(!name){
+    fprintf(stderr,"usage: link_bench [-n iterations] chained.ogg\n");
+    return 1;
+  }
+
+  f=fopen(name,"rb");
+  if(!f){
+    fprintf(stderr,"Unable to open %s\n",name);
+    return 1;
+  }
+  fseek(f,0,SEEK_END);
+  s.bytes=ftell(f);
+  fseek(f,0,SEEK_SET);
+  s.data=malloc(s.bytes);
+  if(!s.data || fread(s.data,1,s.bytes,f)!=(size_t)s.bytes){
+    fprintf(stderr,"Unable to read %s\n",name);
+    fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  printf("%s, %d iterations\n",name,iterations);
+  printf("  %-16s %8s %10s %12s %12s\n","pass","links","read",
+         "switch same","switch other");
+  for(p=0;p<PASSES;p++){
+    timing t;
+    double read;
+    memset(&t,0,sizeof(t));
+    for(i=0;i<iterations;i++)
+      if(run(&s,p,&t)){
+        fprintf(stderr,"%s failed\n",pass_name[p]);
+        free(s.data);
+        return 1;
+      }
+    read=(t.reads?t.read/t.reads*1e6:0);
+    printf("  %-16s %8ld %10.2f",pass_name[p],
+           (t.sames+t.others)/iterations+1,read);
+    if(t.sames)
+      printf(" %12.1f",t.same/t.sames*1e6-read);
+    else
+      printf(" %12s","-");
+    if(t.others)
+      printf(" %12.1f\n",t.other/t.others*1e6-read);
+    else
+      printf(" %12s\n","-");
+  }
+  free(s.data);
+  return 0;
+}
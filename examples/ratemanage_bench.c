@@ -0,0 +1,184 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: bitrate management lookahead benchmark
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: ratemanage_bench [file.wav]
+
+   Encodes the same audio in bitrate managed ABR and CBR modes with
+   each OV_ECTL_RATEMANAGE_LOOKAHEAD_SET setting and prints, for each:
+   the average bitrate and its deviation from the target, the mean
+   and standard deviation of the bitrate over one second windows, and
+   the number of packetblobs the encoder coded per packet it used.  The
+   input is a stereo 16 bit 44.1kHz WAV file as encoder_example takes;
+   without one, 30 seconds of synthetic audio that alternates between
+   sparse tones and dense noise are used, which is hard on a rate
+   manager.  Encoding is to memory and the packets are only counted. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vorbis/vorbisenc.h>
+#include "bench_util.h"
+
+#define RATE 44100
+#define TARGET 96 /* kbps */
+
+static float *synth(long *samples){
+  long n=RATE*30,i;
+  float *pcm=malloc(n*2*sizeof(*pcm));
+  unsigned long lcg=1;
+
+  for(i=0;i<n;i++){
+    double t=(double)i/RATE;
+    /* a few seconds of each, with uneven lengths */
+    int dense=((long)(t*.7+sin(t*.3))&1);
+    float noise;
+    lcg=lcg*1664525UL+1013904223UL;
+    noise=((lcg>>8)&0xffff)/32768.f-1.f;
+    if(dense){
+      pcm[i*2]=.2f*noise+.1f*sin(2.*M_PI*880.*t);
+      pcm[i*2+1]=.2f*noise*(1.+sin(2.*M_PI*3.*t))*.5f;
+    }else{
+      pcm[i*2]=.3f*sin(2.*M_PI*440.*t)+.01f*noise;
+      pcm[i*2+1]=.3f*sin(2.*M_PI*660.*t)+.01f*noise;
+    }
+  }
+  *samples=n;
+  return pcm;
+}
+
+typedef struct {
+  double kbps;
+  double window_mean;
+  double window_sd;
+  double blobs;
+} rate_stats;
+
+/* returns 0 on success */
+static int encode(const float *pcm,long samples,int cbr,int lookahead,
+                  rate_stats *rs){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op,header,header_comm,header_code;
+  long pos=0,bytes=0,window=0,windowbits=0;
+  double sum=0.,sumsq=0.;
+
+  vorbis_info_init(&vi);
+  if(vorbis_encode_setup_managed(&vi,2,RATE,cbr?TARGET*1000:-1,
+                                 TARGET*1000,cbr?TARGET*1000:-1) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_RATEMANAGE_LOOKAHEAD_SET,&lookahead) ||
+     vorbis_encode_setup_init(&vi)){
+    vorbis_info_clear(&vi);
+    return -1;
+  }
+  vorbis_comment_init(&vc);
+
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  vorbis_analysis_headerout(&vd,&vc,&header,&header_comm,&header_code);
+
+  for(;;){
+    if(pos<samples){
+      long n=samples-pos,i;
+      float **buffer;
+      if(n>1024)n=1024;
+      buffer=vorbis_analysis_buffer(&vd,n);
+      for(i=0;i<n;i++){
+        buffer[0][i]=pcm[(pos+i)*2];
+        buffer[1][i]=pcm[(pos+i)*2+1];
+      }
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else
+      vorbis_analysis_wrote(&vd,0);
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        bytes+=op.bytes;
+
+        /* one second windows by granulepos; the partial last one is
+           left out */
+        while(op.granulepos>=(window+1)*(ogg_int64_t)RATE){
+          double kbps=windowbits/1000.;
+          sum+=kbps;
+          sumsq+=kbps*kbps;
+          windowbits=0;
+          window++;
+        }
+        windowbits+=op.bytes*8;
+
+        if(op.e_o_s)goto done;
+      }
+    }
+  }
+
+ done:
+  {
+    ogg_int64_t coded,used;
+    vorbis_bitrate_blobstats(&vd,&coded,&used);
+    rs->blobs=(used?(double)coded/used:0.);
+  }
+  rs->kbps=bytes*8./samples*RATE/1000.;
+  rs->window_mean=(window?sum/window:0.);
+  rs->window_sd=(window?sqrt(sumsq/window-rs->window_mean*rs->window_mean):0.);
+
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  return 0;
+}
+
+int main(int argc,char **argv){
+  static const int lookahead[]={0,4,16,64,256};
+  long samples=0;
+  float *pcm;
+  int cbr,l;
+
+  if(argc>1){
+    pcm=load_wav(argv[1],&samples);
+    if(!pcm || samples==0){
+      fprintf(stderr,"Unable to read %s as a 16 bit stereo WAV file\n",argv[1]);
+      return 1;
+    }
+  }else
+    pcm=synth(&samples);
+
+  printf("%.1f seconds of stereo %dHz, target %dkbps\n\n",
+         (double)samples/RATE,RATE,TARGET);
+  printf("mode  lookahead     kbps  deviation   1s mean   1s stddev   blobs\n");
+
+  for(cbr=0;cbr<2;cbr++){
+    for(l=0;l<(int)(sizeof(lookahead)/sizeof(*lookahead));l++){
+      rate_stats rs;
+      printf("%-4s  %9d",cbr?"CBR":"ABR",lookahead[l]);
+      if(encode(pcm,samples,cbr,lookahead[l],&rs))
+        printf("   failed\n");
+      else
+        printf(" %8.1f %9.2f%% %9.1f %11.2f %7.2f\n",rs.kbps,
+               (rs.kbps-TARGET)*100./TARGET,rs.window_mean,rs.window_sd,
+               rs.blobs);
+    }
+  }
+
+  free(pcm);
+  return 0;
+}
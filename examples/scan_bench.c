@@ -0,0 +1,160 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: duration scan throughput benchmark
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: scan_bench [-n iterations] file.ogg...
+
+   Finds the length of every link of each file, as a catalogue ingest
+   does, three ways:
+
+   - ov_fopen() and ov_pcm_total(), which bisect for the end of each
+     link and unpack the setup of the first;
+   - a page walk through ogg_sync_pageout(), which checksums every
+     page; it only finds the last granulepos of each stream, not the
+     exact length;
+   - ov_scan(), which looks at page headers only.
+
+   Times are per pass over all the files, with the throughput in MB of
+   file per second.  ov_scan() is checked to give the lengths
+   ov_pcm_total() does. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "vorbis/codec.h"
+#include "vorbis/vorbisfile.h"
+#include "bench_util.h"
+
+#define MAXLINKS 4096
+
+#define PASS_OPEN  0
+#define PASS_WALK  1
+#define PASS_SCAN  2
+#define PASSES     3
+
+static const char *pass_name[PASSES]={
+  "ov_fopen+ov_pcm_total",
+  "ogg_sync page walk",
+  "ov_scan"
+};
+
+static ov_scan_link links[MAXLINKS];
+
+static int walk(const char *name){
+  ogg_sync_state oy;
+  ogg_page og;
+  ogg_int64_t granulepos=-1;
+  FILE *f=fopen(name,"rb");
+
+  if(!f)return -1;
+  ogg_sync_init(&oy);
+  while(1){
+    char *buffer=ogg_sync_buffer(&oy,65536);
+    long bytes=fread(buffer,1,65536,f);
+    if(bytes<=0)break;
+    ogg_sync_wrote(&oy,bytes);
+    while(ogg_sync_pageout(&oy,&og)>0)
+      if(ogg_page_granulepos(&og)!=-1)
+        granulepos=ogg_page_granulepos(&og);
+  }
+  ogg_sync_clear(&oy);
+  fclose(f);
+  return (granulepos<0?-1:0);
+}
+
+static int run(char **names,int files,int pass){
+  int i;
+  for(i=0;i<files;i++){
+    OggVorbis_File vf;
+    long j;
+
+    switch(pass){
+    case PASS_OPEN:
+      if(ov_fopen(names[i],&vf))return -1;
+      for(j=0;j<ov_streams(&vf);j++)
+        ov_pcm_total(&vf,j);
+      ov_clear(&vf);
+      break;
+    case PASS_WALK:
+      if(walk(names[i]))return -1;
+      break;
+    case PASS_SCAN:
+      if(ov_scan(names[i],links,MAXLINKS)<=0)return -1;
+      break;
+    }
+  }
+  return 0;
+}
+
+/* the scan against what ov_open() finds */
+static int check(const char *name){
+  OggVorbis_File vf;
+  long n=ov_scan(name,links,MAXLINKS),i;
+  int ret=0;
+
+  if(n<=0 || ov_fopen(name,&vf))return -1;
+  if(n!=ov_streams(&vf))ret=-1;
+  for(i=0;!ret && i<n && i<MAXLINKS;i++)
+    if(links[i].pcmlength!=ov_pcm_total(&vf,i) ||
+       links[i].serialno!=ov_serialnumber(&vf,i))ret=-1;
+  ov_clear(&vf);
+  return ret;
+}
+
+int main(int argc,char **argv){
+  char **names=malloc(argc*sizeof(*names));
+  int iterations=20,files=0,i,p;
+  double bytes=0;
+
+  for(i=1;i<argc;i++){
+    if(!strcmp(argv[i],"-n") && i+1<argc){
+      iterations=atoi(argv[++i]);
+      if(iterations<1)iterations=1;
+    }else
+      names[files++]=argv[i];
+  }
+  if(!files){
+    fprintf(stderr,"usage: scan_bench [-n iterations] file.ogg...\n");
+    return 1;
+  }
+
+  for(i=0;i<files;i++){
+    FILE *f=fopen(names[i],"rb");
+    if(!f || check(names[i])){
+      fprintf(stderr,"%s: ov_scan() and ov_open() disagree\n",names[i]);
+      return 1;
+    }
+    fseek(f,0,SEEK_END);
+    bytes+=ftell(f);
+    fclose(f);
+  }
+
+  printf("%d files, %d iterations\n",files,iterations);
+  printf("  %-24s %12s %12s\n","pass","ms/pass","MB/s");
+  for(p=0;p<PASSES;p++){
+    double t=now();
+    for(i=0;i<iterations;i++)
+      if(run(names,files,p)){
+        fprintf(stderr,"%s failed\n",pass_name[p]);
+        return 1;
+      }
+    t=now()-t;
+    printf("  %-24s %12.3f %12.1f\n",pass_name[p],t/iterations*1e3,
+           bytes*iterations/t/1e6);
+  }
+  free(names);
+  return 0;
+}
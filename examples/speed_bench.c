@@ -0,0 +1,153 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: encoder speed setting benchmark (speed vs. bitrate)
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: speed_bench [file.wav]
+
+   Encodes the same audio at each quality level with each
+   OV_ECTL_SPEED_SET setting and prints a table of encode speed (as a
+   multiple of realtime) and average bitrate.  The input is a stereo
+   16 bit 44.1kHz WAV file as encoder_example takes; without one, 20
+   seconds of synthetic tones over noise are used.  Encoding is to
+   memory and the packets are only counted. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vorbis/vorbisenc.h>
+#include "bench_util.h"
+
+#define RATE 44100
+#define SPEEDS 3
+
+static float *synth(long *samples){
+  long n=RATE*20,i;
+  float *pcm=malloc(n*2*sizeof(*pcm));
+  unsigned long lcg=1;
+
+  for(i=0;i<n;i++){
+    double t=(double)i/RATE;
+    float noise;
+    lcg=lcg*1664525UL+1013904223UL;
+    noise=((lcg>>8)&0xffff)/32768.f-1.f;
+    pcm[i*2]=.3f*sin(2.*M_PI*440.*t)+.1f*sin(2.*M_PI*3520.*t)+
+      .05f*noise*(1.+sin(2.*M_PI*.5*t));
+    pcm[i*2+1]=.3f*sin(2.*M_PI*554.4*t)+.1f*sin(2.*M_PI*6000.*t)+
+      .05f*noise*(1.+cos(2.*M_PI*.5*t));
+  }
+  *samples=n;
+  return pcm;
+}
+
+/* returns the encoded size in bytes, or -1 */
+static long encode(const float *pcm,long samples,float quality,int speed,
+                   double *seconds){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op,header,header_comm,header_code;
+  long pos=0,bytes=0;
+  double t;
+
+  vorbis_info_init(&vi);
+  if(vorbis_encode_setup_vbr(&vi,2,RATE,quality) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_SPEED_SET,&speed) ||
+     vorbis_encode_setup_init(&vi)){
+    vorbis_info_clear(&vi);
+    return -1;
+  }
+  vorbis_comment_init(&vc);
+
+  t=now();
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  vorbis_analysis_headerout(&vd,&vc,&header,&header_comm,&header_code);
+  bytes+=header.bytes+header_comm.bytes+header_code.bytes;
+
+  for(;;){
+    if(pos<samples){
+      long n=samples-pos,i;
+      float **buffer;
+      if(n>1024)n=1024;
+      buffer=vorbis_analysis_buffer(&vd,n);
+      for(i=0;i<n;i++){
+        buffer[0][i]=pcm[(pos+i)*2];
+        buffer[1][i]=pcm[(pos+i)*2+1];
+      }
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else
+      vorbis_analysis_wrote(&vd,0);
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        bytes+=op.bytes;
+        if(op.e_o_s)goto done;
+      }
+    }
+  }
+
+ done:
+  *seconds=now()-t;
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  return bytes;
+}
+
+int main(int argc,char **argv){
+  static const float quality[]={-.1f,0.f,.2f,.4f,.6f,.8f,1.f};
+  long samples=0;
+  float *pcm;
+  double duration;
+  int q,s;
+
+  if(argc>1){
+    pcm=load_wav(argv[1],&samples);
+    if(!pcm || samples==0){
+      fprintf(stderr,"Unable to read %s as a 16 bit stereo WAV file\n",argv[1]);
+      return 1;
+    }
+  }else
+    pcm=synth(&samples);
+  duration=(double)samples/RATE;
+
+  printf("%.1f seconds of stereo %dHz\n\n",duration,RATE);
+  printf("quality");
+  for(s=0;s<SPEEDS;s++)printf("   speed %d x rt   kbps",s);
+  printf("\n");
+
+  for(q=0;q<(int)(sizeof(quality)/sizeof(*quality));q++){
+    printf("%7.1f",quality[q]*10);
+    for(s=0;s<SPEEDS;s++){
+      double seconds;
+      long bytes=encode(pcm,samples,quality[q],s,&seconds);
+      if(bytes<0)
+        printf("   %19s","failed");
+      else
+        printf("   %12.1f %6.1f",duration/seconds,bytes*8/duration/1000.);
+    }
+    printf("\n");
+  }
+
+  free(pcm);
+  return 0;
+}
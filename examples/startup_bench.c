@@ -0,0 +1,343 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: time-to-first-PCM benchmark, broken down by startup phase
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: startup_bench [-n iterations] file.ogg [file.ogg...]
+
+   Each file is read into memory once and opened repeatedly.  Two
+   passes are timed per iteration:
+
+   - the startup path of vorbisfile is replayed with the same libogg
+     and libvorbis calls it makes, so that page sync, the header
+     fetch of _fetch_headers(), the codebook unpack in
+     vorbis_synthesis_headerin(), _vds_shared_init() (through
+     vorbis_synthesis_init()) and the first decode can be timed one
+     by one;
+
+   - ov_test_callbacks()/ov_test_open()/ov_read() are run through
+     counting callbacks, which times the _open_seekable2() bisection
+     and the end to end latency from open to the first sample.
+
+   Times are wall clock averages in microseconds; bytes are those
+   handed to the sync layer or returned by the read callback. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "vorbis/codec.h"
+#include "vorbis/vorbisfile.h"
+#include "bench_util.h"
+
+#define PHASE_SYNC    0
+#define PHASE_HEADERS 1
+#define PHASE_BOOKS   2
+#define PHASE_INIT    3
+#define PHASE_BISECT  4
+#define PHASE_DECODE  5
+#define PHASE_TOTAL   6
+#define PHASES        7
+
+static const char *phase_name[PHASES]={
+  "page sync",
+  "_fetch_headers",
+  "headerin book unpack",
+  "_vds_shared_init",
+  "_open_seekable2 bisect",
+  "first decode",
+  "open to first sample"
+};
+
+typedef struct {
+  double seconds[PHASES];
+  double bytes[PHASES];
+  double seeks;
+} phase_times;
+
+/* in-memory datasource with read accounting ************************/
+
+typedef struct {
+  const unsigned char *data;
+  long size;
+  long pos;
+  long bytes;
+  long seeks;
+} memfile;
+
+static size_t mem_read(void *ptr,size_t size,size_t nmemb,void *datasource){
+  memfile *m=datasource;
+  long want=size*nmemb;
+  if(want>m->size-m->pos)want=m->size-m->pos;
+  memcpy(ptr,m->data+m->pos,want);
+  m->pos+=want;
+  m->bytes+=want;
+  return want/size;
+}
+
+static int mem_seek(void *datasource,ogg_int64_t offset,int whence){
+  memfile *m=datasource;
+  switch(whence){
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset+=m->pos;
+    break;
+  case SEEK_END:
+    offset+=m->size;
+    break;
+  default:
+    return -1;
+  }
+  if(offset<0 || offset>m->size)return -1;
+  if(offset!=m->pos)m->seeks++;
+  m->pos=offset;
+  return 0;
+}
+
+static long mem_tell(void *datasource){
+  memfile *m=datasource;
+  return m->pos;
+}
+
+static ov_callbacks mem_callbacks={
+  mem_read,
+  mem_seek,
+  NULL,
+  mem_tell
+};
+
+/* replay of the vorbisfile startup path, phase by phase ************/
+
+#define READSIZE 2048 /* the read size _get_data() uses */
+
+static int feed(ogg_sync_state *oy,memfile *m){
+  long bytes=m->size-m->pos;
+  char *buffer;
+  if(bytes<=0)return 0;
+  if(bytes>READSIZE)bytes=READSIZE;
+  buffer=ogg_sync_buffer(oy,bytes);
+  memcpy(buffer,m->data+m->pos,bytes);
+  ogg_sync_wrote(oy,bytes);
+  m->pos+=bytes;
+  return 1;
+}
+
+static int replay(const unsigned char *data,long size,phase_times *pt){
+  ogg_sync_state   oy;
+  ogg_stream_state os;
+  ogg_page         og;
+  ogg_packet       op;
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  memfile m;
+  int headers=0,ret=-1,streaminit=0,dspinit=0;
+  double t,unpack=0;
+  long mark;
+
+  memset(&m,0,sizeof(m));
+  m.data=data;
+  m.size=size;
+  ogg_sync_init(&oy);
+  vorbis_info_init(&vi);
+  vorbis_comment_init(&vc);
+
+  /* page sync: capture the first page */
+  t=now();
+  while(ogg_sync_pageout(&oy,&og)<=0)
+    if(!feed(&oy,&m))goto done;
+  pt->seconds[PHASE_SYNC]+=now()-t;
+  pt->bytes[PHASE_SYNC]+=m.pos;
+  mark=m.pos;
+
+  /* header fetch, less the time spent inside headerin */
+  t=now();
+  ogg_stream_init(&os,ogg_page_serialno(&og));
+  streaminit=1;
+  ogg_stream_pagein(&os,&og);
+  while(headers<3){
+    int result=ogg_stream_packetout(&os,&op);
+    if(result>0){
+      double u=now();
+      if(vorbis_synthesis_headerin(&vi,&vc,&op))goto done;
+      /* the setup header is the codebook unpack */
+      if(headers==2)unpack+=now()-u;
+      headers++;
+      continue;
+    }
+    if(result<0)goto done;
+    while(ogg_sync_pageout(&oy,&og)<=0)
+      if(!feed(&oy,&m))goto done;
+    ogg_stream_pagein(&os,&og);
+  }
+  pt->seconds[PHASE_HEADERS]+=now()-t-unpack;
+  pt->seconds[PHASE_BOOKS]+=unpack;
+  pt->bytes[PHASE_HEADERS]+=m.pos-mark;
+  mark=m.pos;
+
+  t=now();
+  if(vorbis_synthesis_init(&vd,&vi))goto done;
+  vorbis_block_init(&vd,&vb);
+  dspinit=1;
+  pt->seconds[PHASE_INIT]+=now()-t;
+
+  /* decode until the first samples come out */
+  t=now();
+  for(;;){
+    float **pcm;
+    int result=ogg_stream_packetout(&os,&op);
+    if(result>0){
+      if(vorbis_synthesis(&vb,&op)==0)
+        vorbis_synthesis_blockin(&vd,&vb);
+      if(vorbis_synthesis_pcmout(&vd,&pcm)>0)break;
+      continue;
+    }
+    while(ogg_sync_pageout(&oy,&og)<=0)
+      if(!feed(&oy,&m))goto done;
+    ogg_stream_pagein(&os,&og);
+  }
+  pt->seconds[PHASE_DECODE]+=now()-t;
+  pt->bytes[PHASE_DECODE]+=m.pos-mark;
+  ret=0;
+
+ done:
+  if(dspinit){
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+  }
+  if(streaminit)ogg_stream_clear(&os);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  ogg_sync_clear(&oy);
+  return ret;
+}
+
+/* the same file through vorbisfile *********************************/
+
+static int through_vorbisfile(const unsigned char *data,long size,
+                              phase_times *pt){
+  OggVorbis_File vf;
+  memfile m;
+  char pcm[4096];
+  double t0,t;
+  long mark,seeks;
+  int bs;
+
+  memset(&m,0,sizeof(m));
+  m.data=data;
+  m.size=size;
+
+  t0=now();
+  if(ov_test_callbacks(&m,&vf,NULL,0,mem_callbacks))return -1;
+  mark=m.bytes;
+  seeks=m.seeks;
+
+  t=now();
+  if(ov_test_open(&vf)){
+    ov_clear(&vf);
+    return -1;
+  }
+  pt->seconds[PHASE_BISECT]+=now()-t;
+  pt->bytes[PHASE_BISECT]+=m.bytes-mark;
+  pt->seeks+=m.seeks-seeks;
+
+  if(ov_read(&vf,pcm,sizeof(pcm),0,2,1,&bs)<=0){
+    ov_clear(&vf);
+    return -1;
+  }
+  pt->seconds[PHASE_TOTAL]+=now()-t0;
+  pt->bytes[PHASE_TOTAL]+=m.bytes;
+
+  ov_clear(&vf);
+  return 0;
+}
+
+static void report(const char *name,phase_times *pt,int n){
+  int i;
+  printf("%s\n",name);
+  printf("  %-24s %12s %12s\n","phase","usec","bytes");
+  for(i=0;i<PHASES;i++){
+    if(i==PHASE_INIT)
+      printf("  %-24s %12.1f %12s\n",phase_name[i],
+             pt->seconds[i]/n*1e6,"-");
+    else
+      printf("  %-24s %12.1f %12.0f\n",phase_name[i],
+             pt->seconds[i]/n*1e6,pt->bytes[i]/n);
+  }
+  printf("  %-24s %12.1f\n","bisection seeks",pt->seeks/n);
+}
+
+int main(int argc,char **argv){
+  phase_times corpus;
+  int iterations=100,files=0,i,j;
+
+  memset(&corpus,0,sizeof(corpus));
+
+  for(i=1;i<argc;i++){
+    FILE *f;
+    unsigned char *data;
+    long size;
+    phase_times pt;
+
+    if(!strcmp(argv[i],"-n") && i+1<argc){
+      iterations=atoi(argv[++i]);
+      if(iterations<1)iterations=1;
+      continue;
+    }
+
+    f=fopen(argv[i],"rb");
+    if(!f){
+      fprintf(stderr,"Unable to open %s\n",argv[i]);
+      continue;
+    }
+    fseek(f,0,SEEK_END);
+    size=ftell(f);
+    fseek(f,0,SEEK_SET);
+    data=malloc(size>0?size:1);
+    if(fread(data,1,size,f)!=(size_t)size){
+      fprintf(stderr,"Short read on %s\n",argv[i]);
+      fclose(f);
+      free(data);
+      continue;
+    }
+    fclose(f);
+
+    memset(&pt,0,sizeof(pt));
+    for(j=0;j<iterations;j++){
+      if(replay(data,size,&pt) || through_vorbisfile(data,size,&pt)){
+        fprintf(stderr,"%s is not a usable Vorbis file\n",argv[i]);
+        break;
+      }
+    }
+    if(j==iterations){
+      report(argv[i],&pt,iterations);
+      for(j=0;j<PHASES;j++){
+        corpus.seconds[j]+=pt.seconds[j]/iterations;
+        corpus.bytes[j]+=pt.bytes[j]/iterations;
+      }
+      corpus.seeks+=pt.seeks/iterations;
+      files++;
+    }
+    free(data);
+  }
+
+  if(files==0){
+    fprintf(stderr,"usage: startup_bench [-n iterations] file.ogg [file.ogg...]\n");
+    return 1;
+  }
+  if(files>1)report("corpus average",&corpus,files);
+  return 0;
+}
@@ -0,0 +1,221 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: two pass encoding to a target file size
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* usage: twopass_example kbps file.wav [stats] > file.ogg
+
+   Encodes a stereo 16 bit 44.1kHz WAV file (as encoder_example takes)
+   in two passes so that the Ogg file comes out at the given average
+   bitrate.  The first pass writes its statistics to the stats file
+   (twopass.stats by default); the second pass reads them back, as a
+   separate run would.  The first pass output is only used to estimate
+   the Ogg page overhead, which is taken off the target handed to the
+   second pass. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vorbis/vorbisenc.h>
+#include "bench_util.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#define RATE 44100
+
+typedef struct {
+  long file_bytes;   /* whole Ogg file */
+  long header_bytes; /* the three header packets */
+  long audio_bytes;  /* the audio packets */
+} sizes;
+
+/* one pass.  The first pass returns its statistics in *stats, the
+   second writes the stream to out.  Returns 0 on success. */
+static int encode(const float *pcm,long samples,long kbps,int pass,
+                  ogg_int64_t target,void **stats,long *stats_bytes,
+                  FILE *out,sizes *sz){
+  ogg_stream_state os;
+  ogg_page         og;
+  ogg_packet       op;
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  struct ovectl_twopass_arg tp;
+  long pos=0;
+  int eos=0;
+
+  memset(sz,0,sizeof(*sz));
+  memset(&tp,0,sizeof(tp));
+  tp.pass=pass;
+  tp.target_bytes=target;
+  if(pass==2){
+    tp.stats=*stats;
+    tp.stats_bytes=*stats_bytes;
+  }
+
+  /* the nominal bitrate picks the quality steps the passes choose
+     from; the reservoir based management itself is not used */
+  vorbis_info_init(&vi);
+  if(vorbis_encode_setup_managed(&vi,2,RATE,-1,kbps*1000,-1) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_RATEMANAGE2_SET,NULL) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_TWOPASS_SET,&tp) ||
+     vorbis_encode_setup_init(&vi)){
+    vorbis_info_clear(&vi);
+    return -1;
+  }
+  vorbis_comment_init(&vc);
+  vorbis_comment_add_tag(&vc,"ENCODER","twopass_example.c");
+
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  ogg_stream_init(&os,1);
+
+  {
+    ogg_packet header,header_comm,header_code;
+    vorbis_analysis_headerout(&vd,&vc,&header,&header_comm,&header_code);
+    ogg_stream_packetin(&os,&header);
+    ogg_stream_packetin(&os,&header_comm);
+    ogg_stream_packetin(&os,&header_code);
+    sz->header_bytes=header.bytes+header_comm.bytes+header_code.bytes;
+    while(ogg_stream_flush(&os,&og)){
+      if(out){
+        fwrite(og.header,1,og.header_len,out);
+        fwrite(og.body,1,og.body_len,out);
+      }
+      sz->file_bytes+=og.header_len+og.body_len;
+    }
+  }
+
+  while(!eos){
+    if(pos<samples){
+      long n=samples-pos,i;
+      float **buffer;
+      if(n>1024)n=1024;
+      buffer=vorbis_analysis_buffer(&vd,n);
+      for(i=0;i<n;i++){
+        buffer[0][i]=pcm[(pos+i)*2];
+        buffer[1][i]=pcm[(pos+i)*2+1];
+      }
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else
+      vorbis_analysis_wrote(&vd,0);
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        sz->audio_bytes+=op.bytes;
+        ogg_stream_packetin(&os,&op);
+        while(ogg_stream_pageout(&os,&og)){
+          if(out){
+            fwrite(og.header,1,og.header_len,out);
+            fwrite(og.body,1,og.body_len,out);
+          }
+          sz->file_bytes+=og.header_len+og.body_len;
+          if(ogg_page_eos(&og))eos=1;
+        }
+      }
+    }
+  }
+
+  /* the statistics are fetched before the dsp state goes away */
+  if(pass==1){
+    *stats_bytes=vorbis_bitrate_twopass_stats(&vd,NULL,0);
+    *stats=malloc(*stats_bytes);
+    vorbis_bitrate_twopass_stats(&vd,*stats,*stats_bytes);
+  }
+
+  ogg_stream_clear(&os);
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  return 0;
+}
+
+int main(int argc,char **argv){
+  const char *statsname=argc>3?argv[3]:"twopass.stats";
+  long samples=0,kbps,stats_bytes;
+  ogg_int64_t target,audio_target;
+  void *stats;
+  float *pcm;
+  sizes first,second;
+  FILE *f;
+
+  if(argc<3 || (kbps=atol(argv[1]))<=0){
+    fprintf(stderr,"usage: twopass_example kbps file.wav [stats] > file.ogg\n");
+    return 1;
+  }
+  pcm=load_wav(argv[2],&samples);
+  if(!pcm || samples==0){
+    fprintf(stderr,"Unable to read %s as a 16 bit stereo WAV file\n",argv[2]);
+    return 1;
+  }
+
+#ifdef _WIN32
+  _setmode( _fileno( stdout ), _O_BINARY );
+#endif
+
+  /* first pass; save the statistics */
+  if(encode(pcm,samples,kbps,1,0,&stats,&stats_bytes,NULL,&first)){
+    fprintf(stderr,"Encoder setup failed\n");
+    return 1;
+  }
+  f=fopen(statsname,"wb");
+  if(!f || fwrite(stats,1,stats_bytes,f)!=(size_t)stats_bytes){
+    fprintf(stderr,"Unable to write %s\n",statsname);
+    return 1;
+  }
+  fclose(f);
+  free(stats);
+
+  /* ...and load them again for the second */
+  f=fopen(statsname,"rb");
+  if(!f){
+    fprintf(stderr,"Unable to read %s\n",statsname);
+    return 1;
+  }
+  stats=malloc(stats_bytes);
+  stats_bytes=fread(stats,1,stats_bytes,f);
+  fclose(f);
+
+  /* the target covers the audio packets only, so take off the
+     headers and the page overhead seen in the first pass */
+  target=(ogg_int64_t)samples*kbps*1000/8/RATE;
+  audio_target=target-(first.file_bytes-first.audio_bytes);
+  if(audio_target<=0 ||
+     encode(pcm,samples,kbps,2,audio_target,&stats,&stats_bytes,stdout,
+            &second)){
+    fprintf(stderr,"Second pass failed\n");
+    return 1;
+  }
+
+  fprintf(stderr,"first pass:  %ld bytes (%ld audio)\n",
+          first.file_bytes,first.audio_bytes);
+  fprintf(stderr,"target:      %ld bytes (%ld audio)\n",
+          (long)target,(long)audio_target);
+  fprintf(stderr,"second pass: %ld bytes (%ld audio), %+.3f%%\n",
+          second.file_bytes,second.audio_bytes,
+          (second.file_bytes-target)*100./target);
+
+  free(stats);
+  free(pcm);
+  return 0;
+}
@@ -147,6 +147,16 @@ typedef struct vorbis_comment{
 
 } vorbis_comment;
 
+/* vorbis_comment_index is a case-insensitive hash index of the tags of
+   a vorbis_comment, for repeated queries; the comments must not change
+   while it is in use */
+typedef struct vorbis_comment_index{
+  vorbis_comment *vc;
+  int            *slots; /* per slot: first comment with the tag + 1, count */
+  int            *next;  /* per comment: next comment with the tag + 1 */
+  int             mask;
+} vorbis_comment_index;
+
 
 /* libvorbis encodes in two abstraction layers; first we perform DSP
    and produce a packet (see docs/analysis.txt).  The packet is then
@@ -172,6 +182,13 @@ extern void     vorbis_comment_add_tag(vorbis_comment *vc,
 extern char    *vorbis_comment_query(vorbis_comment *vc, const char *tag, int count);
 extern int      vorbis_comment_query_count(vorbis_comment *vc, const char *tag);
 extern void     vorbis_comment_clear(vorbis_comment *vc);
+extern int      vorbis_comment_index_init(vorbis_comment_index *vci,
+                                          vorbis_comment *vc);
+extern char    *vorbis_comment_index_query(vorbis_comment_index *vci,
+                                           const char *tag, int count);
+extern int      vorbis_comment_index_query_count(vorbis_comment_index *vci,
+                                                 const char *tag);
+extern void     vorbis_comment_index_clear(vorbis_comment_index *vci);
 
 extern int      vorbis_block_init(vorbis_dsp_state *v, vorbis_block *vb);
 extern int      vorbis_block_clear(vorbis_block *vb);
@@ -194,21 +211,39 @@ extern float  **vorbis_analysis_buffer(vorbis_dsp_state *v,int vals);
 extern int      vorbis_analysis_wrote(vorbis_dsp_state *v,int vals);
 extern int      vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb);
 extern int      vorbis_analysis(vorbis_block *vb,ogg_packet *op);
+extern long     vorbis_analysis_delay(vorbis_dsp_state *v);
+extern int      vorbis_analysis_prime(vorbis_dsp_state *v,float **history,
+                                      int vals,ogg_int64_t granulepos);
+extern int      vorbis_analysis_splice(vorbis_dsp_state *v,float **lookahead,
+                                       int vals);
+extern int      vorbis_analysis_join(vorbis_info *vi,ogg_packet *last,
+                                     ogg_packet *first);
 
 extern int      vorbis_bitrate_addblock(vorbis_block *vb);
 extern int      vorbis_bitrate_flushpacket(vorbis_dsp_state *vd,
                                            ogg_packet *op);
+extern int      vorbis_bitrate_blobstats(vorbis_dsp_state *vd,
+                                         ogg_int64_t *coded,
+                                         ogg_int64_t *used);
+extern long     vorbis_bitrate_twopass_stats(vorbis_dsp_state *vd,
+                                             void *buffer,long bytes);
 
 /* Vorbis PRIMITIVES: synthesis layer *******************************/
 extern int      vorbis_synthesis_idheader(ogg_packet *op);
 extern int      vorbis_synthesis_headerin(vorbis_info *vi,vorbis_comment *vc,
                                           ogg_packet *op);
+extern int      vorbis_synthesis_headerskim(vorbis_info *vi,vorbis_comment *vc,
+                                            ogg_packet *op);
+extern int      vorbis_synthesis_unload(vorbis_info *vi);
 
 extern int      vorbis_synthesis_init(vorbis_dsp_state *v,vorbis_info *vi);
 extern int      vorbis_synthesis_restart(vorbis_dsp_state *v);
 extern int      vorbis_synthesis(vorbis_block *vb,ogg_packet *op);
 extern int      vorbis_synthesis_trackonly(vorbis_block *vb,ogg_packet *op);
 extern int      vorbis_synthesis_blockin(vorbis_dsp_state *v,vorbis_block *vb);
+extern int      vorbis_synthesis_batch(vorbis_dsp_state *v,vorbis_block *vb,
+                                       ogg_packet *op,int packets,
+                                       float **pcm,int samples,int *consumed);
 extern int      vorbis_synthesis_pcmout(vorbis_dsp_state *v,float ***pcm);
 extern int      vorbis_synthesis_lapout(vorbis_dsp_state *v,float ***pcm);
 extern int      vorbis_synthesis_read(vorbis_dsp_state *v,int samples);
@@ -289,6 +289,25 @@ struct ovectl_ratemanage2_arg {
   double bitrate_average_damping;
 };
 
+/**
+ * \name struct ovectl_twopass_arg
+ *
+ * The ovectl_twopass_arg structure is used with vorbis_encode_ctl() and
+ * the OV_ECTL_TWOPASS_GET and OV_ECTL_TWOPASS_SET calls to configure
+ * two pass encoding to a target size.
+ *
+*/
+struct ovectl_twopass_arg {
+  int    pass;          /**< 0 for single pass encoding, or 1 or 2 */
+/** Second pass only: total size in bytes of the audio packets */
+  ogg_int64_t target_bytes;
+/** Second pass only: the statistics returned after the first pass by
+ *  vorbis_bitrate_twopass_stats().  They are copied by the call.
+ */
+  const void *stats;
+  long   stats_bytes;   /**< Size of the statistics in bytes */
+};
+
 
 /**
  * \name vorbis_encode_ctl() codes
@@ -323,6 +342,33 @@ struct ovectl_ratemanage2_arg {
 */
 #define OV_ECTL_RATEMANAGE2_SET      0x15
 
+/**
+ * Returns the current bitrate management lookahead, in blocks, in the
+ * int pointed to by arg.
+ *
+ * Argument: <tt>int *</tt>
+*/
+#define OV_ECTL_RATEMANAGE_LOOKAHEAD_GET 0x16
+
+/**
+ * Sets the bitrate management lookahead to the number of blocks pointed
+ * to by arg.
+ *
+ * Argument: <tt>int *</tt>
+ *
+ * Valid range is 0 [default] to 1024.  With a lookahead of N, the
+ * average bitrate tracker holds back N blocks and chooses the quality
+ * of each block so that the window of N+1 blocks meets the average
+ * target, instead of reacting to each block as it comes.  Blocks count
+ * for less the further ahead they are, and those more than about a
+ * tenth of a second ahead hardly at all, so lookaheads past 16 or so
+ * add delay without changing the result.  This lowers the bitrate
+ * swing from block to block at the cost of N blocks of additional
+ * delay in vorbis_bitrate_flushpacket().  Only affects bitrate managed
+ * modes.
+ */
+#define OV_ECTL_RATEMANAGE_LOOKAHEAD_SET 0x17
+
 /**
  * Returns the current encoder hard-lowpass setting (kHz) in the double
  * pointed to by arg.
@@ -378,6 +424,86 @@ struct ovectl_ratemanage2_arg {
  */
 #define OV_ECTL_COUPLING_SET         0x41
 
+/**
+ *  Returns the current encoder speed setting in the int pointed to by
+ *  arg.
+ *
+ * Argument: <tt>int *</tt>
+*/
+#define OV_ECTL_SPEED_GET            0x50
+
+/**
+ *  Sets the encoder speed setting to the value pointed to by arg.
+ *
+ * Argument: <tt>int *</tt>
+ *
+ *  Valid range is 0 [default] to 2.  Higher settings encode faster by
+ *  replacing analysis stages with cheaper approximations, at some cost
+ *  in quality for a given bitrate: 1 estimates the tonal spectrum from
+ *  the MDCT rather than running a separate FFT, 2 also drops tone
+ *  masking in favor of the absolute threshold of hearing.  The default
+ *  setting produces the same bitstream as previous releases.
+ */
+#define OV_ECTL_SPEED_SET            0x51
+
+/**
+ *  Returns the current encoder low latency setting in the int pointed
+ *  to by arg.
+ *
+ * Argument: <tt>int *</tt>
+*/
+#define OV_ECTL_LOWLATENCY_GET       0x60
+
+/**
+ *  Enables/disables low latency encoding according to arg.
+ *
+ * Argument: <tt>int *</tt>
+ *
+ *  Zero [default] disables low latency encoding, nonzero enables it.
+ *  In low latency mode the encoder uses only the short blocksize, so
+ *  vorbis_analysis_blockout() waits for a fixed lookahead of about one
+ *  short block instead of the variable lookahead the long block
+ *  decision needs, and the encoder's PCM buffers are allocated once
+ *  by vorbis_analysis_init().  The stream is still a normal Vorbis I
+ *  stream, but short blocks code tonal material poorly: in VBR mode at
+ *  quality 4 the bitrate grows by about half on pure tones and up to
+ *  about three times on music.  vorbis_analysis_delay() reports the
+ *  resulting delay.
+ */
+#define OV_ECTL_LOWLATENCY_SET       0x61
+
+/**
+ * Returns the current two pass encoding settings.
+ *
+ * Argument: <tt>struct ovectl_twopass_arg *</tt>
+ *
+ * The stats pointer returned refers to the encoder's own copy.
+*/
+#define OV_ECTL_TWOPASS_GET          0x70
+
+/**
+ * Sets up two pass encoding to a target size.
+ *
+ * Argument: <tt>struct ovectl_twopass_arg *</tt>
+ *
+ *  In the first pass (pass 1) the encoder codes every block at each
+ *  of the bitrate management quality steps and records their sizes;
+ *  vorbis_bitrate_twopass_stats() returns them once the stream is
+ *  encoded.  The second pass (pass 2) encodes the same audio with the
+ *  same settings, choosing the quality step of each block from those
+ *  statistics so that the audio packets total target_bytes.  If the
+ *  target lies within the range the steps cover, it is met exactly;
+ *  the last packet is padded to make up the remainder.  The blocks are
+ *  split between the two adjacent steps that bracket the target, spread
+ *  evenly through the stream; bits are not moved to the passages that
+ *  need them most.  Should the second pass's blocks stop matching the
+ *  first pass's, the rest of the stream is coded at the lower of the
+ *  two steps and the target is not padded up to.  Passing a NULL
+ *  pointer or pass 0 [default] disables two pass encoding.  Any bitrate
+ *  management settings are ignored while two pass encoding is on.
+ */
+#define OV_ECTL_TWOPASS_SET          0x71
+
   /* deprecated rate management supported only for compatibility */
 
 /**
@@ -143,25 +143,80 @@ typedef struct OggVorbis_File {
 
   ov_callbacks callbacks;
 
+  /* chained files: link setups are unpacked on entry, and at most
+     link_cache of them (see ov_link_cache()) are kept */
+  int              link_cache;
+  ogg_int64_t     *link_used;
+  ogg_int64_t      link_clock;
+
+  /* seekable files: where pages met while seeking and decoding lie,
+     to narrow later seeks (see ov_page_cache_stats()) */
+  ogg_int64_t     *page_cache;
+  long             page_cache_count;
+  long             page_cache_hits;
+  long             page_cache_misses;
+
+  /* lapping data held across a lap seek (see ov_pcm_seek_lap()) */
+  float           *lap_pcm;
+  long             lap_size;
+
+  /* comments longer than comment_limit bytes are left in the file; a
+     (link, comment, offset in header, length) quad records each (see
+     ov_comment_fetch()) */
+  long             comment_limit;
+  ogg_int64_t     *comment_skips;
+  long             comment_skip_count;
+
+  /* blocksize of the last packet ov_read_packet() returned; zero
+     after a restart, when the next packet completes no samples */
+  long             packet_blocksize;
+
+  /* streaming: the setup header of the current link, to tell whether
+     the next link can keep the decoder */
+  unsigned char   *link_setup;
+  long             link_setup_bytes;
+  long             link_setup_storage;
+
 } OggVorbis_File;
 
+/* a link of a stream as ov_scan() finds it */
+typedef struct {
+  long             serialno;
+  long             rate;
+  int              channels;
+  ogg_int64_t      offset;     /* of its first page; zero for the first link */
+  ogg_int64_t      dataoffset; /* of the first page after its headers */
+  ogg_int64_t      end;        /* just past its last page */
+  ogg_int64_t      pcmlength;  /* samples, as ov_pcm_total() gives */
+  long             bitrate;    /* average, from dataoffset to end */
+} ov_scan_link;
+
 
 extern int ov_clear(OggVorbis_File *vf);
 extern int ov_fopen(const char *path,OggVorbis_File *vf);
 extern int ov_open(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes);
 extern int ov_open_callbacks(void *datasource, OggVorbis_File *vf,
                 const char *initial, long ibytes, ov_callbacks callbacks);
+extern int ov_open_callbacks_limit(void *datasource, OggVorbis_File *vf,
+                const char *initial, long ibytes, ov_callbacks callbacks,
+                long comment_limit);
 
 extern int ov_test(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes);
 extern int ov_test_callbacks(void *datasource, OggVorbis_File *vf,
                 const char *initial, long ibytes, ov_callbacks callbacks);
 extern int ov_test_open(OggVorbis_File *vf);
 
+extern long ov_scan(const char *path,ov_scan_link *links,long n);
+extern long ov_scan_callbacks(void *datasource,ov_callbacks callbacks,
+                              ov_scan_link *links,long n);
+
 extern long ov_bitrate(OggVorbis_File *vf,int i);
 extern long ov_bitrate_instant(OggVorbis_File *vf);
 extern long ov_streams(OggVorbis_File *vf);
 extern long ov_seekable(OggVorbis_File *vf);
 extern long ov_serialnumber(OggVorbis_File *vf,int i);
+extern int ov_link_cache(OggVorbis_File *vf,int links);
+extern int ov_page_cache_stats(OggVorbis_File *vf,long *hits,long *misses);
 
 extern ogg_int64_t ov_raw_total(OggVorbis_File *vf,int i);
 extern ogg_int64_t ov_pcm_total(OggVorbis_File *vf,int i);
@@ -185,6 +240,8 @@ extern double ov_time_tell(OggVorbis_File *vf);
 
 extern vorbis_info *ov_info(OggVorbis_File *vf,int link);
 extern vorbis_comment *ov_comment(OggVorbis_File *vf,int link);
+extern long ov_comment_fetch(OggVorbis_File *vf,int link,int comment,
+                             char *buffer,long length);
 
 extern long ov_read_float(OggVorbis_File *vf,float ***pcm_channels,int samples,
                           int *bitstream);
@@ -193,6 +250,11 @@ extern long ov_read_filter(OggVorbis_File *vf,char *buffer,int length,
                           void (*filter)(float **pcm,long channels,long samples,void *filter_param),void *filter_param);
 extern long ov_read(OggVorbis_File *vf,char *buffer,int length,
                     int bigendianp,int word,int sgned,int *bitstream);
+extern int ov_read_ranges(OggVorbis_File *vf,const ogg_int64_t *ranges,int n,
+                          void (*callback)(int range,float **pcm,long channels,long samples,void *param),
+                          void *param);
+extern int ov_read_packet(OggVorbis_File *vf,ogg_packet *op,long *blocksize,
+                          long *samples,int *bitstream);
 extern int ov_crosslap(OggVorbis_File *vf1,OggVorbis_File *vf2);
 
 extern int ov_halfrate(OggVorbis_File *vf,int flag);
@@ -63,6 +63,14 @@ int vorbis_analysis(vorbis_block *vb, ogg_packet *op){
   return(0);
 }
 
+/* code packetblob blobno of a block vorbis_analysis() has run on, if
+   it isn't already */
+int _vorbis_analysis_blob(vorbis_block *vb,int blobno){
+  vorbis_block_internal *vbi=vb->internal;
+  if(vbi->blobcoded[blobno])return(0);
+  return(_mapping_P[0]->forward_blob(vb,blobno));
+}
+
 #ifdef ANALYSIS
 int analysis_noisy=1;
 
@@ -25,6 +25,113 @@
 #include "misc.h"
 #include "bitrate.h"
 
+/* two pass statistics: a header, then for each block its W flag, a
+   5 bit field width and the byte count of each packetblob */
+#define TWOPASS_MAGIC   0x7632704fL
+#define TWOPASS_VERSION 1
+
+/* checks first pass statistics against the stream setup and, given a
+   manager state, reads them into it */
+static int _twopass_unpack(vorbis_info *vi,const void *stats,long bytes,
+                           bitrate_manager_state *bm){
+  oggpack_buffer opb;
+  unsigned char *W=NULL;
+  long *sizes=NULL;
+  long blocks,i;
+  int k;
+
+  if(!stats || bytes<=0)return(OV_EINVAL);
+  oggpack_readinit(&opb,(unsigned char *)stats,bytes);
+  if(oggpack_read(&opb,32)!=TWOPASS_MAGIC ||
+     oggpack_read(&opb,8)!=TWOPASS_VERSION ||
+     oggpack_read(&opb,8)!=PACKETBLOBS ||
+     oggpack_read(&opb,8)!=vi->channels ||
+     oggpack_read(&opb,32)!=vi->rate)return(OV_EINVAL);
+
+  /* each block takes at least 6 bits plus a bit per packetblob */
+  blocks=oggpack_read(&opb,32);
+  if(blocks<=0 || blocks>bytes*8/(6+PACKETBLOBS))return(OV_EINVAL);
+
+  if(bm){
+    W=_ogg_malloc(blocks*sizeof(*W));
+    sizes=_ogg_malloc(blocks*PACKETBLOBS*sizeof(*sizes));
+  }
+  for(i=0;i<blocks;i++){
+    int w=oggpack_read(&opb,1);
+    int n=oggpack_read(&opb,5);
+    if(w<0 || n<=0)goto err_out;
+    for(k=0;k<PACKETBLOBS;k++){
+      long v=oggpack_read(&opb,n);
+      if(v<0)goto err_out;
+      if(sizes)sizes[i*PACKETBLOBS+k]=v;
+    }
+    if(W)W[i]=w;
+  }
+
+  if(bm){
+    bm->tp_W=W;
+    bm->tp_bytes=sizes;
+    bm->tp_blocks=bm->tp_storage=blocks;
+  }
+  return(0);
+
+ err_out:
+  if(W)_ogg_free(W);
+  if(sizes)_ogg_free(sizes);
+  return(OV_EINVAL);
+}
+
+int vorbis_bitrate_twopass_check(vorbis_info *vi,const void *stats,
+                                 long bytes){
+  return(_twopass_unpack(vi,stats,bytes,NULL));
+}
+
+/* second pass: take the largest packetblob that keeps the whole
+   stream within the target, then move blocks up to the next one,
+   spread evenly through the stream, while the remaining budget
+   lasts.  The plan only ever dithers between those two adjacent
+   levels; it does not spend bits where the audio needs them more. */
+static void _twopass_plan(bitrate_manager_state *bm){
+  ogg_int64_t total[PACKETBLOBS],budget;
+  long *sizes=bm->tp_bytes;
+  long i;
+  int k,c;
+
+  memset(total,0,sizeof(total));
+  for(i=0;i<bm->tp_blocks;i++)
+    for(k=0;k<PACKETBLOBS;k++)
+      total[k]+=sizes[i*PACKETBLOBS+k];
+
+  for(c=PACKETBLOBS-1;c>0 && total[c]>bm->tp_target;c--);
+  bm->tp_plan=_ogg_malloc(bm->tp_blocks*sizeof(*bm->tp_plan));
+  memset(bm->tp_plan,c,bm->tp_blocks*sizeof(*bm->tp_plan));
+  bm->tp_level=c;
+
+  /* a target above the largest packetblobs is not padded up to */
+  if(bm->tp_target>total[PACKETBLOBS-1])
+    bm->tp_target=total[PACKETBLOBS-1];
+  budget=bm->tp_target-total[c];
+
+  if(c+1<PACKETBLOBS && budget>0 && total[c+1]>total[c]){
+    double frac=(double)budget/(total[c+1]-total[c]);
+    double acc=0.;
+    int pass;
+
+    /* error diffusion; a second sweep uses up what the first left */
+    for(pass=0;pass<2;pass++)
+      for(i=0;i<bm->tp_blocks;i++){
+        long step=sizes[i*PACKETBLOBS+c+1]-sizes[i*PACKETBLOBS+c];
+        if(bm->tp_plan[i]!=c)continue;
+        acc+=frac;
+        if((pass || acc>=.5) && step<=budget){
+          bm->tp_plan[i]=c+1;
+          budget-=step;
+          acc-=1.;
+        }
+      }
+  }
+}
+
 /* compute bitrate tracking setup  */
 void vorbis_bitrate_init(vorbis_info *vi,bitrate_manager_state *bm){
   codec_setup_info *ci=vi->codec_setup;
@@ -32,6 +139,18 @@ void vorbis_bitrate_init(vorbis_info *vi,bitrate_manager_state *bm){
 
   memset(bm,0,sizeof(*bm));
 
+  if(bi && bi->twopass){
+    bm->twopass=bi->twopass;
+    bm->avgfloat=PACKETBLOBS/2;
+    bm->tp_level=PACKETBLOBS/2;
+    if(bi->twopass==2 &&
+       !_twopass_unpack(vi,bi->twopass_stats,bi->twopass_stats_bytes,bm)){
+      bm->tp_target=bi->twopass_target;
+      _twopass_plan(bm);
+    }
+    return;
+  }
+
   if(bi && (bi->reservoir_bits>0)){
     long ratesamples=vi->rate;
     int  halfsamples=ci->blocksizes[0]>>1;
@@ -53,10 +172,36 @@ void vorbis_bitrate_init(vorbis_info *vi,bitrate_manager_state *bm){
       bm->avg_reservoir=desired_fill;
     }
 
+    /* the lookahead holds the block being decided and the blocks
+       after it */
+    if(bi->lookahead>0){
+      int i,j;
+      bm->queue_size=bi->lookahead+1;
+      bm->queue=_ogg_calloc(bm->queue_size,sizeof(*bm->queue));
+      for(i=0;i<bm->queue_size;i++)
+        for(j=0;j<PACKETBLOBS;j++){
+          bm->queue[i].packetblob[j]=
+            _ogg_calloc(1,sizeof(*bm->queue[i].packetblob[j]));
+          oggpack_writeinit(bm->queue[i].packetblob[j]);
+        }
+    }
+
   }
 }
 
 void vorbis_bitrate_clear(bitrate_manager_state *bm){
+  int i,j;
+  if(bm->queue){
+    for(i=0;i<bm->queue_size;i++)
+      for(j=0;j<PACKETBLOBS;j++){
+        oggpack_writeclear(bm->queue[i].packetblob[j]);
+        _ogg_free(bm->queue[i].packetblob[j]);
+      }
+    _ogg_free(bm->queue);
+  }
+  if(bm->tp_W)_ogg_free(bm->tp_W);
+  if(bm->tp_bytes)_ogg_free(bm->tp_bytes);
+  if(bm->tp_plan)_ogg_free(bm->tp_plan);
   memset(bm,0,sizeof(*bm));
   return;
 }
@@ -66,77 +211,31 @@ int vorbis_bitrate_managed(vorbis_block *vb){
   private_state         *b=vd->backend_state;
   bitrate_manager_state *bm=&b->bms;
 
-  if(bm && bm->managed)return(1);
+  if(bm && (bm->managed || bm->twopass))return(1);
   return(0);
 }
 
-/* finish taking in the block we just processed */
-int vorbis_bitrate_addblock(vorbis_block *vb){
-  vorbis_block_internal *vbi=vb->internal;
-  vorbis_dsp_state      *vd=vb->vd;
-  private_state         *b=vd->backend_state;
-  bitrate_manager_state *bm=&b->bms;
-  vorbis_info           *vi=vd->vi;
-  codec_setup_info      *ci=vi->codec_setup;
-  bitrate_manager_info  *bi=&ci->bi;
+/* size of a packetblob in bits.  Those of a block still in the
+   application's hands (vb) are coded on first use; the manager
+   usually looks at only a few of them. */
+static long _bitrate_blob_bits(vorbis_block *vb,oggpack_buffer **packetblob,
+                               int k){
+  if(vb)_vorbis_analysis_blob(vb,k);
+  return(oggpack_bytes(packetblob[k])*8);
+}
 
-  int  choice=rint(bm->avgfloat);
-  long this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
-  long min_target_bits=(vb->W?bm->min_bitsper*bm->short_per_long:bm->min_bitsper);
-  long max_target_bits=(vb->W?bm->max_bitsper*bm->short_per_long:bm->max_bitsper);
-  int  samples=ci->blocksizes[vb->W]>>1;
+/* once the average tracker has picked a packetblob: enforce the
+   min/max reservoir limits, truncate or pad the packet if no blob
+   will do, and update the reservoirs.  Returns the final choice. */
+static int _bitrate_commit(bitrate_manager_state *bm,
+                           bitrate_manager_info *bi,
+                           vorbis_block *vb,
+                           oggpack_buffer **packetblob,
+                           int W,int choice){
+  long this_bits=_bitrate_blob_bits(vb,packetblob,choice);
+  long min_target_bits=(W?bm->min_bitsper*bm->short_per_long:bm->min_bitsper);
+  long max_target_bits=(W?bm->max_bitsper*bm->short_per_long:bm->max_bitsper);
   long desired_fill=bi->reservoir_bits*bi->reservoir_bias;
-  if(!bm->managed){
-    /* not a bitrate managed stream, but for API simplicity, we'll
-       buffer the packet to keep the code path clean */
-
-    if(bm->vb)return(-1); /* one has been submitted without
-                             being claimed */
-    bm->vb=vb;
-    return(0);
-  }
-
-  bm->vb=vb;
-
-  /* look ahead for avg floater */
-  if(bm->avg_bitsper>0){
-    double slew=0.;
-    long avg_target_bits=(vb->W?bm->avg_bitsper*bm->short_per_long:bm->avg_bitsper);
-    double slewlimit= 15./bi->slew_damp;
-
-    /* choosing a new floater:
-       if we're over target, we slew down
-       if we're under target, we slew up
-
-       choose slew as follows: look through packetblobs of this frame
-       and set slew as the first in the appropriate direction that
-       gives us the slew we want.  This may mean no slew if delta is
-       already favorable.
-
-       Then limit slew to slew max */
-
-    if(bm->avg_reservoir+(this_bits-avg_target_bits)>desired_fill){
-      while(choice>0 && this_bits>avg_target_bits &&
-            bm->avg_reservoir+(this_bits-avg_target_bits)>desired_fill){
-        choice--;
-        this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
-      }
-    }else if(bm->avg_reservoir+(this_bits-avg_target_bits)<desired_fill){
-      while(choice+1<PACKETBLOBS && this_bits<avg_target_bits &&
-            bm->avg_reservoir+(this_bits-avg_target_bits)<desired_fill){
-        choice++;
-        this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
-      }
-    }
-
-    slew=rint(choice-bm->avgfloat)/samples*vi->rate;
-    if(slew<-slewlimit)slew=-slewlimit;
-    if(slew>slewlimit)slew=slewlimit;
-    choice=rint(bm->avgfloat+= slew/vi->rate*samples);
-    this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
-  }
-
-
 
   /* enforce min(if used) on the current floater (if used) */
   if(bm->min_bitsper>0){
@@ -145,7 +244,7 @@ int vorbis_bitrate_addblock(vorbis_block *vb){
       while(bm->minmax_reservoir-(min_target_bits-this_bits)<0){
         choice++;
         if(choice>=PACKETBLOBS)break;
-        this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
+        this_bits=_bitrate_blob_bits(vb,packetblob,choice);
       }
     }
   }
@@ -157,7 +256,7 @@ int vorbis_bitrate_addblock(vorbis_block *vb){
       while(bm->minmax_reservoir+(this_bits-max_target_bits)>bi->reservoir_bits){
         choice--;
         if(choice<0)break;
-        this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
+        this_bits=_bitrate_blob_bits(vb,packetblob,choice);
       }
     }
   }
@@ -169,24 +268,22 @@ int vorbis_bitrate_addblock(vorbis_block *vb){
     /* choosing a smaller packetblob is insufficient to trim bitrate.
        frame will need to be truncated */
     long maxsize=(max_target_bits+(bi->reservoir_bits-bm->minmax_reservoir))/8;
-    bm->choice=choice=0;
+    choice=0;
 
-    if(oggpack_bytes(vbi->packetblob[choice])>maxsize){
+    if(oggpack_bytes(packetblob[choice])>maxsize){
 
-      oggpack_writetrunc(vbi->packetblob[choice],maxsize*8);
-      this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
+      oggpack_writetrunc(packetblob[choice],maxsize*8);
+      this_bits=oggpack_bytes(packetblob[choice])*8;
     }
   }else{
     long minsize=(min_target_bits-bm->minmax_reservoir+7)/8;
     if(choice>=PACKETBLOBS)
       choice=PACKETBLOBS-1;
 
-    bm->choice=choice;
-
     /* prop up bitrate according to demand. pad this frame out with zeroes */
-    minsize-=oggpack_bytes(vbi->packetblob[choice]);
-    while(minsize-->0)oggpack_write(vbi->packetblob[choice],0,8);
-    this_bits=oggpack_bytes(vbi->packetblob[choice])*8;
+    minsize-=oggpack_bytes(packetblob[choice]);
+    while(minsize-->0)oggpack_write(packetblob[choice],0,8);
+    this_bits=oggpack_bytes(packetblob[choice])*8;
 
   }
 
@@ -220,10 +317,252 @@ int vorbis_bitrate_addblock(vorbis_block *vb){
 
   /* avg reservoir */
   if(bm->avg_bitsper>0){
-    long avg_target_bits=(vb->W?bm->avg_bitsper*bm->short_per_long:bm->avg_bitsper);
+    long avg_target_bits=(W?bm->avg_bitsper*bm->short_per_long:bm->avg_bitsper);
     bm->avg_reservoir+=this_bits-avg_target_bits;
   }
 
+  return(choice);
+}
+
+/* how far ahead, in seconds, the lookahead window counts: each block's
+   bits weigh less by a factor of e per this much of audio before it.
+   Weighing the far end of a long window as heavily as the next block
+   lets the floater follow the material over that whole span and swings
+   the bitrate over a second more than having no lookahead at all. */
+#define LOOKAHEAD_SPAN .05
+
+/* the average tracker with lookahead: rather than slewing toward
+   whichever blob suits the next block alone, find the (fractional)
+   floater level at which the queued blocks, weighted by nearness,
+   would bring the average reservoir to the desired fill, and slew
+   toward that.  Blocks that are hard to code then borrow from the easy
+   ones around them instead of each swinging the floater on its own. */
+static int _bitrate_window_choice(bitrate_manager_state *bm,
+                                  vorbis_info *vi){
+  codec_setup_info      *ci=vi->codec_setup;
+  bitrate_manager_info  *bi=&ci->bi;
+  bitrate_manager_block *head=bm->queue+bm->queue_head;
+  int  samples=ci->blocksizes[head->W]>>1;
+  long desired_fill=bi->reservoir_bits*bi->reservoir_bias;
+
+  if(bm->avg_bitsper>0){
+    double slewlimit= 15./bi->slew_damp;
+    double slew,level;
+    double over[PACKETBLOBS];
+    double decay[2];
+    int i,k;
+
+    for(i=0;i<2;i++)
+      decay[i]=exp(-(ci->blocksizes[i]>>1)/(LOOKAHEAD_SPAN*vi->rate));
+
+    /* weighted reservoir overshoot over the window, per blob */
+    for(i=0;i<PACKETBLOBS;i++){
+      double weight=1.;
+      over[i]=bm->avg_reservoir-desired_fill;
+      for(k=0;k<bm->queue_fill;k++){
+        bitrate_manager_block *q=bm->queue+(bm->queue_head+k)%bm->queue_size;
+        long avg_target_bits=(q->W?bm->avg_bitsper*bm->short_per_long:bm->avg_bitsper);
+        over[i]+=weight*(oggpack_bytes(q->packetblob[i])*8-avg_target_bits);
+        weight*=decay[q->W];
+      }
+    }
+
+    /* the highest level that does not overshoot, interpolated toward
+       the one that does */
+    if(over[0]>=0){
+      level=0.;
+    }else{
+      for(i=1;i<PACKETBLOBS && over[i]<0;i++);
+      if(i==PACKETBLOBS)
+        level=PACKETBLOBS-1;
+      else
+        level=i-1+-over[i-1]/(over[i]-over[i-1]);
+    }
+
+    slew=(level-bm->avgfloat)/samples*vi->rate;
+    if(slew<-slewlimit)slew=-slewlimit;
+    if(slew>slewlimit)slew=slewlimit;
+    bm->avgfloat+=slew/vi->rate*samples;
+  }
+
+  return(rint(bm->avgfloat));
+}
+
+/* finish taking in the block we just processed */
+int vorbis_bitrate_addblock(vorbis_block *vb){
+  vorbis_block_internal *vbi=vb->internal;
+  vorbis_dsp_state      *vd=vb->vd;
+  private_state         *b=vd->backend_state;
+  bitrate_manager_state *bm=&b->bms;
+  vorbis_info           *vi=vd->vi;
+  codec_setup_info      *ci=vi->codec_setup;
+  bitrate_manager_info  *bi=&ci->bi;
+
+  int  choice=rint(bm->avgfloat);
+  long this_bits;
+  int  samples=ci->blocksizes[vb->W]>>1;
+  long desired_fill=bi->reservoir_bits*bi->reservoir_bias;
+
+  if(bm->twopass==1){
+    /* first pass: code and record every packetblob.  The packet
+       is the middle one, as in a stream without management. */
+    long i=bm->tp_blocks;
+    int k;
+
+    if(bm->vb)return(-1); /* not claimed */
+    if(i>=bm->tp_storage){
+      bm->tp_storage=bm->tp_storage*2+256;
+      bm->tp_W=_ogg_realloc(bm->tp_W,bm->tp_storage*sizeof(*bm->tp_W));
+      bm->tp_bytes=_ogg_realloc(bm->tp_bytes,bm->tp_storage*PACKETBLOBS*
+                                sizeof(*bm->tp_bytes));
+    }
+    for(k=0;k<PACKETBLOBS;k++)
+      bm->tp_bytes[i*PACKETBLOBS+k]=
+        _bitrate_blob_bits(vb,vbi->packetblob,k)/8;
+    bm->tp_W[i]=vb->W;
+    bm->tp_blocks++;
+
+    bm->vb=vb;
+    bm->choice=PACKETBLOBS/2;
+    bm->blobs_coded+=PACKETBLOBS;
+    bm->blobs_used++;
+    return(0);
+  }
+
+  if(bm->twopass==2){
+    /* second pass: follow the plan.  Should the audio or settings
+       differ slightly from the first pass, step toward the planned
+       total whenever the output is off by more than a packet.  Once
+       the block sizes stop matching the first pass, its statistics no
+       longer describe the blocks being coded; the rest of the stream
+       is coded at the plan's lower level and not padded. */
+    long i=bm->tp_block++;
+    int k;
+
+    if(bm->vb)return(-1); /* not claimed */
+    if(bm->tp_plan && (i>=bm->tp_blocks || bm->tp_W[i]!=vb->W)){
+      _ogg_free(bm->tp_plan);
+      bm->tp_plan=NULL;
+    }
+
+    choice=bm->tp_level;
+    if(bm->tp_plan){
+      long bytes;
+      ogg_int64_t drift;
+
+      choice=bm->tp_plan[i];
+      bm->tp_planned+=bm->tp_bytes[i*PACKETBLOBS+choice];
+      bytes=_bitrate_blob_bits(vb,vbi->packetblob,choice)/8;
+      drift=bm->tp_actual+bytes-bm->tp_planned;
+      if(drift>bytes && choice>0)
+        bytes=_bitrate_blob_bits(vb,vbi->packetblob,--choice)/8;
+      else if(-drift>bytes && choice+1<PACKETBLOBS)
+        bytes=_bitrate_blob_bits(vb,vbi->packetblob,++choice)/8;
+
+      /* pad the last packet up to the target */
+      if(vb->eofflag && i+1==bm->tp_blocks){
+        ogg_int64_t pad=bm->tp_target-bm->tp_actual-bytes;
+        while(pad-->0)
+          oggpack_write(vbi->packetblob[choice],0,8);
+      }
+    }else
+      _bitrate_blob_bits(vb,vbi->packetblob,choice);
+    bm->tp_actual+=oggpack_bytes(vbi->packetblob[choice]);
+
+    bm->vb=vb;
+    bm->choice=choice;
+    for(k=0;k<PACKETBLOBS;k++)
+      bm->blobs_coded+=vbi->blobcoded[k];
+    bm->blobs_used++;
+    return(0);
+  }
+
+  if(!bm->managed){
+    /* not a bitrate managed stream, but for API simplicity, we'll
+       buffer the packet to keep the code path clean */
+
+    if(bm->vb)return(-1); /* one has been submitted without
+                             being claimed */
+    bm->vb=vb;
+    bm->blobs_coded++;
+    bm->blobs_used++;
+    return(0);
+  }
+
+  if(bm->queue){
+    /* lookahead; the vorbis_block will be reused, so keep a copy of
+       every packetblob.  The choice is made in
+       vorbis_bitrate_flushpacket() once the window is full. */
+    bitrate_manager_block *q;
+    int i;
+
+    if(bm->queue_fill>=bm->queue_size)return(-1); /* not claimed */
+    q=bm->queue+(bm->queue_head+bm->queue_fill)%bm->queue_size;
+    for(i=0;i<PACKETBLOBS;i++){
+      _vorbis_analysis_blob(vb,i);
+      oggpack_reset(q->packetblob[i]);
+      oggpack_writecopy(q->packetblob[i],
+                        oggpack_get_buffer(vbi->packetblob[i]),
+                        oggpack_bits(vbi->packetblob[i]));
+    }
+    q->W=vb->W;
+    q->eofflag=vb->eofflag;
+    q->granulepos=vb->granulepos;
+    q->sequence=vb->sequence;
+    bm->queue_fill++;
+    bm->blobs_coded+=PACKETBLOBS;
+    if(vb->eofflag)bm->queue_eof=1;
+    return(0);
+  }
+
+  bm->vb=vb;
+  this_bits=_bitrate_blob_bits(vb,vbi->packetblob,choice);
+
+  /* look ahead for avg floater */
+  if(bm->avg_bitsper>0){
+    double slew=0.;
+    long avg_target_bits=(vb->W?bm->avg_bitsper*bm->short_per_long:bm->avg_bitsper);
+    double slewlimit= 15./bi->slew_damp;
+
+    /* choosing a new floater:
+       if we're over target, we slew down
+       if we're under target, we slew up
+
+       choose slew as follows: look through packetblobs of this frame
+       and set slew as the first in the appropriate direction that
+       gives us the slew we want.  This may mean no slew if delta is
+       already favorable.
+
+       Then limit slew to slew max */
+
+    if(bm->avg_reservoir+(this_bits-avg_target_bits)>desired_fill){
+      while(choice>0 && this_bits>avg_target_bits &&
+            bm->avg_reservoir+(this_bits-avg_target_bits)>desired_fill){
+        choice--;
+        this_bits=_bitrate_blob_bits(vb,vbi->packetblob,choice);
+      }
+    }else if(bm->avg_reservoir+(this_bits-avg_target_bits)<desired_fill){
+      while(choice+1<PACKETBLOBS && this_bits<avg_target_bits &&
+            bm->avg_reservoir+(this_bits-avg_target_bits)<desired_fill){
+        choice++;
+        this_bits=_bitrate_blob_bits(vb,vbi->packetblob,choice);
+      }
+    }
+
+    slew=rint(choice-bm->avgfloat)/samples*vi->rate;
+    if(slew<-slewlimit)slew=-slewlimit;
+    if(slew>slewlimit)slew=slewlimit;
+    choice=rint(bm->avgfloat+= slew/vi->rate*samples);
+  }
+
+  bm->choice=_bitrate_commit(bm,bi,vb,vbi->packetblob,vb->W,choice);
+
+  {
+    int i;
+    for(i=0;i<PACKETBLOBS;i++)
+      bm->blobs_coded+=vbi->blobcoded[i];
+    bm->blobs_used++;
+  }
   return(0);
 }
 
@@ -232,6 +571,34 @@ int vorbis_bitrate_flushpacket(vorbis_dsp_state *vd,ogg_packet *op){
   bitrate_manager_state *bm=&b->bms;
   vorbis_block          *vb=bm->vb;
   int                    choice=PACKETBLOBS/2;
+
+  if(bm->queue){
+    /* lookahead; decide the oldest block once the window is full or
+       the end of stream is in it */
+    bitrate_manager_block *q=bm->queue+bm->queue_head;
+    codec_setup_info      *ci=vd->vi->codec_setup;
+
+    if(bm->queue_fill==0)return 0;
+    if(bm->queue_fill<bm->queue_size && !bm->queue_eof)return 0;
+
+    choice=_bitrate_window_choice(bm,vd->vi);
+    choice=_bitrate_commit(bm,&ci->bi,NULL,q->packetblob,q->W,choice);
+    bm->blobs_used++;
+
+    if(op){
+      op->packet=oggpack_get_buffer(q->packetblob[choice]);
+      op->bytes=oggpack_bytes(q->packetblob[choice]);
+      op->b_o_s=0;
+      op->e_o_s=q->eofflag;
+      op->granulepos=q->granulepos;
+      op->packetno=q->sequence; /* for sake of completeness */
+    }
+
+    bm->queue_head=(bm->queue_head+1)%bm->queue_size;
+    bm->queue_fill--;
+    return(1);
+  }
+
   if(!vb)return 0;
 
   if(op){
@@ -251,3 +618,59 @@ int vorbis_bitrate_flushpacket(vorbis_dsp_state *vd,ogg_packet *op){
   bm->vb=0;
   return(1);
 }
+
+/* packetblobs coded and packets chosen from them so far; see
+   vorbis_bitrate_addblock() */
+int vorbis_bitrate_blobstats(vorbis_dsp_state *vd,ogg_int64_t *coded,
+                             ogg_int64_t *used){
+  private_state         *b=vd->backend_state;
+  bitrate_manager_state *bm;
+
+  if(!b || !vd->analysisp)return(OV_EINVAL);
+  bm=&b->bms;
+  if(coded)*coded=bm->blobs_coded;
+  if(used)*used=bm->blobs_used;
+  return(0);
+}
+
+/* the first pass statistics for a second pass; returns their size,
+   copying them to buffer if it is at least that large */
+long vorbis_bitrate_twopass_stats(vorbis_dsp_state *vd,void *buffer,
+                                  long bytes){
+  private_state         *b=vd->backend_state;
+  bitrate_manager_state *bm;
+  oggpack_buffer         opb;
+  long                   i,ret;
+  int                    k;
+
+  if(!b || !vd->analysisp)return(OV_EINVAL);
+  bm=&b->bms;
+  if(bm->twopass!=1 || bm->tp_blocks==0)return(OV_EINVAL);
+
+  oggpack_writeinit(&opb);
+  oggpack_write(&opb,TWOPASS_MAGIC,32);
+  oggpack_write(&opb,TWOPASS_VERSION,8);
+  oggpack_write(&opb,PACKETBLOBS,8);
+  oggpack_write(&opb,vd->vi->channels,8);
+  oggpack_write(&opb,vd->vi->rate,32);
+  oggpack_write(&opb,bm->tp_blocks,32);
+  for(i=0;i<bm->tp_blocks;i++){
+    long *sizes=bm->tp_bytes+i*PACKETBLOBS;
+    long max=0;
+    int n;
+    for(k=0;k<PACKETBLOBS;k++)
+      if(sizes[k]>max)max=sizes[k];
+    n=ov_ilog(max);
+    if(n==0)n=1;
+    oggpack_write(&opb,bm->tp_W[i],1);
+    oggpack_write(&opb,n,5);
+    for(k=0;k<PACKETBLOBS;k++)
+      oggpack_write(&opb,sizes[k],n);
+  }
+
+  ret=oggpack_bytes(&opb);
+  if(buffer && bytes>=ret)
+    memcpy(buffer,oggpack_get_buffer(&opb),ret);
+  oggpack_writeclear(&opb);
+  return(ret);
+}
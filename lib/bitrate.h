@@ -22,6 +22,16 @@
 #include "codec_internal.h"
 #include "os.h"
 
+/* a block held in the bitrate manager lookahead.  The vorbis_block is
+   reused by the application, so each packetblob is copied. */
+typedef struct bitrate_manager_block {
+  oggpack_buffer *packetblob[PACKETBLOBS];
+  int             W;
+  int             eofflag;
+  ogg_int64_t     granulepos;
+  ogg_int64_t     sequence;
+} bitrate_manager_block;
+
 /* encode side bitrate tracking */
 typedef struct bitrate_manager_state {
   int            managed;
@@ -37,6 +47,32 @@ typedef struct bitrate_manager_state {
 
   vorbis_block  *vb;
   int            choice;
+
+  /* lookahead window (ring buffer), if used */
+  bitrate_manager_block *queue;
+  int            queue_size;
+  int            queue_head;
+  int            queue_fill;
+  int            queue_eof;
+
+  /* statistics */
+  ogg_int64_t    blobs_coded;
+  ogg_int64_t    blobs_used;
+
+  /* two pass encoding; the packetblob sizes of each block, recorded
+     in the first pass or read back from its statistics */
+  int            twopass;
+  long           tp_blocks;
+  long           tp_storage;
+  unsigned char *tp_W;
+  long          *tp_bytes;  /* [block*PACKETBLOBS+blob] */
+  unsigned char *tp_plan;   /* second pass: packetblob of each block,
+                               until the blocks stop matching */
+  int            tp_level;  /* the lower of the plan's two packetblobs */
+  long           tp_block;
+  ogg_int64_t    tp_target;
+  ogg_int64_t    tp_planned;
+  ogg_int64_t    tp_actual;
 } bitrate_manager_state;
 
 typedef struct bitrate_manager_info{
@@ -47,6 +83,12 @@ typedef struct bitrate_manager_info{
   double         reservoir_bias;
 
   double         slew_damp;
+  int            lookahead; /* blocks; 0 for none */
+
+  int            twopass;   /* 0 for none, else 1 or 2 */
+  ogg_int64_t    twopass_target;
+  unsigned char *twopass_stats; /* second pass */
+  long           twopass_stats_bytes;
 
 } bitrate_manager_info;
 
@@ -55,5 +97,7 @@ extern void vorbis_bitrate_clear(bitrate_manager_state *bs);
 extern int vorbis_bitrate_managed(vorbis_block *vb);
 extern int vorbis_bitrate_addblock(vorbis_block *vb);
 extern int vorbis_bitrate_flushpacket(vorbis_dsp_state *vd, ogg_packet *op);
+extern int vorbis_bitrate_twopass_check(vorbis_info *vi,const void *stats,
+                                       long bytes);
 
 #endif
@@ -209,6 +209,7 @@ static int _vds_shared_init(vorbis_dsp_state *v,vorbis_info *vi,int encp){
   b->window[1]=ov_ilog(ci->blocksizes[1])-7;
 
   if(encp){ /* encode/decode differ here */
+#ifndef VORBIS_DECODE_ONLY
 
     /* analysis always needs an fft */
     drft_init(&b->fft_look[0],ci->blocksizes[0]);
@@ -231,18 +232,18 @@ static int _vds_shared_init(vorbis_dsp_state *v,vorbis_info *vi,int encp){
     }
 
     v->analysisp=1;
+#endif
   }else{
-    /* finish the codebooks */
+    /* finish the codebooks; the lengths are checked now and the
+       decode lists are built on first use */
     if(!ci->fullbooks){
       ci->fullbooks=_ogg_calloc(ci->books,sizeof(*ci->fullbooks));
       for(i=0;i<ci->books;i++){
         if(ci->book_param[i]==NULL)
           goto abort_books;
-        if(vorbis_book_init_decode(ci->fullbooks+i,ci->book_param[i]))
+        if(vorbis_book_init_lazy(ci->fullbooks+i,ci->book_param[i]))
           goto abort_books;
-        /* decode codebooks are now standalone after init */
-        vorbis_staticbook_destroy(ci->book_param[i]);
-        ci->book_param[i]=NULL;
+        ci->book_param[i]=NULL; /* the decode book owns it now */
       }
     }
   }
@@ -287,13 +288,34 @@ static int _vds_shared_init(vorbis_dsp_state *v,vorbis_info *vi,int encp){
       vorbis_staticbook_destroy(ci->book_param[i]);
       ci->book_param[i]=NULL;
     }
+    /* this also frees the static books the lazy books took over */
+    if(ci->fullbooks)
+      vorbis_book_clear(ci->fullbooks+i);
+  }
+  if(ci->fullbooks){
+    _ogg_free(ci->fullbooks);
+    ci->fullbooks=NULL;
   }
   vorbis_dsp_clear(v);
   return -1;
 }
 
+#ifndef VORBIS_DECODE_ONLY
+/* the lookahead past the block center that low latency mode needs
+   before it can emit a block: the block's own right half plus the
+   next block's left half (short blocks only), or, if longer, the
+   envelope search windows that finalize the block's impulse marks */
+static long _vds_lowlatency_lookahead(vorbis_dsp_state *v){
+  codec_setup_info *ci=v->vi->codec_setup;
+  envelope_lookup *ve=((private_state *)(v->backend_state))->ve;
+  long blocks=ci->blocksizes[0];
+  long search=ci->blocksizes[0]/2+(VE_WIN+2)*ve->searchstep;
+  return(blocks>search?blocks:search);
+}
+
 /* arbitrary settings and spec-mandated numbers get filled in here */
 int vorbis_analysis_init(vorbis_dsp_state *v,vorbis_info *vi){
+  codec_setup_info *ci=vi->codec_setup;
   private_state *b=NULL;
 
   if(_vds_shared_init(v,vi,1))return 1;
@@ -304,6 +326,22 @@ int vorbis_analysis_init(vorbis_dsp_state *v,vorbis_info *vi){
   b->ve=_ogg_calloc(1,sizeof(*b->ve));
   _ve_envelope_init(b->ve,vi);
 
+  /* in low latency mode the lookahead is bounded, so the PCM and
+     envelope storage can be sized once from the blocksizes: history
+     back to the block center, the lookahead, and the end of stream
+     padding (which is also room for up to three long blocks of input
+     per vorbis_analysis_buffer() call) */
+  if(ci->psy_g_param.lowlatency){
+    int i;
+    v->pcm_storage=ci->blocksizes[1]/2+_vds_lowlatency_lookahead(v)+
+      ci->blocksizes[1]*3+1;
+    for(i=0;i<vi->channels;i++)
+      v->pcm[i]=_ogg_realloc(v->pcm[i],v->pcm_storage*sizeof(*v->pcm[i]));
+
+    b->ve->storage=v->pcm_storage/b->ve->searchstep+VE_POST;
+    b->ve->mark=_ogg_realloc(b->ve->mark,b->ve->storage*sizeof(*b->ve->mark));
+  }
+
   vorbis_bitrate_init(vi,&b->bms);
 
   /* compressed audio packets start after the headers
@@ -312,6 +350,7 @@ int vorbis_analysis_init(vorbis_dsp_state *v,vorbis_info *vi){
 
   return(0);
 }
+#endif
 
 void vorbis_dsp_clear(vorbis_dsp_state *v){
   int i;
@@ -322,10 +361,12 @@ void vorbis_dsp_clear(vorbis_dsp_state *v){
 
     if(b){
 
+#ifndef VORBIS_DECODE_ONLY
       if(b->ve){
         _ve_envelope_clear(b->ve);
         _ogg_free(b->ve);
       }
+#endif
 
       if(b->transform[0]){
         mdct_clear(b->transform[0][0]);
@@ -352,6 +393,7 @@ void vorbis_dsp_clear(vorbis_dsp_state *v){
               free_look(b->residue[i]);
         _ogg_free(b->residue);
       }
+#ifndef VORBIS_DECODE_ONLY
       if(b->psy){
         if(ci)
           for(i=0;i<ci->psys;i++)
@@ -364,6 +406,7 @@ void vorbis_dsp_clear(vorbis_dsp_state *v){
 
       drft_clear(&b->fft_look[0]);
       drft_clear(&b->fft_look[1]);
+#endif
 
     }
 
@@ -387,6 +430,7 @@ void vorbis_dsp_clear(vorbis_dsp_state *v){
   }
 }
 
+#ifndef VORBIS_DECODE_ONLY
 float **vorbis_analysis_buffer(vorbis_dsp_state *v, int vals){
   int i;
   vorbis_info *vi=v->vi;
@@ -513,8 +557,14 @@ int vorbis_analysis_wrote(vorbis_dsp_state *v, int vals){
     /* we may want to reverse extrapolate the beginning of a stream
        too... in case we're beginning on a cliff! */
     /* clumsy, but simple.  It only runs once, so simple is good. */
-    if(!v->preextrapolate && v->pcm_current-v->centerW>ci->blocksizes[1])
-      _preextrapolate_helper(v);
+    /* low latency mode can't wait for a long block of input and
+       predicts from what the first block needs instead */
+    if(!v->preextrapolate){
+      long need=ci->blocksizes[1];
+      if(ci->psy_g_param.lowlatency)need=_vds_lowlatency_lookahead(v);
+      if(v->pcm_current-v->centerW>need)
+        _preextrapolate_helper(v);
+    }
 
   }
   return(0);
@@ -528,6 +578,7 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
   codec_setup_info *ci=vi->codec_setup;
   private_state *b=v->backend_state;
   vorbis_look_psy_global *g=b->psy_g_look;
+  vorbis_info_psy_global *gi=&ci->psy_g_param;
   long beginW=v->centerW-ci->blocksizes[v->W]/2,centerNext;
   vorbis_block_internal *vbi=(vorbis_block_internal *)vb->internal;
 
@@ -544,12 +595,23 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
   /* we do an envelope search even on a single blocksize; we may still
      be throwing more bits at impulses, and envelope search handles
      marking impulses too. */
-  {
+  if(gi->lowlatency){
+    /* low latency mode uses only short blocks, so there is no next
+       window size to wait for; the search only needs to have marked
+       impulses up to the end of the current block */
+    envelope_lookup *ve=b->ve;
+    _ve_envelope_search(v);
+    if(!v->eofflag && !b->splice &&
+       ve->current<v->centerW+ci->blocksizes[0]/2+ve->searchstep)
+      return(0);
+    v->nW=0;
+  }else{
     long bp=_ve_envelope_search(v);
     if(bp==-1){
 
-      if(v->eofflag==0)return(0); /* not enough data currently to search for a
-                                     full long block */
+      if(v->eofflag==0 && !b->splice)
+        return(0); /* not enough data currently to search for a
+                      full long block */
       v->nW=0;
     }else{
 
@@ -560,6 +622,17 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
     }
   }
 
+  /* a chunk ended by vorbis_analysis_splice() hands over to the next
+     chunk at a short block centered on the splice point.  Take a long
+     block only if a short one can still follow it there, and if the
+     lookahead covers it. */
+  if(b->splice && v->nW){
+    long centerLong=v->centerW+ci->blocksizes[v->W]/4+ci->blocksizes[1]/4;
+    if(centerLong+ci->blocksizes[1]/4+ci->blocksizes[0]/4>b->splice ||
+       centerLong+ci->blocksizes[1]/2>v->pcm_current)
+      v->nW=0;
+  }
+
   centerNext=v->centerW+ci->blocksizes[v->W]/4+ci->blocksizes[v->nW]/4;
 
   {
@@ -645,6 +718,14 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
     }
   }
 
+  /* the last block before the splice point; the next chunk's encoder
+     codes the one centered on it */
+  if(b->splice && centerNext>=b->splice){
+    v->eofflag=-1;
+    vb->eofflag=1;
+    return(1);
+  }
+
   /* advance storage vectors and clean up */
   {
     int new_centerNext=ci->blocksizes[1]/2;
@@ -654,6 +735,7 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
 
       _ve_envelope_shift(b->ve,movementW);
       v->pcm_current-=movementW;
+      if(b->splice)b->splice-=movementW;
 
       for(i=0;i<vi->channels;i++)
         memmove(v->pcm[i],v->pcm[i]+movementW,
@@ -683,6 +765,131 @@ int vorbis_analysis_blockout(vorbis_dsp_state *v,vorbis_block *vb){
   return(1);
 }
 
+/* samples handed to vorbis_analysis_wrote() that the blocks returned
+   by vorbis_analysis_blockout() so far can not yet reproduce; once
+   the blocks are encoded, this is how far the granulepos of the last
+   packet trails the input */
+long vorbis_analysis_delay(vorbis_dsp_state *v){
+  vorbis_info *vi=v->vi;
+  codec_setup_info *ci;
+  long end,delay;
+
+  if(!vi || !v->backend_state || !v->analysisp)return(OV_EINVAL);
+  ci=vi->codec_setup;
+  if(v->eofflag<0)return(0);
+
+  /* the input ends at pcm_current, or at eofflag once the stream
+     has been padded out.  centerW is the center of the next block to
+     be returned; everything up to the center of the last one is
+     done */
+  end=(v->eofflag?v->eofflag:v->pcm_current);
+  delay=end-v->centerW;
+
+  /* once a block has been returned, the last one is centered a block
+     step (a quarter of each blocksize) before centerW.  sequence
+     counts from 3, the packetno of the first audio packet (see
+     vorbis_analysis_init()), so above 3 a block has been returned */
+  if(v->sequence>3)
+    delay+=ci->blocksizes[v->lW]/4+ci->blocksizes[v->W]/4;
+
+  return(delay<0?0:delay);
+}
+
+/* Encoding a stream in chunks, each with its own encoder: chunks
+   meet at splice points on the short block grid, where the block
+   centered on the splice point is a short block coded by the second
+   chunk.  Short blocks do not depend on their neighbors' sizes, so
+   the chunks' blocks overlap as those of a single encoder would. */
+
+/* start a chunk at granulepos, given the input before it */
+int vorbis_analysis_prime(vorbis_dsp_state *v,float **history,int vals,
+                          ogg_int64_t granulepos){
+  vorbis_info *vi=v->vi;
+  codec_setup_info *ci;
+  int i,n;
+
+  if(!vi || !v->backend_state || !v->analysisp)return(OV_EINVAL);
+  ci=vi->codec_setup;
+
+  /* only before any input */
+  if(v->preextrapolate || v->eofflag || v->pcm_current!=v->centerW)
+    return(OV_EINVAL);
+  if(vals<0 || granulepos<0 || granulepos%(ci->blocksizes[0]/2))
+    return(OV_EINVAL);
+
+  /* the first block reaches back half a long block at most */
+  n=ci->blocksizes[1]/2;
+  if(n>vals)n=vals;
+  for(i=0;i<vi->channels;i++)
+    memcpy(v->pcm[i]+v->centerW-n,history[i]+vals-n,n*sizeof(*v->pcm[i]));
+
+  /* the history is real input; nothing to extrapolate */
+  v->preextrapolate=1;
+  v->granulepos=granulepos;
+  return(0);
+}
+
+/* end a chunk at the input written so far, given the input after it */
+int vorbis_analysis_splice(vorbis_dsp_state *v,float **lookahead,int vals){
+  vorbis_info *vi=v->vi;
+  private_state *b=v->backend_state;
+  codec_setup_info *ci;
+  ogg_int64_t pos;
+  float **buffer;
+  int i;
+
+  if(!vi || !b || !v->analysisp)return(OV_EINVAL);
+  ci=vi->codec_setup;
+  if(v->eofflag || b->splice)return(OV_EINVAL);
+
+  /* the splice point must be on the short block grid, and far enough
+     ahead for a short block to be centered on it */
+  pos=v->granulepos+v->pcm_current-v->centerW;
+  if(pos%(ci->blocksizes[0]/2))return(OV_EINVAL);
+  if(v->pcm_current<v->centerW+
+     (v->W?ci->blocksizes[1]/4+ci->blocksizes[0]/4:ci->blocksizes[0]/2))
+    return(OV_EINVAL);
+
+  /* the last block overlaps at least half a short block past the
+     splice point; up to a long block helps the envelope search */
+  if(vals<ci->blocksizes[0]/2)return(OV_EINVAL);
+  if(vals>ci->blocksizes[1])vals=ci->blocksizes[1];
+
+  buffer=vorbis_analysis_buffer(v,vals);
+  for(i=0;i<vi->channels;i++)
+    memcpy(buffer[i],lookahead[i],vals*sizeof(*buffer[i]));
+  b->splice=v->pcm_current;
+  v->pcm_current+=vals;
+
+  /* if it wasn't done earlier (very short chunk) */
+  if(!v->preextrapolate)
+    _preextrapolate_helper(v);
+
+  return(0);
+}
+
+/* check that the first packet of a chunk follows the last packet of
+   the chunk before, and clear the end of stream flag the latter
+   carries, so that both can go into the same logical stream */
+int vorbis_analysis_join(vorbis_info *vi,ogg_packet *last,ogg_packet *first){
+  codec_setup_info *ci=vi->codec_setup;
+  long lastsize,firstsize;
+
+  if(!ci)return(OV_EINVAL);
+  lastsize=vorbis_packet_blocksize(vi,last);
+  firstsize=vorbis_packet_blocksize(vi,first);
+  if(lastsize<0 || firstsize<0)return(OV_ENOTAUDIO);
+
+  if(!last->e_o_s || firstsize!=ci->blocksizes[0] ||
+     first->granulepos-last->granulepos!=lastsize/4+firstsize/4)
+    return(OV_EINVAL);
+
+  last->e_o_s=0;
+  first->b_o_s=0;
+  return(0);
+}
+#endif
+
 int vorbis_synthesis_restart(vorbis_dsp_state *v){
   vorbis_info *vi=v->vi;
   codec_setup_info *ci;
@@ -707,7 +914,8 @@ int vorbis_synthesis_restart(vorbis_dsp_state *v){
 }
 
 int vorbis_synthesis_init(vorbis_dsp_state *v,vorbis_info *vi){
-  if(_vds_shared_init(v,vi,0)){
+  /* a skimmed setup header is unpacked on first use */
+  if(_vorbis_info_load_setup(vi) || _vds_shared_init(v,vi,0)){
     vorbis_dsp_clear(v);
     return 1;
   }
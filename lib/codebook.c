@@ -25,6 +25,7 @@
 #include "misc.h"
 #include "os.h"
 
+#ifndef VORBIS_DECODE_ONLY
 /* packs the given codebook into the bitstream **************************/
 
 int vorbis_staticbook_pack(const static_codebook *c,oggpack_buffer *opb){
@@ -143,10 +144,13 @@ int vorbis_staticbook_pack(const static_codebook *c,oggpack_buffer *opb){
 
   return(0);
 }
+#endif
 
 /* unpacks a codebook from the packet buffer into the codebook struct,
-   readies the codebook auxiliary structures for decode *************/
-static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
+   readies the codebook auxiliary structures for decode.  Without
+   lists, the book is only checked and stepped over; the length and
+   value lists are not kept *****************************************/
+static static_codebook *_staticbook_unpack(oggpack_buffer *opb,int lists){
   long i,j;
   static_codebook *s=_ogg_calloc(1,sizeof(*s));
   s->allocedp=1;
@@ -170,6 +174,16 @@ static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
     if((s->entries*(unused?1:5)+7)>>3>opb->storage-oggpack_bytes(opb))
       goto _eofout;
     /* unordered */
+    if(!lists){
+      if(unused){
+        for(i=0;i<s->entries;i++)
+          if(oggpack_read(opb,1) && oggpack_read(opb,5)==-1)goto _eofout;
+      }else{
+        /* the size check above covers the whole list */
+        oggpack_adv(opb,s->entries*5);
+      }
+      break;
+    }
     s->lengthlist=_ogg_malloc(sizeof(*s->lengthlist)*s->entries);
 
     /* allocated but unused entries? */
@@ -200,7 +214,8 @@ static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
     {
       long length=oggpack_read(opb,5)+1;
       if(length==0)goto _eofout;
-      s->lengthlist=_ogg_malloc(sizeof(*s->lengthlist)*s->entries);
+      if(lists)
+        s->lengthlist=_ogg_malloc(sizeof(*s->lengthlist)*s->entries);
 
       for(i=0;i<s->entries;){
         long num=oggpack_read(opb,ov_ilog(s->entries-i));
@@ -210,8 +225,10 @@ static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
           goto _errout;
         }
         if(length>32)goto _errout;
-        for(j=0;j<num;j++,i++)
-          s->lengthlist[i]=length;
+        if(lists)
+          for(j=0;j<num;j++)
+            s->lengthlist[i+j]=length;
+        i+=num;
         length++;
       }
     }
@@ -250,6 +267,13 @@ static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
       /* quantized values */
       if(((quantvals*s->q_quant+7)>>3)>opb->storage-oggpack_bytes(opb))
         goto _eofout;
+      if(!lists){
+        if(quantvals){
+          oggpack_adv(opb,(quantvals-1)*s->q_quant);
+          if(oggpack_read(opb,s->q_quant)==-1)goto _eofout;
+        }
+        break;
+      }
       s->quantlist=_ogg_malloc(sizeof(*s->quantlist)*quantvals);
       for(i=0;i<quantvals;i++)
         s->quantlist[i]=oggpack_read(opb,s->q_quant);
@@ -270,12 +294,24 @@ static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
   return(NULL);
 }
 
+static_codebook *vorbis_staticbook_unpack(oggpack_buffer *opb){
+  return(_staticbook_unpack(opb,1));
+}
+
+/* steps over a codebook, keeping only the sizes and mapping type that
+   the floor and residue setup check against */
+static_codebook *vorbis_staticbook_skim(oggpack_buffer *opb){
+  return(_staticbook_unpack(opb,0));
+}
+
+#ifndef VORBIS_DECODE_ONLY
 /* returns the number of bits ************************************************/
 int vorbis_book_encode(codebook *book, int a, oggpack_buffer *b){
   if(a<0 || a>=book->c->entries)return(0);
   oggpack_write(b,book->codelist[a],book->c->lengthlist[a]);
   return(book->c->lengthlist[a]);
 }
+#endif
 
 /* the 'eliminate the decode tree' optimization actually requires the
    codewords to be MSb first, not LSb.  This is an annoying inelegancy
@@ -346,6 +382,24 @@ STIN long decode_packed_entry_number(codebook *book, oggpack_buffer *b){
   return(-1);
 }
 
+/* books with a narrowed integer lattice are widened one entry at a
+   time into tmp (dim floats); float books are returned in place */
+STIN const float *book_entry_values(codebook *book,long entry,float *tmp){
+  long j,dim=book->dim;
+
+  if(book->dec_values8){
+    const signed char *v=book->dec_values8+entry*dim;
+    for(j=0;j<dim;j++)tmp[j]=v[j];
+    return(tmp);
+  }
+  if(book->dec_values16){
+    const ogg_int16_t *v=book->dec_values16+entry*dim;
+    for(j=0;j<dim;j++)tmp[j]=v[j];
+    return(tmp);
+  }
+  return(book->valuelist+entry*dim);
+}
+
 /* Decode side is specced and easier, because we don't need to find
    matches using different criteria; we simply read and map.  There are
    two things we need to do 'depending':
@@ -364,8 +418,11 @@ STIN long decode_packed_entry_number(codebook *book, oggpack_buffer *b){
 long vorbis_book_decode(codebook *book, oggpack_buffer *b){
   if(book->used_entries>0){
     long packed_entry=decode_packed_entry_number(book,b);
-    if(packed_entry>=0)
+    if(packed_entry>=0){
+      if(book->dec_index16)
+        return(book->dec_index16[packed_entry]);
       return(book->dec_index[packed_entry]);
+    }
   }
 
   /* if there's no dec_index, the codebook unpacking isn't collapsed */
@@ -378,13 +435,14 @@ long vorbis_book_decodevs_add(codebook *book,float *a,oggpack_buffer *b,int n){
   if(book->used_entries>0){
     int step=n/book->dim;
     long *entry = alloca(sizeof(*entry)*step);
-    float **t = alloca(sizeof(*t)*step);
+    const float **t = alloca(sizeof(*t)*step);
+    float *w = alloca(sizeof(*w)*step*book->dim);
     int i,j,o;
 
     for (i = 0; i < step; i++) {
       entry[i]=decode_packed_entry_number(book,b);
       if(entry[i]==-1)return(-1);
-      t[i] = book->valuelist+entry[i]*book->dim;
+      t[i] = book_entry_values(book,entry[i],w+i*book->dim);
     }
     for(i=0,o=0;i<book->dim;i++,o+=step)
       for (j=0;j<step;j++)
@@ -397,13 +455,14 @@ long vorbis_book_decodevs_add(codebook *book,float *a,oggpack_buffer *b,int n){
 long vorbis_book_decodev_add(codebook *book,float *a,oggpack_buffer *b,int n){
   if(book->used_entries>0){
     int i,j,entry;
-    float *t;
+    const float *t;
+    float *w = alloca(sizeof(*w)*book->dim);
 
     if(book->dim>8){
       for(i=0;i<n;){
         entry = decode_packed_entry_number(book,b);
         if(entry==-1)return(-1);
-        t     = book->valuelist+entry*book->dim;
+        t     = book_entry_values(book,entry,w);
         for (j=0;j<book->dim;)
           a[i++]+=t[j++];
       }
@@ -411,7 +470,7 @@ long vorbis_book_decodev_add(codebook *book,float *a,oggpack_buffer *b,int n){
       for(i=0;i<n;){
         entry = decode_packed_entry_number(book,b);
         if(entry==-1)return(-1);
-        t     = book->valuelist+entry*book->dim;
+        t     = book_entry_values(book,entry,w);
         j=0;
         switch((int)book->dim){
         case 8:
@@ -445,12 +504,13 @@ long vorbis_book_decodev_add(codebook *book,float *a,oggpack_buffer *b,int n){
 long vorbis_book_decodev_set(codebook *book,float *a,oggpack_buffer *b,int n){
   if(book->used_entries>0){
     int i,j,entry;
-    float *t;
+    const float *t;
+    float *w = alloca(sizeof(*w)*book->dim);
 
     for(i=0;i<n;){
       entry = decode_packed_entry_number(book,b);
       if(entry==-1)return(-1);
-      t     = book->valuelist+entry*book->dim;
+      t     = book_entry_values(book,entry,w);
       for (j=0;i<n && j<book->dim;){
         a[i++]=t[j++];
       }
@@ -471,11 +531,12 @@ long vorbis_book_decodevv_add(codebook *book,float **a,long offset,int ch,
   long i,j,entry;
   int chptr=0;
   if(book->used_entries>0){
+    float *w = alloca(sizeof(*w)*book->dim);
     for(i=offset/ch;i<(offset+n)/ch;){
       entry = decode_packed_entry_number(book,b);
       if(entry==-1)return(-1);
       {
-        const float *t = book->valuelist+entry*book->dim;
+        const float *t = book_entry_values(book,entry,w);
         for (j=0;j<book->dim;j++){
           a[chptr++][i]+=t[j];
           if(chptr==ch){
@@ -67,12 +67,26 @@ typedef struct codebook{
   float        *valuelist;  /* list of dim*entries actual entry values */
   ogg_uint32_t *codelist;   /* list of bitstream codewords for each entry */
 
-  int          *dec_index;  /* only used if sparseness collapsed */
-  char         *dec_codelengths;
-  ogg_uint32_t *dec_firsttable;
+  /* decode books carve everything below (and the two lists above) out
+     of a single allocation.  Integer lattices that fit are stored
+     narrowed in place of valuelist; entry indices are 16 bit when the
+     book is small enough. */
+  void          *dec_store;
+  signed char   *dec_values8;
+  ogg_int16_t   *dec_values16;
+  int           *dec_index;  /* only used if sparseness collapsed */
+  ogg_uint16_t  *dec_index16;
+  unsigned char *dec_codelengths;
+  ogg_uint32_t  *dec_firsttable;
   int           dec_firsttablen;
   int           dec_maxlength;
 
+  /* lazily built decode books (see vorbis_book_init_lazy()) own
+     their static book until they are built from it */
+  long          dec_state;
+  long          dec_builders;
+  static_codebook *dec_source;
+
   /* The current encoder uses only centered, integer-only lattice books. */
   int           quantvals;
   int           minval;
@@ -82,6 +96,9 @@ typedef struct codebook{
 extern void vorbis_staticbook_destroy(static_codebook *b);
 extern int vorbis_book_init_encode(codebook *dest,const static_codebook *source);
 extern int vorbis_book_init_decode(codebook *dest,const static_codebook *source);
+extern int vorbis_book_init_lazy(codebook *dest,static_codebook *source);
+extern int vorbis_book_ready(codebook *b);
+extern int vorbis_book_ready_p(codebook *b);
 extern void vorbis_book_clear(codebook *b);
 
 extern float *_book_unquantize(const static_codebook *b,int n,int *map);
@@ -99,6 +116,7 @@ extern long vorbis_book_codelen(codebook *book,int entry);
 
 extern int vorbis_staticbook_pack(const static_codebook *c,oggpack_buffer *b);
 extern static_codebook *vorbis_staticbook_unpack(oggpack_buffer *b);
+extern static_codebook *vorbis_staticbook_skim(oggpack_buffer *b);
 
 extern int vorbis_book_encode(codebook *book, int a, oggpack_buffer *b);
 
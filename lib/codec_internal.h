@@ -37,6 +37,12 @@ typedef struct vorbis_block_internal{
                                               blob [PACKETBLOBS/2] points to
                                               the oggpack_buffer in the
                                               main vorbis_block */
+
+  /* packetblobs are coded on demand from these (block storage) */
+  float  **gmdct;
+  int    **iwork;
+  int   ***floor_posts;
+  int    blobcoded[PACKETBLOBS];
 } vorbis_block_internal;
 
 typedef void vorbis_look_floor;
@@ -82,6 +88,10 @@ typedef struct private_state {
   bitrate_manager_state bms;
 
   ogg_int64_t sample_count;
+
+  /* encode side: where vorbis_analysis_splice() ends the input, as a
+     pcm[] index; 0 if not set */
+  long splice;
 } private_state;
 
 /* codec_setup_info contains all the setup information specific to the
@@ -128,11 +138,19 @@ typedef struct codec_setup_info {
                                 highly redundant structure, but
                                 improves clarity of program flow. */
   int         halfrate_flag; /* painless downsample for decode */
+
+  /* setup header kept by vorbis_synthesis_headerskim(); books is zero
+     until the rest of it is unpacked */
+  unsigned char *setup_header;
+  long           setup_bytes;
 } codec_setup_info;
 
 extern vorbis_look_psy_global *_vp_global_look(vorbis_info *vi);
 extern void _vp_global_free(vorbis_look_psy_global *look);
 
+extern int _vorbis_analysis_blob(vorbis_block *vb,int blobno);
+extern int _vorbis_info_load_setup(vorbis_info *vi);
+
 
 
 typedef struct {
@@ -151,6 +169,8 @@ typedef struct {
   long phrasebits;
   long postbits;
   long frames;
+
+  int booksready; /* every decode book built; see floor1_books() */
 } vorbis_look_floor1;
 
 
@@ -84,12 +84,54 @@ void _ve_envelope_clear(envelope_lookup *e){
   memset(e,0,sizeof(*e));
 }
 
+/* window and transform up to MDCT_LANES search windows at once.  For
+   each window, out gets n/4+1 values: the near-DC energy, then the
+   smoothed spectrum in dB, before the spreading and limiting that
+   depend on the filter state.  _ve_amp() takes it from there. */
+static void _ve_spectrum(envelope_lookup *ve,float **data,int windows,
+                         float *out){
+  long n=ve->winlength;
+  float *vec=alloca(n*MDCT_LANES*sizeof(*vec));
+  long i,l;
+
+  /*_analysis_output_always("lpcm",seq2,data,n,0,0,
+    totalshift+pos*ve->searchstep);*/
+
+ /* window and transform */
+  for(i=0;i<n;i++){
+    for(l=0;l<windows;l++)
+      vec[i*MDCT_LANES+l]=data[l][i]*ve->mdct_win[i];
+    for(;l<MDCT_LANES;l++)
+      vec[i*MDCT_LANES+l]=0.f;
+  }
+  mdct_forward_lanes(&ve->mdct,vec,vec);
+
+  /*_analysis_output_always("mdct",seq2,vec,n/2,0,1,0); */
+
+  for(l=0;l<windows;l++){
+    float *o=out+l*(n/4+1);
+#define V(i) vec[(i)*MDCT_LANES+l]
+
+    /* near-DC energy for the spreading function */
+    o[0]=V(0)*V(0)+.7*V(1)*V(1)+.2*V(2)*V(2);
+
+    /* smooth the spectrum.  yes, the MDCT results in all real
+       coefficients, but it still *behaves* like real/imaginary
+       pairs */
+    for(i=0;i<n/2;i+=2){
+      float val=V(i)*V(i)+V(i+1)*V(i+1);
+      o[1+(i>>1)]=todB(&val)*.5f;
+    }
+#undef V
+  }
+}
+
 /* fairly straight threshhold-by-band based until we find something
    that works better and isn't patented. */
 
 static int _ve_amp(envelope_lookup *ve,
                    vorbis_info_psy_global *gi,
-                   float *data,
+                   const float *spectrum,
                    envelope_band *bands,
                    envelope_filter_state *filters){
   long n=ve->winlength;
@@ -102,7 +144,7 @@ static int _ve_amp(envelope_lookup *ve,
      itself (for low power signals) */
 
   float minV=ve->minenergy;
-  float *vec=alloca(n*sizeof(*vec));
+  float *vec=alloca(n/4*sizeof(*vec));
 
   /* stretch is used to gradually lengthen the number of windows
      considered prevoius-to-potential-trigger */
@@ -111,20 +153,10 @@ static int _ve_amp(envelope_lookup *ve,
   if(penalty<0.f)penalty=0.f;
   if(penalty>gi->stretch_penalty)penalty=gi->stretch_penalty;
 
-  /*_analysis_output_always("lpcm",seq2,data,n,0,0,
-    totalshift+pos*ve->searchstep);*/
-
- /* window and transform */
-  for(i=0;i<n;i++)
-    vec[i]=data[i]*ve->mdct_win[i];
-  mdct_forward(&ve->mdct,vec,vec);
-
-  /*_analysis_output_always("mdct",seq2,vec,n/2,0,1,0); */
-
   /* near-DC spreading function; this has nothing to do with
      psychoacoustics, just sidelobe leakage and window size */
   {
-    float temp=vec[0]*vec[0]+.7*vec[1]*vec[1]+.2*vec[2]*vec[2];
+    float temp=spectrum[0];
     int ptr=filters->nearptr;
 
     /* the accumulation is regularly refreshed from scratch to avoid
@@ -145,15 +177,12 @@ static int _ve_amp(envelope_lookup *ve,
     decay=todB(&decay)*.5-15.f;
   }
 
-  /* perform spreading and limiting, also smooth the spectrum.  yes,
-     the MDCT results in all real coefficients, but it still *behaves*
-     like real/imaginary pairs */
-  for(i=0;i<n/2;i+=2){
-    float val=vec[i]*vec[i]+vec[i+1]*vec[i+1];
-    val=todB(&val)*.5f;
+  /* perform spreading and limiting */
+  for(i=0;i<n/4;i++){
+    float val=spectrum[1+i];
     if(val<decay)val=decay;
     if(val<minV)val=minV;
-    vec[i>>1]=val;
+    vec[i]=val;
     decay-=8.;
   }
 
@@ -230,30 +259,57 @@ long _ve_envelope_search(vorbis_dsp_state *v){
     ve->mark=_ogg_realloc(ve->mark,ve->storage*sizeof(*ve->mark));
   }
 
-  for(j=first;j<last;j++){
+  /* the windows (every channel at every search step) are transformed
+     MDCT_LANES at a time, then run through the filters in order */
+  if(last>first){
+    long windows=(last-first)*ve->ch;
+    long specsize=ve->winlength/4+1;
+    float *spectrum=alloca(MDCT_LANES*specsize*sizeof(*spectrum));
+    float *pcm[MDCT_LANES];
+    long w,k;
     int ret=0;
 
-    ve->stretch++;
-    if(ve->stretch>VE_MAXSTRETCH*2)
-      ve->stretch=VE_MAXSTRETCH*2;
+    for(w=0;w<windows;w+=MDCT_LANES){
+      long count=(windows-w<MDCT_LANES?windows-w:MDCT_LANES);
 
-    for(i=0;i<ve->ch;i++){
-      float *pcm=v->pcm[i]+ve->searchstep*(j);
-      ret|=_ve_amp(ve,gi,pcm,ve->band,ve->filter+i*VE_BANDS);
-    }
+      for(k=0;k<count;k++){
+        j=first+(w+k)/ve->ch;
+        i=(w+k)%ve->ch;
+        pcm[k]=v->pcm[i]+ve->searchstep*(j);
+      }
+      _ve_spectrum(ve,pcm,count,spectrum);
 
-    ve->mark[j+VE_POST]=0;
-    if(ret&1){
-      ve->mark[j]=1;
-      ve->mark[j+1]=1;
-    }
+      for(k=0;k<count;k++){
+        j=first+(w+k)/ve->ch;
+        i=(w+k)%ve->ch;
 
-    if(ret&2){
-      ve->mark[j]=1;
-      if(j>0)ve->mark[j-1]=1;
-    }
+        if(i==0){
+          ret=0;
 
-    if(ret&4)ve->stretch=-1;
+          ve->stretch++;
+          if(ve->stretch>VE_MAXSTRETCH*2)
+            ve->stretch=VE_MAXSTRETCH*2;
+        }
+
+        ret|=_ve_amp(ve,gi,spectrum+k*specsize,ve->band,
+                     ve->filter+i*VE_BANDS);
+
+        if(i==ve->ch-1){
+          ve->mark[j+VE_POST]=0;
+          if(ret&1){
+            ve->mark[j]=1;
+            ve->mark[j+1]=1;
+          }
+
+          if(ret&2){
+            ve->mark[j]=1;
+            if(j>0)ve->mark[j-1]=1;
+          }
+
+          if(ret&4)ve->stretch=-1;
+        }
+      }
+    }
   }
 
   ve->current=last*ve->searchstep;
@@ -180,6 +180,7 @@ static void *floor0_inverse1(vorbis_block *vb,vorbis_look_floor *i){
          vector */
       float *lsp=_vorbis_block_alloc(vb,sizeof(*lsp)*(look->m+b->dim+1));
 
+      if(vorbis_book_ready(b))goto eop;
       if(vorbis_book_decodev_set(b,lsp,&vb->opb,look->m)==-1)goto eop;
       for(j=0;j<look->m;){
         for(k=0;j<look->m && k<b->dim;k++,j++)lsp[j]+=last;
@@ -72,6 +72,7 @@ static void floor1_free_look(vorbis_look_floor *i){
   }
 }
 
+#ifndef VORBIS_DECODE_ONLY
 static void floor1_pack (vorbis_info_floor *i,oggpack_buffer *opb){
   vorbis_info_floor1 *info=(vorbis_info_floor1 *)i;
   int j,k;
@@ -109,6 +110,7 @@ static void floor1_pack (vorbis_info_floor *i,oggpack_buffer *opb){
       oggpack_write(opb,info->postlist[k+2],rangebits);
   }
 }
+#endif
 
 static int icomp(const void *a,const void *b){
   return(**(int **)a-**(int **)b);
@@ -271,12 +273,14 @@ static int render_point(int x0,int x1,int y0,int y1,int x){
   }
 }
 
+#ifndef VORBIS_DECODE_ONLY
 static int vorbis_dBquant(const float *x){
   int i= *x*7.3142857f+1023.5f;
   if(i>1023)return(1023);
   if(i<0)return(0);
   return i;
 }
+#endif
 
 static const float FLOOR1_fromdB_LOOKUP[256]={
   1.0649863e-07F, 1.1341951e-07F, 1.2079015e-07F, 1.2863978e-07F,
@@ -374,6 +378,7 @@ static void render_line(int n, int x0,int x1,int y0,int y1,float *d){
   }
 }
 
+#ifndef VORBIS_DECODE_ONLY
 static void render_line0(int n, int x0,int x1,int y0,int y1,int *d){
   int dy=y1-y0;
   int adx=x1-x0;
@@ -952,6 +957,23 @@ int floor1_encode(oggpack_buffer *opb,vorbis_block *vb,
     return(0);
   }
 }
+#endif
+
+/* as for residue books: once every book of the floor is built, this
+   decoder stops readying them partition by partition */
+static void floor1_books(vorbis_look_floor1 *look,codebook *books){
+  vorbis_info_floor1 *info=look->vi;
+  int i,j;
+  for(i=0;i<info->partitions;i++){
+    int class=info->partitionclass[i];
+    if(info->class_subs[class] &&
+       !vorbis_book_ready_p(books+info->class_book[class]))return;
+    for(j=0;j<(1<<info->class_subs[class]);j++)
+      if(info->class_subbook[class][j]>=0 &&
+         !vorbis_book_ready_p(books+info->class_subbook[class][j]))return;
+  }
+  look->booksready=1;
+}
 
 static void *floor1_inverse1(vorbis_block *vb,vorbis_look_floor *in){
   vorbis_look_floor1 *look=(vorbis_look_floor1 *)in;
@@ -960,6 +982,7 @@ static void *floor1_inverse1(vorbis_block *vb,vorbis_look_floor *in){
 
   int i,j,k;
   codebook *books=ci->fullbooks;
+  int ready=look->booksready;
 
   /* unpack wrapped/predicted values from stream */
   if(oggpack_read(&vb->opb,1)==1){
@@ -978,6 +1001,8 @@ static void *floor1_inverse1(vorbis_block *vb,vorbis_look_floor *in){
 
       /* decode the partition's first stage cascade value */
       if(csubbits){
+        if(!ready && vorbis_book_ready(books+info->class_book[class]))
+          goto eop;
         cval=vorbis_book_decode(books+info->class_book[class],&vb->opb);
 
         if(cval==-1)goto eop;
@@ -987,6 +1012,7 @@ static void *floor1_inverse1(vorbis_block *vb,vorbis_look_floor *in){
         int book=info->class_subbook[class][cval&(csub-1)];
         cval>>=csubbits;
         if(book>=0){
+          if(!ready && vorbis_book_ready(books+book))goto eop;
           if((fit_value[j+k]=vorbis_book_decode(books+book,&vb->opb))==-1)
             goto eop;
         }else{
@@ -1033,6 +1059,7 @@ static void *floor1_inverse1(vorbis_block *vb,vorbis_look_floor *in){
 
     }
 
+    if(!ready)floor1_books(look,books);
     return(fit_value);
   }
  eop:
@@ -1081,7 +1108,14 @@ static int floor1_inverse2(vorbis_block *vb,vorbis_look_floor *in,void *memo,
 }
 
 /* export hooks */
+#ifndef VORBIS_DECODE_ONLY
 const vorbis_func_floor floor1_exportbundle={
   &floor1_pack,&floor1_unpack,&floor1_look,&floor1_free_info,
   &floor1_free_look,&floor1_inverse1,&floor1_inverse2
 };
+#else
+const vorbis_func_floor floor1_exportbundle={
+  NULL,&floor1_unpack,&floor1_look,&floor1_free_info,
+  &floor1_free_look,&floor1_inverse1,&floor1_inverse2
+};
+#endif
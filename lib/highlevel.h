@@ -38,10 +38,15 @@ typedef struct highlevel_encode_setup {
   long   bitrate_max;
   long   bitrate_reservoir;
   double bitrate_reservoir_bias;
+  int    bitrate_lookahead;
+  int    twopass;
+  ogg_int64_t twopass_target;
 
   int impulse_block_p;
   int noise_normalize_p;
   int coupling_p;
+  int speed;
+  int lowlatency;
 
   double stereo_point_setting;
   double lowpass_kHz;
@@ -89,43 +89,117 @@ static int tagcompare(const char *s1, const char *s2, int n){
 char *vorbis_comment_query(vorbis_comment *vc, const char *tag, int count){
   long i;
   int found = 0;
-  int taglen = strlen(tag)+1; /* +1 for the = we append */
-  char *fulltag = _ogg_malloc(taglen+1);
-
-  strcpy(fulltag, tag);
-  strcat(fulltag, "=");
+  int taglen = strlen(tag);
 
   for(i=0;i<vc->comments;i++){
-    if(!tagcompare(vc->user_comments[i], fulltag, taglen)){
+    if(!tagcompare(vc->user_comments[i], tag, taglen) &&
+       vc->user_comments[i][taglen] == '='){
       if(count == found) {
         /* We return a pointer to the data, not a copy */
-        _ogg_free(fulltag);
-        return vc->user_comments[i] + taglen;
+        return vc->user_comments[i] + taglen + 1;
       } else {
         found++;
       }
     }
   }
-  _ogg_free(fulltag);
   return NULL; /* didn't find anything */
 }
 
 int vorbis_comment_query_count(vorbis_comment *vc, const char *tag){
   int i,count=0;
-  int taglen = strlen(tag)+1; /* +1 for the = we append */
-  char *fulltag = _ogg_malloc(taglen+1);
-  strcpy(fulltag,tag);
-  strcat(fulltag, "=");
+  int taglen = strlen(tag);
 
   for(i=0;i<vc->comments;i++){
-    if(!tagcompare(vc->user_comments[i], fulltag, taglen))
+    if(!tagcompare(vc->user_comments[i], tag, taglen) &&
+       vc->user_comments[i][taglen] == '=')
       count++;
   }
 
-  _ogg_free(fulltag);
   return count;
 }
 
+/* whether comment is tag=..., the tag compared as tagcompare() does */
+static int tagmatch(const char *comment, const char *tag, int taglen){
+  return !tagcompare(comment, tag, taglen) && comment[taglen] == '=';
+}
+
+/* the hash of a tag; case is folded just as tagcompare() folds it, so
+   tags it finds equal hash equal */
+static unsigned long taghash(const char *tag, int taglen){
+  unsigned long h=2166136261UL;
+  int i;
+  for(i=0;i<taglen;i++)
+    h=((h^(unsigned char)toupper(tag[i]))*16777619UL)&0xffffffffUL;
+  return h;
+}
+
+/* the slot of a tag in the index: the one holding it, else the empty
+   one it would go in.  The table is never more than half full. */
+static int *indexslot(vorbis_comment_index *vci, const char *tag,
+                      int taglen){
+  unsigned long h=taghash(tag,taglen);
+  while(1){
+    int *slot=vci->slots+(h&vci->mask)*2;
+    if(!slot[0] || tagmatch(vci->vc->user_comments[slot[0]-1],tag,taglen))
+      return slot;
+    h++;
+  }
+}
+
+int vorbis_comment_index_init(vorbis_comment_index *vci, vorbis_comment *vc){
+  int i,size=8;
+
+  memset(vci,0,sizeof(*vci));
+  while(size<vc->comments*2)size<<=1;
+  vci->slots=_ogg_calloc(size*2+vc->comments,sizeof(*vci->slots));
+  if(!vci->slots)return(OV_EFAULT);
+  vci->next=vci->slots+size*2;
+  vci->mask=size-1;
+  vci->vc=vc;
+
+  /* chain the comments of each tag; going backwards leaves every
+     chain in comment order */
+  for(i=vc->comments-1;i>=0;i--){
+    const char *eq=strchr(vc->user_comments[i],'=');
+    int *slot;
+    if(!eq)continue; /* can never match a query */
+    slot=indexslot(vci,vc->user_comments[i],eq-vc->user_comments[i]);
+    vci->next[i]=slot[0];
+    slot[0]=i+1;
+    slot[1]++;
+  }
+  return(0);
+}
+
+char *vorbis_comment_index_query(vorbis_comment_index *vci, const char *tag,
+                                 int count){
+  int taglen=strlen(tag);
+  int i;
+
+  if(!vci->slots || count<0)return NULL;
+  /* the index is keyed on the text before the first '=' */
+  if(strchr(tag,'='))return vorbis_comment_query(vci->vc,tag,count);
+
+  i=indexslot(vci,tag,taglen)[0];
+  while(i && count--)
+    i=vci->next[i-1];
+  return i ? vci->vc->user_comments[i-1] + taglen + 1 : NULL;
+}
+
+int vorbis_comment_index_query_count(vorbis_comment_index *vci,
+                                     const char *tag){
+  if(!vci->slots)return 0;
+  if(strchr(tag,'='))return vorbis_comment_query_count(vci->vc,tag);
+  return indexslot(vci,tag,strlen(tag))[1];
+}
+
+void vorbis_comment_index_clear(vorbis_comment_index *vci){
+  if(vci){
+    if(vci->slots)_ogg_free(vci->slots);
+    memset(vci,0,sizeof(*vci));
+  }
+}
+
 void vorbis_comment_clear(vorbis_comment *vc){
   if(vc){
     long i;
@@ -153,46 +227,65 @@ void vorbis_info_init(vorbis_info *vi){
   vi->codec_setup=_ogg_calloc(1,sizeof(codec_setup_info));
 }
 
-void vorbis_info_clear(vorbis_info *vi){
-  codec_setup_info     *ci=vi->codec_setup;
+/* frees the mappings, floors, residues and books, everything of the
+   setup header but the modes */
+static void _vorbis_info_clear_setup(codec_setup_info *ci){
   int i;
 
-  if(ci){
-
-    for(i=0;i<ci->modes;i++)
-      if(ci->mode_param[i])_ogg_free(ci->mode_param[i]);
+  for(i=0;i<ci->maps;i++) /* unpack does the range checking */
+    if(ci->map_param[i]) /* this may be cleaning up an aborted
+                            unpack, in which case the below type
+                            cannot be trusted */
+      _mapping_P[ci->map_type[i]]->free_info(ci->map_param[i]);
 
-    for(i=0;i<ci->maps;i++) /* unpack does the range checking */
-      if(ci->map_param[i]) /* this may be cleaning up an aborted
+  for(i=0;i<ci->floors;i++) /* unpack does the range checking */
+    if(ci->floor_param[i]) /* this may be cleaning up an aborted
                               unpack, in which case the below type
                               cannot be trusted */
-        _mapping_P[ci->map_type[i]]->free_info(ci->map_param[i]);
+      _floor_P[ci->floor_type[i]]->free_info(ci->floor_param[i]);
 
-    for(i=0;i<ci->floors;i++) /* unpack does the range checking */
-      if(ci->floor_param[i]) /* this may be cleaning up an aborted
+  for(i=0;i<ci->residues;i++) /* unpack does the range checking */
+    if(ci->residue_param[i]) /* this may be cleaning up an aborted
                                 unpack, in which case the below type
                                 cannot be trusted */
-        _floor_P[ci->floor_type[i]]->free_info(ci->floor_param[i]);
-
-    for(i=0;i<ci->residues;i++) /* unpack does the range checking */
-      if(ci->residue_param[i]) /* this may be cleaning up an aborted
-                                  unpack, in which case the below type
-                                  cannot be trusted */
-        _residue_P[ci->residue_type[i]]->free_info(ci->residue_param[i]);
-
-    for(i=0;i<ci->books;i++){
-      if(ci->book_param[i]){
-        /* knows if the book was not alloced */
-        vorbis_staticbook_destroy(ci->book_param[i]);
-      }
-      if(ci->fullbooks)
-        vorbis_book_clear(ci->fullbooks+i);
+      _residue_P[ci->residue_type[i]]->free_info(ci->residue_param[i]);
+
+  for(i=0;i<ci->books;i++){
+    if(ci->book_param[i]){
+      /* knows if the book was not alloced */
+      vorbis_staticbook_destroy(ci->book_param[i]);
     }
     if(ci->fullbooks)
-        _ogg_free(ci->fullbooks);
+      vorbis_book_clear(ci->fullbooks+i);
+  }
+  if(ci->fullbooks)
+      _ogg_free(ci->fullbooks);
+
+  memset(ci->map_param,0,sizeof(ci->map_param));
+  memset(ci->floor_param,0,sizeof(ci->floor_param));
+  memset(ci->residue_param,0,sizeof(ci->residue_param));
+  memset(ci->book_param,0,sizeof(ci->book_param));
+  ci->fullbooks=NULL;
+  ci->maps=ci->floors=ci->residues=ci->books=0;
+}
+
+void vorbis_info_clear(vorbis_info *vi){
+  codec_setup_info     *ci=vi->codec_setup;
+  int i;
+
+  if(ci){
 
+    for(i=0;i<ci->modes;i++)
+      if(ci->mode_param[i])_ogg_free(ci->mode_param[i]);
+
+    _vorbis_info_clear_setup(ci);
+    if(ci->setup_header)_ogg_free(ci->setup_header);
+
+#ifndef VORBIS_DECODE_ONLY
     for(i=0;i<ci->psys;i++)
       _vi_psy_free(ci->psy_param[i]);
+    if(ci->bi.twopass_stats)_ogg_free(ci->bi.twopass_stats);
+#endif
 
     _ogg_free(ci);
   }
@@ -264,8 +357,10 @@ static int _vorbis_unpack_comment(vorbis_comment *vc,oggpack_buffer *opb){
 }
 
 /* all of the real encoding details are here.  The modes, books,
-   everything */
-static int _vorbis_unpack_books(vorbis_info *vi,oggpack_buffer *opb){
+   everything.  A skim checks the whole header but keeps only the
+   modes, which is all vorbis_packet_blocksize() needs */
+static int _vorbis_unpack_books(vorbis_info *vi,oggpack_buffer *opb,
+                                int skim){
   codec_setup_info     *ci=vi->codec_setup;
   int i;
 
@@ -273,7 +368,10 @@ static int _vorbis_unpack_books(vorbis_info *vi,oggpack_buffer *opb){
   ci->books=oggpack_read(opb,8)+1;
   if(ci->books<=0)goto err_out;
   for(i=0;i<ci->books;i++){
-    ci->book_param[i]=vorbis_staticbook_unpack(opb);
+    if(skim)
+      ci->book_param[i]=vorbis_staticbook_skim(opb);
+    else
+      ci->book_param[i]=vorbis_staticbook_unpack(opb);
     if(!ci->book_param[i])goto err_out;
   }
 
@@ -335,12 +433,32 @@ static int _vorbis_unpack_books(vorbis_info *vi,oggpack_buffer *opb){
 
   if(oggpack_read(opb,1)!=1)goto err_out; /* top level EOP check */
 
+  if(skim)_vorbis_info_clear_setup(ci);
   return(0);
  err_out:
   vorbis_info_clear(vi);
   return(OV_EBADHEADER);
 }
 
+/* unpacks the rest of a skimmed setup header; nothing to do if the
+   setup is already unpacked */
+int _vorbis_info_load_setup(vorbis_info *vi){
+  codec_setup_info *ci=vi->codec_setup;
+  oggpack_buffer opb;
+  int i;
+
+  if(ci==NULL || ci->setup_header==NULL || ci->books>0)return(0);
+
+  /* the modes are unpacked again along with everything else */
+  for(i=0;i<ci->modes;i++)
+    _ogg_free(ci->mode_param[i]);
+  ci->modes=0;
+
+  oggpack_readinit(&opb,ci->setup_header,ci->setup_bytes);
+  oggpack_adv(&opb,8+6*8); /* packet type and "vorbis" */
+  return(_vorbis_unpack_books(vi,&opb,0));
+}
+
 /* Is this packet a vorbis ID header? */
 int vorbis_synthesis_idheader(ogg_packet *op){
   oggpack_buffer opb;
@@ -371,7 +489,8 @@ int vorbis_synthesis_idheader(ogg_packet *op){
    with bitstream comments and a third packet that holds the
    codebook. */
 
-int vorbis_synthesis_headerin(vorbis_info *vi,vorbis_comment *vc,ogg_packet *op){
+static int _vorbis_headerin(vorbis_info *vi,vorbis_comment *vc,
+                            ogg_packet *op,int skim){
   oggpack_buffer opb;
 
   if(op){
@@ -422,13 +541,25 @@ int vorbis_synthesis_headerin(vorbis_info *vi,vorbis_comment *vc,ogg_packet *op)
           /* improperly initialized vorbis_info */
           return(OV_EFAULT);
         }
-        if(((codec_setup_info *)vi->codec_setup)->books>0){
-          /* previously initialized setup header */
-          return(OV_EBADHEADER);
+        {
+          codec_setup_info *ci=vi->codec_setup;
+          int ret;
+
+          if(ci->books>0 || ci->setup_header){
+            /* previously initialized setup header */
+            return(OV_EBADHEADER);
+          }
+
+          ret=_vorbis_unpack_books(vi,&opb,skim);
+          if(!ret && skim){
+            /* keep the header to unpack the rest from later */
+            ci->setup_header=_ogg_malloc(op->bytes);
+            ci->setup_bytes=op->bytes;
+            memcpy(ci->setup_header,op->packet,op->bytes);
+          }
+          return(ret);
         }
 
-        return(_vorbis_unpack_books(vi,&opb));
-
       default:
         /* Not a valid vorbis header type */
         return(OV_EBADHEADER);
@@ -439,8 +570,32 @@ int vorbis_synthesis_headerin(vorbis_info *vi,vorbis_comment *vc,ogg_packet *op)
   return(OV_EBADHEADER);
 }
 
+int vorbis_synthesis_headerin(vorbis_info *vi,vorbis_comment *vc,ogg_packet *op){
+  return(_vorbis_headerin(vi,vc,op,0));
+}
+
+/* as vorbis_synthesis_headerin, but the setup header is only checked
+   and kept; the books and backend setup are unpacked from it by
+   vorbis_synthesis_init() */
+int vorbis_synthesis_headerskim(vorbis_info *vi,vorbis_comment *vc,
+                                ogg_packet *op){
+  return(_vorbis_headerin(vi,vc,op,1));
+}
+
+/* releases the unpacked setup of an info read by
+   vorbis_synthesis_headerskim(), returning it to the skimmed state.
+   It must not be in use by a vorbis_dsp_state */
+int vorbis_synthesis_unload(vorbis_info *vi){
+  codec_setup_info *ci=vi->codec_setup;
+
+  if(ci==NULL || ci->setup_header==NULL)return(OV_EINVAL);
+  _vorbis_info_clear_setup(ci);
+  return(0);
+}
+
 /* pack side **********************************************************/
 
+#ifndef VORBIS_DECODE_ONLY
 static int _vorbis_pack_info(oggpack_buffer *opb,vorbis_info *vi){
   codec_setup_info     *ci=vi->codec_setup;
   if(!ci||
@@ -468,6 +623,7 @@ static int _vorbis_pack_info(oggpack_buffer *opb,vorbis_info *vi){
 
   return(0);
 }
+#endif
 
 static int _vorbis_pack_comment(oggpack_buffer *opb,vorbis_comment *vc){
   int bytes = strlen(ENCODE_VENDOR_STRING);
@@ -499,6 +655,7 @@ static int _vorbis_pack_comment(oggpack_buffer *opb,vorbis_comment *vc){
   return(0);
 }
 
+#ifndef VORBIS_DECODE_ONLY
 static int _vorbis_pack_books(oggpack_buffer *opb,vorbis_info *vi){
   codec_setup_info     *ci=vi->codec_setup;
   int i;
@@ -554,6 +711,7 @@ static int _vorbis_pack_books(oggpack_buffer *opb,vorbis_info *vi){
 err_out:
   return(-1);
 }
+#endif
 
 int vorbis_commentheader_out(vorbis_comment *vc,
                                           ogg_packet *op){
@@ -579,6 +737,7 @@ int vorbis_commentheader_out(vorbis_comment *vc,
   return 0;
 }
 
+#ifndef VORBIS_DECODE_ONLY
 int vorbis_analysis_headerout(vorbis_dsp_state *v,
                               vorbis_comment *vc,
                               ogg_packet *op,
@@ -658,6 +817,7 @@ int vorbis_analysis_headerout(vorbis_dsp_state *v,
   }
   return(ret);
 }
+#endif
 
 double vorbis_granule_time(vorbis_dsp_state *v,ogg_int64_t granulepos){
   if(granulepos == -1) return -1;
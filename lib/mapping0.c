@@ -45,6 +45,7 @@ static void mapping0_free_info(vorbis_info_mapping *i){
   }
 }
 
+#ifndef VORBIS_DECODE_ONLY
 static void mapping0_pack(vorbis_info *vi,vorbis_info_mapping *vm,
                           oggpack_buffer *opb){
   int i;
@@ -87,6 +88,7 @@ static void mapping0_pack(vorbis_info *vi,vorbis_info_mapping *vm,
     oggpack_write(opb,info->residuesubmap[i],8);
   }
 }
+#endif
 
 /* also responsible for range checking */
 static vorbis_info_mapping *mapping0_unpack(vorbis_info *vi,oggpack_buffer *opb){
@@ -156,6 +158,7 @@ static vorbis_info_mapping *mapping0_unpack(vorbis_info *vi,oggpack_buffer *opb)
 #include "psy.h"
 #include "scales.h"
 
+#ifndef VORBIS_DECODE_ONLY
 #if 0
 static long seq=0;
 static ogg_int64_t total=0;
@@ -229,6 +232,127 @@ static float FLOOR1_fromdB_LOOKUP[256]={
 #endif
 
 
+/*
+  the next phases are performed once per packetblob; once for
+  vbr-only and up to PACKETBLOB times for bitrate managed modes.
+
+  1) encode actual mode being used
+  2) encode the floor for each channel, compute coded mask curve/res
+  3) normalize and couple.
+  4) encode residue
+  5) save packet bytes to the packetblob vector
+
+*/
+static int mapping0_forward_blob(vorbis_block *vb,int k){
+  vorbis_dsp_state      *vd=vb->vd;
+  vorbis_info           *vi=vd->vi;
+  codec_setup_info      *ci=vi->codec_setup;
+  private_state         *b=vb->vd->backend_state;
+  vorbis_block_internal *vbi=(vorbis_block_internal *)vb->internal;
+  int i,j;
+
+  int modenumber=vb->W;
+  vorbis_info_mapping0 *info=ci->map_param[modenumber];
+  vorbis_look_psy *psy_look=b->psy+vbi->blocktype+(vb->W?2:0);
+
+  float  **gmdct=vbi->gmdct;
+  int    **iwork=vbi->iwork;
+  int   ***floor_posts=vbi->floor_posts;
+  int     *nonzero=alloca(sizeof(*nonzero)*vi->channels);
+  int    **couple_bundle=alloca(sizeof(*couple_bundle)*vi->channels);
+  int     *zerobundle=alloca(sizeof(*zerobundle)*vi->channels);
+
+  oggpack_buffer *opb=vbi->packetblob[k];
+
+  /* start out our new packet blob with packet type and mode */
+  /* Encode the packet type */
+  oggpack_write(opb,0,1);
+  /* Encode the modenumber */
+  /* Encode frame mode, pre,post windowsize, then dispatch */
+  oggpack_write(opb,modenumber,b->modebits);
+  if(vb->W){
+    oggpack_write(opb,vb->lW,1);
+    oggpack_write(opb,vb->nW,1);
+  }
+
+  /* encode floor, compute masking curve, sep out residue */
+  for(i=0;i<vi->channels;i++){
+    int submap=info->chmuxlist[i];
+    int *ilogmask=iwork[i];
+
+    nonzero[i]=floor1_encode(opb,vb,b->flr[info->floorsubmap[submap]],
+                             floor_posts[i][k],
+                             ilogmask);
+#if 0
+    {
+      char buf[80];
+      sprintf(buf,"maskI%c%d",i?'R':'L',k);
+      float work[n/2];
+      for(j=0;j<n/2;j++)
+        work[j]=FLOOR1_fromdB_LOOKUP[iwork[i][j]];
+      _analysis_output(buf,seq,work,n/2,1,1,0);
+    }
+#endif
+  }
+
+  /* our iteration is now based on masking curve, not prequant and
+     coupling.  Only one prequant/coupling step */
+
+  /* quantize/couple */
+  /* incomplete implementation that assumes the tree is all depth
+     one, or no tree at all */
+  _vp_couple_quantize_normalize(k,
+                                &ci->psy_g_param,
+                                psy_look,
+                                info,
+                                gmdct,
+                                iwork,
+                                nonzero,
+                                ci->psy_g_param.sliding_lowpass[vb->W][k],
+                                vi->channels);
+
+#if 0
+  for(i=0;i<vi->channels;i++){
+    char buf[80];
+    sprintf(buf,"res%c%d",i?'R':'L',k);
+    float work[n/2];
+    for(j=0;j<n/2;j++)
+      work[j]=iwork[i][j];
+    _analysis_output(buf,seq,work,n/2,1,0,0);
+  }
+#endif
+
+  /* classify and encode by submap */
+  for(i=0;i<info->submaps;i++){
+    int ch_in_bundle=0;
+    long **classifications;
+    int resnum=info->residuesubmap[i];
+
+    for(j=0;j<vi->channels;j++){
+      if(info->chmuxlist[j]==i){
+        zerobundle[ch_in_bundle]=0;
+        if(nonzero[j])zerobundle[ch_in_bundle]=1;
+        couple_bundle[ch_in_bundle++]=iwork[j];
+      }
+    }
+
+    classifications=_residue_P[ci->residue_type[resnum]]->
+      class(vb,b->residue[resnum],couple_bundle,zerobundle,ch_in_bundle);
+
+    ch_in_bundle=0;
+    for(j=0;j<vi->channels;j++)
+      if(info->chmuxlist[j]==i)
+        couple_bundle[ch_in_bundle++]=iwork[j];
+
+    _residue_P[ci->residue_type[resnum]]->
+      forward(opb,vb,b->residue[resnum],
+              couple_bundle,zerobundle,ch_in_bundle,classifications,i);
+  }
+
+  vbi->blobcoded[k]=1;
+  return(0);
+}
+
 static int mapping0_forward(vorbis_block *vb){
   vorbis_dsp_state      *vd=vb->vd;
   vorbis_info           *vi=vd->vi;
@@ -307,41 +431,60 @@ static int mapping0_forward(vorbis_block *vb){
     /* only MDCT right now.... */
     mdct_forward(b->transform[vb->W][0],pcm,gmdct[i]);
 
-    /* FFT yields more accurate tonal estimation (not phase sensitive) */
-    drft_forward(&b->fft_look[vb->W],pcm);
-    logfft[0]=scale_dB+todB(pcm)  + .345; /* + .345 is a hack; the
-                                     original todB estimation used on
-                                     IEEE 754 compliant machines had a
-                                     bug that returned dB values about
-                                     a third of a decibel too high.
-                                     The bug was harmless because
-                                     tunings implicitly took that into
-                                     account.  However, fixing the bug
-                                     in the estimator requires
-                                     changing all the tunings as well.
-                                     For now, it's easier to sync
-                                     things back up here, and
-                                     recalibrate the tunings in the
-                                     next major model upgrade. */
-    local_ampmax[i]=logfft[0];
-    for(j=1;j<n-1;j+=2){
-      float temp=pcm[j]*pcm[j]+pcm[j+1]*pcm[j+1];
-      temp=logfft[(j+1)>>1]=scale_dB+.5f*todB(&temp)  + .345; /* +
-                                     .345 is a hack; the original todB
-                                     estimation used on IEEE 754
-                                     compliant machines had a bug that
-                                     returned dB values about a third
-                                     of a decibel too high.  The bug
-                                     was harmless because tunings
-                                     implicitly took that into
-                                     account.  However, fixing the bug
-                                     in the estimator requires
-                                     changing all the tunings as well.
-                                     For now, it's easier to sync
-                                     things back up here, and
-                                     recalibrate the tunings in the
-                                     next major model upgrade. */
+    if(ci->psy_g_param.speed){
+      /* the speed setting skips the FFT and estimates the tonal
+         spectrum from the MDCT instead.  Each line is summed with its
+         neighbors to even out the MDCT's phase sensitivity; -.93dB
+         centers the estimate on the FFT's (it scatters around it by
+         about 4dB on tones and noise). */
+      float *mdct=gmdct[i];
+      float temp=mdct[0]*mdct[0]+mdct[1]*mdct[1];
+      local_ampmax[i]=logfft[0]=.5f*todB(&temp) + .345 - .93;
+      for(j=1;j<n/2-1;j++){
+        temp=mdct[j-1]*mdct[j-1]+mdct[j]*mdct[j]+mdct[j+1]*mdct[j+1];
+        temp=logfft[j]=.5f*todB(&temp) + .345 - .93;
+        if(temp>local_ampmax[i])local_ampmax[i]=temp;
+      }
+      temp=mdct[j-1]*mdct[j-1]+mdct[j]*mdct[j];
+      temp=logfft[j]=.5f*todB(&temp) + .345 - .93;
       if(temp>local_ampmax[i])local_ampmax[i]=temp;
+    }else{
+      /* FFT yields more accurate tonal estimation (not phase sensitive) */
+      drft_forward(&b->fft_look[vb->W],pcm);
+      logfft[0]=scale_dB+todB(pcm)  + .345; /* + .345 is a hack; the
+                                       original todB estimation used on
+                                       IEEE 754 compliant machines had a
+                                       bug that returned dB values about
+                                       a third of a decibel too high.
+                                       The bug was harmless because
+                                       tunings implicitly took that into
+                                       account.  However, fixing the bug
+                                       in the estimator requires
+                                       changing all the tunings as well.
+                                       For now, it's easier to sync
+                                       things back up here, and
+                                       recalibrate the tunings in the
+                                       next major model upgrade. */
+      local_ampmax[i]=logfft[0];
+      for(j=1;j<n-1;j+=2){
+        float temp=pcm[j]*pcm[j]+pcm[j+1]*pcm[j+1];
+        temp=logfft[(j+1)>>1]=scale_dB+.5f*todB(&temp)  + .345; /* +
+                                       .345 is a hack; the original todB
+                                       estimation used on IEEE 754
+                                       compliant machines had a bug that
+                                       returned dB values about a third
+                                       of a decibel too high.  The bug
+                                       was harmless because tunings
+                                       implicitly took that into
+                                       account.  However, fixing the bug
+                                       in the estimator requires
+                                       changing all the tunings as well.
+                                       For now, it's easier to sync
+                                       things back up here, and
+                                       recalibrate the tunings in the
+                                       next major model upgrade. */
+        if(temp>local_ampmax[i])local_ampmax[i]=temp;
+      }
     }
 
     if(local_ampmax[i]>0.f)local_ampmax[i]=0.f;
@@ -577,126 +720,27 @@ static int mapping0_forward(vorbis_block *vb){
   }
   vbi->ampmax=global_ampmax;
 
-  /*
-    the next phases are performed once for vbr-only and PACKETBLOB
-    times for bitrate managed modes.
-
-    1) encode actual mode being used
-    2) encode the floor for each channel, compute coded mask curve/res
-    3) normalize and couple.
-    4) encode residue
-    5) save packet bytes to the packetblob vector
-
-  */
-
-  /* iterate over the many masking curve fits we've created */
-
-  {
-    int **couple_bundle=alloca(sizeof(*couple_bundle)*vi->channels);
-    int *zerobundle=alloca(sizeof(*zerobundle)*vi->channels);
-
-    for(k=(vorbis_bitrate_managed(vb)?0:PACKETBLOBS/2);
-        k<=(vorbis_bitrate_managed(vb)?PACKETBLOBS-1:PACKETBLOBS/2);
-        k++){
-      oggpack_buffer *opb=vbi->packetblob[k];
-
-      /* start out our new packet blob with packet type and mode */
-      /* Encode the packet type */
-      oggpack_write(opb,0,1);
-      /* Encode the modenumber */
-      /* Encode frame mode, pre,post windowsize, then dispatch */
-      oggpack_write(opb,modenumber,b->modebits);
-      if(vb->W){
-        oggpack_write(opb,vb->lW,1);
-        oggpack_write(opb,vb->nW,1);
-      }
-
-      /* encode floor, compute masking curve, sep out residue */
-      for(i=0;i<vi->channels;i++){
-        int submap=info->chmuxlist[i];
-        int *ilogmask=iwork[i];
-
-        nonzero[i]=floor1_encode(opb,vb,b->flr[info->floorsubmap[submap]],
-                                 floor_posts[i][k],
-                                 ilogmask);
-#if 0
-        {
-          char buf[80];
-          sprintf(buf,"maskI%c%d",i?'R':'L',k);
-          float work[n/2];
-          for(j=0;j<n/2;j++)
-            work[j]=FLOOR1_fromdB_LOOKUP[iwork[i][j]];
-          _analysis_output(buf,seq,work,n/2,1,1,0);
-        }
-#endif
-      }
-
-      /* our iteration is now based on masking curve, not prequant and
-         coupling.  Only one prequant/coupling step */
-
-      /* quantize/couple */
-      /* incomplete implementation that assumes the tree is all depth
-         one, or no tree at all */
-      _vp_couple_quantize_normalize(k,
-                                    &ci->psy_g_param,
-                                    psy_look,
-                                    info,
-                                    gmdct,
-                                    iwork,
-                                    nonzero,
-                                    ci->psy_g_param.sliding_lowpass[vb->W][k],
-                                    vi->channels);
-
-#if 0
-      for(i=0;i<vi->channels;i++){
-        char buf[80];
-        sprintf(buf,"res%c%d",i?'R':'L',k);
-        float work[n/2];
-        for(j=0;j<n/2;j++)
-          work[j]=iwork[i][j];
-        _analysis_output(buf,seq,work,n/2,1,0,0);
-      }
-#endif
-
-      /* classify and encode by submap */
-      for(i=0;i<info->submaps;i++){
-        int ch_in_bundle=0;
-        long **classifications;
-        int resnum=info->residuesubmap[i];
-
-        for(j=0;j<vi->channels;j++){
-          if(info->chmuxlist[j]==i){
-            zerobundle[ch_in_bundle]=0;
-            if(nonzero[j])zerobundle[ch_in_bundle]=1;
-            couple_bundle[ch_in_bundle++]=iwork[j];
-          }
-        }
-
-        classifications=_residue_P[ci->residue_type[resnum]]->
-          class(vb,b->residue[resnum],couple_bundle,zerobundle,ch_in_bundle);
-
-        ch_in_bundle=0;
-        for(j=0;j<vi->channels;j++)
-          if(info->chmuxlist[j]==i)
-            couple_bundle[ch_in_bundle++]=iwork[j];
-
-        _residue_P[ci->residue_type[resnum]]->
-          forward(opb,vb,b->residue[resnum],
-                  couple_bundle,zerobundle,ch_in_bundle,classifications,i);
-      }
-
-      /* ok, done encoding.  Next protopacket. */
-    }
-
-  }
+  /* keep what the packetblobs are coded from; it lives in block
+     storage until the next vorbis_analysis_blockout() */
+  vbi->gmdct=gmdct;
+  vbi->iwork=iwork;
+  vbi->floor_posts=floor_posts;
+  memset(vbi->blobcoded,0,sizeof(vbi->blobcoded));
 
 #if 0
   seq++;
   total+=ci->blocksizes[vb->W]/4+ci->blocksizes[vb->nW]/4;
 #endif
-  return(0);
+
+  /* a managed encode codes packetblobs as the bitrate manager asks
+     for them (vorbis_bitrate_addblock()); otherwise there's only
+     the one */
+  if(vorbis_bitrate_managed(vb))return(0);
+  return(mapping0_forward_blob(vb,PACKETBLOBS/2));
 }
 
+#endif
+
 static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
   vorbis_dsp_state     *vd=vb->vd;
   vorbis_info          *vi=vd->vi;
@@ -801,10 +845,22 @@ static int mapping0_inverse(vorbis_block *vb,vorbis_info_mapping *l){
 }
 
 /* export hooks */
+#ifndef VORBIS_DECODE_ONLY
 const vorbis_func_mapping mapping0_exportbundle={
   &mapping0_pack,
   &mapping0_unpack,
   &mapping0_free_info,
   &mapping0_forward,
+  &mapping0_forward_blob,
   &mapping0_inverse
 };
+#else
+const vorbis_func_mapping mapping0_exportbundle={
+  NULL,
+  &mapping0_unpack,
+  &mapping0_free_info,
+  NULL,
+  NULL,
+  &mapping0_inverse
+};
+#endif
@@ -561,3 +561,388 @@ void mdct_forward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){
     T+=2;
   }
 }
+
+
+#ifndef VORBIS_DECODE_ONLY
+/* The lane transform: a copy of the butterflies, the bit reverse and
+   the forward rotation above that runs 'lanes' transforms at once,
+   interleaved so that element i of lane l is at x[i*lanes+l]; the
+   lane loops are innermost so they vectorize.  The single transforms
+   keep their own code, as sharing it changes how the compiler orders
+   their float operations and with it the encoded bitstream. */
+#define X(p,i) (p)[(i)*lanes+l]
+
+/* 8 point butterfly (in place, 4 register) */
+STIN void mdct_lanes_butterfly_8(DATA_TYPE *x,int lanes){
+  int l;
+  for(l=0;l<lanes;l++){
+    REG_TYPE r0   = X(x,6) + X(x,2);
+    REG_TYPE r1   = X(x,6) - X(x,2);
+    REG_TYPE r2   = X(x,4) + X(x,0);
+    REG_TYPE r3   = X(x,4) - X(x,0);
+
+             X(x,6) = r0   + r2;
+             X(x,4) = r0   - r2;
+
+             r0   = X(x,5) - X(x,1);
+             r2   = X(x,7) - X(x,3);
+             X(x,0) = r1   + r0;
+             X(x,2) = r1   - r0;
+
+             r0   = X(x,5) + X(x,1);
+             r1   = X(x,7) + X(x,3);
+             X(x,3) = r2   + r3;
+             X(x,1) = r2   - r3;
+             X(x,7) = r1   + r0;
+             X(x,5) = r1   - r0;
+  }
+}
+
+/* 16 point butterfly (in place, 4 register) */
+STIN void mdct_lanes_butterfly_16(DATA_TYPE *x,int lanes){
+  int l;
+  for(l=0;l<lanes;l++){
+    REG_TYPE r0     = X(x,1)  - X(x,9);
+    REG_TYPE r1     = X(x,0)  - X(x,8);
+
+             X(x,8)  += X(x,0);
+             X(x,9)  += X(x,1);
+             X(x,0)   = MULT_NORM((r0   + r1) * cPI2_8);
+             X(x,1)   = MULT_NORM((r0   - r1) * cPI2_8);
+
+             r0     = X(x,3)  - X(x,11);
+             r1     = X(x,10) - X(x,2);
+             X(x,10) += X(x,2);
+             X(x,11) += X(x,3);
+             X(x,2)   = r0;
+             X(x,3)   = r1;
+
+             r0     = X(x,12) - X(x,4);
+             r1     = X(x,13) - X(x,5);
+             X(x,12) += X(x,4);
+             X(x,13) += X(x,5);
+             X(x,4)   = MULT_NORM((r0   - r1) * cPI2_8);
+             X(x,5)   = MULT_NORM((r0   + r1) * cPI2_8);
+
+             r0     = X(x,14) - X(x,6);
+             r1     = X(x,15) - X(x,7);
+             X(x,14) += X(x,6);
+             X(x,15) += X(x,7);
+             X(x,6)  = r0;
+             X(x,7)  = r1;
+  }
+
+  mdct_lanes_butterfly_8(x,lanes);
+  mdct_lanes_butterfly_8(x+8*lanes,lanes);
+}
+
+/* 32 point butterfly (in place, 4 register) */
+STIN void mdct_lanes_butterfly_32(DATA_TYPE *x,int lanes){
+  int l;
+  for(l=0;l<lanes;l++){
+    REG_TYPE r0     = X(x,30) - X(x,14);
+    REG_TYPE r1     = X(x,31) - X(x,15);
+
+             X(x,30) +=         X(x,14);
+             X(x,31) +=         X(x,15);
+             X(x,14)  =         r0;
+             X(x,15)  =         r1;
+
+             r0     = X(x,28) - X(x,12);
+             r1     = X(x,29) - X(x,13);
+             X(x,28) +=         X(x,12);
+             X(x,29) +=         X(x,13);
+             X(x,12)  = MULT_NORM( r0 * cPI1_8  -  r1 * cPI3_8 );
+             X(x,13)  = MULT_NORM( r0 * cPI3_8  +  r1 * cPI1_8 );
+
+             r0     = X(x,26) - X(x,10);
+             r1     = X(x,27) - X(x,11);
+             X(x,26) +=         X(x,10);
+             X(x,27) +=         X(x,11);
+             X(x,10)  = MULT_NORM(( r0  - r1 ) * cPI2_8);
+             X(x,11)  = MULT_NORM(( r0  + r1 ) * cPI2_8);
+
+             r0     = X(x,24) - X(x,8);
+             r1     = X(x,25) - X(x,9);
+             X(x,24) += X(x,8);
+             X(x,25) += X(x,9);
+             X(x,8)   = MULT_NORM( r0 * cPI3_8  -  r1 * cPI1_8 );
+             X(x,9)   = MULT_NORM( r1 * cPI3_8  +  r0 * cPI1_8 );
+
+             r0     = X(x,22) - X(x,6);
+             r1     = X(x,7)  - X(x,23);
+             X(x,22) += X(x,6);
+             X(x,23) += X(x,7);
+             X(x,6)   = r1;
+             X(x,7)   = r0;
+
+             r0     = X(x,4)  - X(x,20);
+             r1     = X(x,5)  - X(x,21);
+             X(x,20) += X(x,4);
+             X(x,21) += X(x,5);
+             X(x,4)   = MULT_NORM( r1 * cPI1_8  +  r0 * cPI3_8 );
+             X(x,5)   = MULT_NORM( r1 * cPI3_8  -  r0 * cPI1_8 );
+
+             r0     = X(x,2)  - X(x,18);
+             r1     = X(x,3)  - X(x,19);
+             X(x,18) += X(x,2);
+             X(x,19) += X(x,3);
+             X(x,2)   = MULT_NORM(( r1  + r0 ) * cPI2_8);
+             X(x,3)   = MULT_NORM(( r1  - r0 ) * cPI2_8);
+
+             r0     = X(x,0)  - X(x,16);
+             r1     = X(x,1)  - X(x,17);
+             X(x,16) += X(x,0);
+             X(x,17) += X(x,1);
+             X(x,0)   = MULT_NORM( r1 * cPI3_8  +  r0 * cPI1_8 );
+             X(x,1)   = MULT_NORM( r1 * cPI1_8  -  r0 * cPI3_8 );
+  }
+
+  mdct_lanes_butterfly_16(x,lanes);
+  mdct_lanes_butterfly_16(x+16*lanes,lanes);
+
+}
+
+/* one pass of the N point stage butterflies below; T0..T3 are the
+   twiddles for the four pairs */
+STIN void mdct_lanes_butterfly_step(DATA_TYPE *x1,DATA_TYPE *x2,
+                              DATA_TYPE *T0,DATA_TYPE *T1,
+                              DATA_TYPE *T2,DATA_TYPE *T3,int lanes){
+  int l;
+  for(l=0;l<lanes;l++){
+    REG_TYPE r0,r1;
+
+             r0      = X(x1,6)      -  X(x2,6);
+             r1      = X(x1,7)      -  X(x2,7);
+             X(x1,6)  += X(x2,6);
+             X(x1,7)  += X(x2,7);
+             X(x2,6)   = MULT_NORM(r1 * T0[1]  +  r0 * T0[0]);
+             X(x2,7)   = MULT_NORM(r1 * T0[0]  -  r0 * T0[1]);
+
+             r0      = X(x1,4)      -  X(x2,4);
+             r1      = X(x1,5)      -  X(x2,5);
+             X(x1,4)  += X(x2,4);
+             X(x1,5)  += X(x2,5);
+             X(x2,4)   = MULT_NORM(r1 * T1[1]  +  r0 * T1[0]);
+             X(x2,5)   = MULT_NORM(r1 * T1[0]  -  r0 * T1[1]);
+
+             r0      = X(x1,2)      -  X(x2,2);
+             r1      = X(x1,3)      -  X(x2,3);
+             X(x1,2)  += X(x2,2);
+             X(x1,3)  += X(x2,3);
+             X(x2,2)   = MULT_NORM(r1 * T2[1]  +  r0 * T2[0]);
+             X(x2,3)   = MULT_NORM(r1 * T2[0]  -  r0 * T2[1]);
+
+             r0      = X(x1,0)      -  X(x2,0);
+             r1      = X(x1,1)      -  X(x2,1);
+             X(x1,0)  += X(x2,0);
+             X(x1,1)  += X(x2,1);
+             X(x2,0)   = MULT_NORM(r1 * T3[1] +  r0 * T3[0]);
+             X(x2,1)   = MULT_NORM(r1 * T3[0] -  r0 * T3[1]);
+  }
+}
+
+/* N point first stage butterfly (in place, 2 register) */
+STIN void mdct_lanes_butterfly_first(DATA_TYPE *T,
+                                        DATA_TYPE *x,
+                                        int points,
+                                        int lanes){
+
+  DATA_TYPE *x1        = x          + (points      - 8)*lanes;
+  DATA_TYPE *x2        = x          + ((points>>1) - 8)*lanes;
+
+  do{
+
+    mdct_lanes_butterfly_step(x1,x2,T,T+4,T+8,T+12,lanes);
+
+    x1-=8*lanes;
+    x2-=8*lanes;
+    T+=16;
+
+  }while(x2>=x);
+}
+
+/* N/stage point generic N stage butterfly (in place, 2 register) */
+STIN void mdct_lanes_butterfly_generic(DATA_TYPE *T,
+                                          DATA_TYPE *x,
+                                          int points,
+                                          int trigint,
+                                          int lanes){
+
+  DATA_TYPE *x1        = x          + (points      - 8)*lanes;
+  DATA_TYPE *x2        = x          + ((points>>1) - 8)*lanes;
+
+  do{
+
+    mdct_lanes_butterfly_step(x1,x2,T,T+trigint,T+2*trigint,T+3*trigint,lanes);
+
+    T+=4*trigint;
+    x1-=8*lanes;
+    x2-=8*lanes;
+
+  }while(x2>=x);
+}
+
+STIN void mdct_lanes_butterflies(mdct_lookup *init,
+                             DATA_TYPE *x,
+                             int points,
+                             int lanes){
+
+  DATA_TYPE *T=init->trig;
+  int stages=init->log2n-5;
+  int i,j;
+
+  if(--stages>0){
+    mdct_lanes_butterfly_first(T,x,points,lanes);
+  }
+
+  for(i=1;--stages>0;i++){
+    for(j=0;j<(1<<i);j++)
+      mdct_lanes_butterfly_generic(T,x+(points>>i)*j*lanes,points>>i,4<<i,lanes);
+  }
+
+  for(j=0;j<points;j+=32)
+    mdct_lanes_butterfly_32(x+j*lanes,lanes);
+
+}
+
+STIN void mdct_lanes_bitreverse(mdct_lookup *init,
+                            DATA_TYPE *x,
+                            int lanes){
+  int        n       = init->n;
+  int       *bit     = init->bitrev;
+  DATA_TYPE *w0      = x;
+  DATA_TYPE *w1      = x = w0+(n>>1)*lanes;
+  DATA_TYPE *T       = init->trig+n;
+  int        l;
+
+  do{
+    DATA_TYPE *x0    = x+bit[0]*lanes;
+    DATA_TYPE *x1    = x+bit[1]*lanes;
+    DATA_TYPE *x2    = x+bit[2]*lanes;
+    DATA_TYPE *x3    = x+bit[3]*lanes;
+
+              w1    -= 4*lanes;
+
+    for(l=0;l<lanes;l++){
+      REG_TYPE  r0     = X(x0,1)  - X(x1,1);
+      REG_TYPE  r1     = X(x0,0)  + X(x1,0);
+      REG_TYPE  r2     = MULT_NORM(r1     * T[0]   + r0 * T[1]);
+      REG_TYPE  r3     = MULT_NORM(r1     * T[1]   - r0 * T[0]);
+
+                r0     = HALVE(X(x0,1) + X(x1,1));
+                r1     = HALVE(X(x0,0) - X(x1,0));
+
+                X(w0,0)  = r0     + r2;
+                X(w1,2)  = r0     - r2;
+                X(w0,1)  = r1     + r3;
+                X(w1,3)  = r3     - r1;
+
+                r0     = X(x2,1)  - X(x3,1);
+                r1     = X(x2,0)  + X(x3,0);
+                r2     = MULT_NORM(r1     * T[2]   + r0 * T[3]);
+                r3     = MULT_NORM(r1     * T[3]   - r0 * T[2]);
+
+                r0     = HALVE(X(x2,1) + X(x3,1));
+                r1     = HALVE(X(x2,0) - X(x3,0));
+
+                X(w0,2)  = r0     + r2;
+                X(w1,0)  = r0     - r2;
+                X(w0,3)  = r1     + r3;
+                X(w1,1)  = r3     - r1;
+    }
+
+              T     += 4;
+              bit   += 4;
+              w0    += 4*lanes;
+
+  }while(w0<w1);
+}
+
+STIN void mdct_lanes_forward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out,
+                        int lanes){
+  int n=init->n;
+  int n2=n>>1;
+  int n4=n>>2;
+  int n8=n>>3;
+  DATA_TYPE *w=alloca(n*lanes*sizeof(*w)); /* forward needs working space */
+  DATA_TYPE *w2=w+n2*lanes;
+
+  /* rotate */
+
+  /* window + rotate + step 1 */
+
+  DATA_TYPE *x0=in+(n2+n4)*lanes;
+  DATA_TYPE *x1=x0+lanes;
+  DATA_TYPE *T=init->trig+n2;
+
+  int i=0,l;
+
+  for(i=0;i<n8;i+=2){
+    x0 -=4*lanes;
+    T-=2;
+    for(l=0;l<lanes;l++){
+      REG_TYPE r0= X(x0,2) + X(x1,0);
+      REG_TYPE r1= X(x0,0) + X(x1,2);
+      X(w2,i)=   MULT_NORM(r1*T[1] + r0*T[0]);
+      X(w2,i+1)= MULT_NORM(r1*T[0] - r0*T[1]);
+    }
+    x1 +=4*lanes;
+  }
+
+  x1=in+lanes;
+
+  for(;i<n2-n8;i+=2){
+    T-=2;
+    x0 -=4*lanes;
+    for(l=0;l<lanes;l++){
+      REG_TYPE r0= X(x0,2) - X(x1,0);
+      REG_TYPE r1= X(x0,0) - X(x1,2);
+      X(w2,i)=   MULT_NORM(r1*T[1] + r0*T[0]);
+      X(w2,i+1)= MULT_NORM(r1*T[0] - r0*T[1]);
+    }
+    x1 +=4*lanes;
+  }
+
+  x0=in+n*lanes;
+
+  for(;i<n2;i+=2){
+    T-=2;
+    x0 -=4*lanes;
+    for(l=0;l<lanes;l++){
+      REG_TYPE r0= -X(x0,2) - X(x1,0);
+      REG_TYPE r1= -X(x0,0) - X(x1,2);
+      X(w2,i)=   MULT_NORM(r1*T[1] + r0*T[0]);
+      X(w2,i+1)= MULT_NORM(r1*T[0] - r0*T[1]);
+    }
+    x1 +=4*lanes;
+  }
+
+
+  mdct_lanes_butterflies(init,w+n2*lanes,n2,lanes);
+  mdct_lanes_bitreverse(init,w,lanes);
+
+  /* roatate + window */
+
+  T=init->trig+n2;
+  x0=out+n2*lanes;
+
+  for(i=0;i<n4;i++){
+    x0-=lanes;
+    for(l=0;l<lanes;l++){
+      X(out,i) =MULT_NORM((X(w,0)*T[0]+X(w,1)*T[1])*init->scale);
+      X(x0,0)  =MULT_NORM((X(w,0)*T[1]-X(w,1)*T[0])*init->scale);
+    }
+    w+=2*lanes;
+    T+=2;
+  }
+}
+
+#undef X
+
+/* MDCT_LANES forward transforms at once, for the encoder's envelope
+   search; each lane gets exactly the result mdct_forward() would */
+void mdct_forward_lanes(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out){
+  mdct_lanes_forward(init,in,out,MDCT_LANES);
+}
+#endif
@@ -68,4 +68,11 @@ extern void mdct_clear(mdct_lookup *l);
 extern void mdct_forward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out);
 extern void mdct_backward(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out);
 
+/* MDCT_LANES transforms of the same size at once, interleaved: element
+   i of transform l is at [i*MDCT_LANES+l] in both in and out */
+#define MDCT_LANES 4
+#ifndef VORBIS_DECODE_ONLY
+extern void mdct_forward_lanes(mdct_lookup *init, DATA_TYPE *in, DATA_TYPE *out);
+#endif
+
 #endif
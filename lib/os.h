@@ -188,4 +188,23 @@ static int vorbis_ftoi(double f){
 
 #endif /* default implementation */
 
+/* Atomic access to a long shared between decoders; acquire loads,
+   release stores and a compare-and-swap returning nonzero on success.
+   VORBIS_ATOMICS is left undefined where there is none. */
+#if defined(__ATOMIC_ACQUIRE)
+#  define VORBIS_ATOMICS
+#  define vorbis_atomic_load(p)    __atomic_load_n(p,__ATOMIC_ACQUIRE)
+#  define vorbis_atomic_store(p,v) __atomic_store_n(p,v,__ATOMIC_RELEASE)
+#  define vorbis_atomic_cas(p,o,n) __sync_bool_compare_and_swap(p,o,n)
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define VORBIS_ATOMICS
+#  define vorbis_atomic_load(p) \
+     _InterlockedCompareExchange((volatile long *)(p),0,0)
+#  define vorbis_atomic_store(p,v) \
+     _InterlockedExchange((volatile long *)(p),v)
+#  define vorbis_atomic_cas(p,o,n) \
+     (_InterlockedCompareExchange((volatile long *)(p),n,o)==(o))
+#endif
+
 #endif /* _OS_H */
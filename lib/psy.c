@@ -271,6 +271,7 @@ void _vp_psy_init(vorbis_look_psy *p,vorbis_info_psy *vi,
   memset(p,0,sizeof(*p));
 
   p->eighth_octave_lines=gi->eighth_octave_lines;
+  p->speed=gi->speed;
   p->shiftoc=rint(log(gi->eighth_octave_lines*8.f)/log(2.f))-1;
 
   p->firstoc=toOC(.25f*rate*.5/n)*(1<<(p->shiftoc+1))-gi->eighth_octave_lines;
@@ -389,7 +390,7 @@ static void seed_curve(float *seed,
                        float amp,
                        int oc, int n,
                        int linesper,float dBoffset){
-  int i,post1;
+  int i,post0,post1;
   int seedptr;
   const float *posts,*curve;
 
@@ -398,16 +399,32 @@ static void seed_curve(float *seed,
   choice=min(choice,P_LEVELS-1);
   posts=curves[choice];
   curve=posts+2;
+  post0=(int)posts[0];
   post1=(int)posts[1];
   seedptr=oc+(posts[0]-EHMER_OFFSET)*linesper-(linesper>>1);
 
-  for(i=posts[0];i<post1;i++){
-    if(seedptr>0){
-      float lin=amp+curve[i];
-      if(seed[seedptr]<lin)seed[seedptr]=lin;
-    }
+  /* the walk stops after the first post whose successor would land
+     at or past n; trim the range up front so the loop below carries
+     no bounds tests */
+  if(seedptr+linesper>=n){
+    if(post1>post0+1)post1=post0+1;
+  }else{
+    int last=post0+(n-seedptr-1)/linesper;
+    if(post1>last+1)post1=last+1;
+  }
+
+  /* and posts left of line 1 are skipped */
+  if(seedptr<=0){
+    int skip=-seedptr/linesper+1;
+    post0+=skip;
+    seedptr+=skip*linesper;
+  }
+
+  for(i=post0;i<post1;i++){
+    float lin=amp+curve[i];
+    float cur=seed[seedptr];
+    seed[seedptr]=(cur<lin?lin:cur);
     seedptr+=linesper;
-    if(seedptr>=n)break;
   }
 }
 
@@ -427,8 +444,8 @@ static void seed_loop(vorbis_look_psy *p,
     float max=f[i];
     long oc=p->octave[i];
     while(i+1<n && p->octave[i+1]==oc){
-      i++;
-      if(f[i]>max)max=f[i];
+      float v=f[++i];
+      max=(v>max?v:max);
     }
 
     if(max+6.f>flr[i]){
@@ -455,32 +472,25 @@ static void seed_chase(float *seeds, int linesper, long n){
   long   pos=0;
   long   i;
 
-  for(i=0;i<n;i++){
-    if(stack<2){
-      posstack[stack]=i;
-      ampstack[stack++]=seeds[i];
-    }else{
-      while(1){
-        if(seeds[i]<ampstack[stack-1]){
-          posstack[stack]=i;
-          ampstack[stack++]=seeds[i];
-          break;
-        }else{
-          if(i<posstack[stack-1]+linesper){
-            if(stack>1 && ampstack[stack-1]<=ampstack[stack-2] &&
-               i<posstack[stack-2]+linesper){
-              /* we completely overlap, making stack-1 irrelevant.  pop it */
-              stack--;
-              continue;
-            }
-          }
-          posstack[stack]=i;
-          ampstack[stack++]=seeds[i];
-          break;
+  for(i=0;i<n && i<2;i++){
+    posstack[stack]=i;
+    ampstack[stack++]=seeds[i];
+  }
 
-        }
-      }
-    }
+  for(;i<n;i++){
+    float v=seeds[i];
+
+    /* a new value at least as loud as the top of the stack completely
+       overlaps it when both of the top two are still within reach;
+       pop those */
+    while(stack>1 && !(v<ampstack[stack-1]) &&
+          i<posstack[stack-1]+linesper &&
+          ampstack[stack-1]<=ampstack[stack-2] &&
+          i<posstack[stack-2]+linesper)
+      stack--;
+
+    posstack[stack]=i;
+    ampstack[stack++]=v;
   }
 
   /* the stack now contains only the positions that are relevant. Scan
@@ -522,25 +532,33 @@ static void max_seeds(vorbis_look_psy *p,
     float minV=seed[pos];
     long end=((p->octave[linpos]+p->octave[linpos+1])>>1)-p->firstoc;
     if(minV>p->vi->tone_abs_limit)minV=p->vi->tone_abs_limit;
-    while(pos+1<=end){
-      pos++;
-      if((seed[pos]>NEGINF && seed[pos]<minV) || minV==NEGINF)
-        minV=seed[pos];
+    for(;pos<end;pos++){
+      float v=seed[pos+1];
+      minV=((v>NEGINF && v<minV) || minV==NEGINF ? v : minV);
     }
 
     end=pos+p->firstoc;
-    for(;linpos<p->n && p->octave[linpos]<=end;linpos++)
-      if(flr[linpos]<minV)flr[linpos]=minV;
+    for(;linpos<p->n && p->octave[linpos]<=end;linpos++){
+      float v=flr[linpos];
+      flr[linpos]=(v<minV?minV:v);
+    }
   }
 
   {
     float minV=seed[p->total_octave_lines-1];
-    for(;linpos<p->n;linpos++)
-      if(flr[linpos]<minV)flr[linpos]=minV;
+    for(;linpos<p->n;linpos++){
+      float v=flr[linpos];
+      flr[linpos]=(v<minV?minV:v);
+    }
   }
 
 }
 
+/* Weighted linear regression of f over sliding windows, evaluated
+   from running sums of the weighted moments, so the whole estimate is
+   linear in n.  The fixed-width passes find their bounds up front and
+   carry no state between lines, which leaves them free to vectorize;
+   the bark-width passes gather their bounds from b[] and stay scalar. */
 static void bark_noise_hybridmp(int n,const long *b,
                                 const float *f,
                                 float *noise,
@@ -554,7 +572,7 @@ static void bark_noise_hybridmp(int n,const long *b,
   float *XY=alloca(n*sizeof(*N));
 
   float tN, tX, tXX, tY, tXY;
-  int i;
+  int i,i0,i1;
 
   int lo, hi;
   float R=0.f;
@@ -652,10 +670,15 @@ static void bark_noise_hybridmp(int n,const long *b,
 
   if (fixed <= 0) return;
 
-  for (i = 0, x = 0.f;; i++, x += 1.f) {
+  /* the same again over fixed-width windows, keeping the minimum */
+  i0 = fixed - fixed / 2;
+  i1 = n - fixed / 2;
+  if (i1 < i0) i1 = i0;
+
+  for (i = 0; i < i0; i++) {
     hi = i + fixed / 2;
     lo = hi - fixed;
-    if(lo>=0)break;
+    x = i;
 
     tN = N[hi] + N[-lo];
     tX = X[hi] - X[-lo];
@@ -663,19 +686,18 @@ static void bark_noise_hybridmp(int n,const long *b,
     tY = Y[hi] + Y[-lo];
     tXY = XY[hi] - XY[-lo];
 
-
     A = tY * tXX - tX * tXY;
     B = tN * tXY - tX * tY;
     D = tN * tXX - tX * tX;
-    R = (A + x * B) / D;
+    R = (A + x * B) / D - offset;
 
-    if (R - offset < noise[i]) noise[i] = R - offset;
+    noise[i] = (R < noise[i] ? R : noise[i]);
   }
-  for ( ;; i++, x += 1.f) {
 
+  for (i = i0; i < i1; i++) {
     hi = i + fixed / 2;
     lo = hi - fixed;
-    if(hi>=n)break;
+    x = i;
 
     tN = N[hi] - N[lo];
     tX = X[hi] - X[lo];
@@ -686,13 +708,15 @@ static void bark_noise_hybridmp(int n,const long *b,
     A = tY * tXX - tX * tXY;
     B = tN * tXY - tX * tY;
     D = tN * tXX - tX * tX;
-    R = (A + x * B) / D;
+    R = (A + x * B) / D - offset;
 
-    if (R - offset < noise[i]) noise[i] = R - offset;
+    noise[i] = (R < noise[i] ? R : noise[i]);
   }
-  for ( ; i < n; i++, x += 1.f) {
-    R = (A + x * B) / D;
-    if (R - offset < noise[i]) noise[i] = R - offset;
+
+  for (i = i1; i < n; i++) {
+    x = i;
+    R = (A + x * B) / D - offset;
+    noise[i] = (R < noise[i] ? R : noise[i]);
   }
 }
 
@@ -763,9 +787,11 @@ void _vp_tonemask(vorbis_look_psy *p,
   for(i=0;i<n;i++)
     logmask[i]=p->ath[i]+att;
 
-  /* tone masking */
-  seed_loop(p,(const float ***)p->tonecurves,logfft,logmask,seed,global_specmax);
-  max_seeds(p,seed,logmask);
+  /* tone masking; speed 2 and up make do with the ATH alone */
+  if(p->speed<2){
+    seed_loop(p,(const float ***)p->tonecurves,logfft,logmask,seed,global_specmax);
+    max_seeds(p,seed,logmask);
+  }
 
 }
 
@@ -907,11 +933,23 @@ static float FLOOR1_fromdB_LOOKUP[256]={
   0.82788260F, 0.88168307F, 0.9389798F, 1.F,
 };
 
-/* this is for per-channel noise normalization */
-static int apsort(const void *a, const void *b){
-  float f1=**(float**)a;
-  float f2=**(float**)b;
-  return (f1<f2)-(f1>f2);
+/* this is for per-channel noise normalization; moves the n largest
+   magnitudes to the front of sort[] in descending order.  Equal
+   magnitudes keep their order in sort[] (ascending position in q), as
+   a stable descending sort would leave them. */
+static void apselect(float **sort, int count, int n){
+  int i,j;
+  for(i=0;i<n;i++){
+    int best=i;
+    for(j=i+1;j<count;j++)
+      if(*sort[j]>*sort[best] || (*sort[j]==*sort[best] && sort[j]<sort[best]))
+        best=j;
+    if(best!=i){
+      float *temp=sort[i];
+      sort[i]=sort[best];
+      sort[best]=temp;
+    }
+  }
 }
 
 static void flag_lossless(int limit, float prepoint, float postpoint, float *mdct,
@@ -984,18 +1022,27 @@ static float noise_normalize(vorbis_look_psy *p, int limit, float *r, float *q,
   }
 
   if(count){
-    /* noise norm to do */
-    qsort(sort,count,sizeof(*sort),apsort);
-    for(j=0;j<count;j++){
+    /* noise norm to do.  Taken largest first, elements are promoted
+       to unit magnitude while acc stays above threshold and zeroed
+       after that, so the number promoted depends only on acc.  Count
+       the promotions, then select that many of the largest rather
+       than sorting the whole partition. */
+    int promote=0;
+    while(promote<count && acc>=vi->normal_thresh){
+      acc-=1.f;
+      promote++;
+    }
+    apselect(sort,count,promote);
+
+    for(j=0;j<promote;j++){
       int k=sort[j]-q;
-      if(acc>=vi->normal_thresh){
-        out[k]=unitnorm(r[k]);
-        acc-=1.f;
-        q[k]=f[k];
-      }else{
-        out[k]=0;
-        q[k]=0.f;
-      }
+      out[k]=unitnorm(r[k]);
+      q[k]=f[k];
+    }
+    for(;j<count;j++){
+      int k=sort[j]-q;
+      out[k]=0;
+      q[k]=0.f;
     }
   }
 
@@ -1172,11 +1219,9 @@ void _vp_couple_quantize_normalize(int blobno,
                 }
 #else
                 /* elliptical */
-                if(reM[j]+reA[j]<0){
-                  reM[j] = - (qeM[j] = fabs(reM[j])+fabs(reA[j]));
-                }else{
-                  reM[j] =   (qeM[j] = fabs(reM[j])+fabs(reA[j]));
-                }
+                float mag = fabs(reM[j])+fabs(reA[j]);
+                reM[j] = (reM[j]+reA[j]<0 ? -mag : mag);
+                qeM[j] = mag;
 #endif
 
               }
@@ -1204,3 +1249,300 @@ void _vp_couple_quantize_normalize(int blobno,
     }
   }
 }
+
+#ifdef _V_BENCH
+
+/* Timing harness for the psychoacoustic masking code; built as the
+   psybench extra program (make psybench).  Frames are cut from a few
+   synthetic signals and run through the same window, FFT and MDCT
+   setup as mapping0_forward(), then each stage is timed on its own.
+   The checksums cover the stage outputs so that runs before and
+   after a change can be compared for identity. */
+
+#include <stdio.h>
+#include <time.h>
+#include "vorbis/vorbisenc.h"
+#include "window.h"
+#include "mdct.h"
+
+#define BENCH_FRAMES 48
+#define BENCH_SIGNALS 5
+
+static float bench_signal(int sig,long i,long rate){
+  static unsigned long lcg=1;
+  double t=(double)i/rate;
+  lcg=lcg*1664525UL+1013904223UL;
+  switch(sig){
+  case 0: /* pure tone */
+    return .7f*sin(2.*M_PI*1000.*t);
+  case 1: /* chord */
+    return .2f*(sin(2.*M_PI*220.*t)+sin(2.*M_PI*277.2*t)+
+                sin(2.*M_PI*329.6*t)+sin(2.*M_PI*3520.*t));
+  case 2: /* white noise */
+    return ((lcg>>8)&0xffff)/32768.f-1.f;
+  case 3: /* sweep */
+    return .5f*sin(2.*M_PI*(50.*t+4000.*t*t));
+  default: /* tones over noise */
+    return .3f*sin(2.*M_PI*440.*t)+.2f*sin(2.*M_PI*6000.*t)+
+      .1f*(((lcg>>8)&0xffff)/32768.f-1.f);
+  }
+}
+
+static ogg_uint32_t bench_sum(ogg_uint32_t sum,const void *v,long n){
+  long i;
+  for(i=0;i<n;i++){
+    ogg_uint32_t x;
+    memcpy(&x,(const char *)v+i*sizeof(x),sizeof(x));
+    sum=(sum^x)*16777619UL;
+  }
+  return sum;
+}
+
+typedef struct {
+  const char *name;
+  double seconds;
+  long calls;
+} bench_stage;
+
+static void bench_blocksize(vorbis_info *vi,vorbis_dsp_state *vd,int W,
+                            int reps){
+  codec_setup_info *ci=vi->codec_setup;
+  private_state *b=vd->backend_state;
+  vorbis_look_psy *p=b->psy+(W?3:0);
+  vorbis_info_mapping0 *map=ci->map_param[ci->mode_param[W]->mapping];
+  long n=ci->blocksizes[W],n2=n/2,tol=p->total_octave_lines;
+  int frames=BENCH_FRAMES*BENCH_SIGNALS,ch=vi->channels;
+  float *pcm=_ogg_malloc(n*sizeof(*pcm));
+  float *mdct=_ogg_malloc(n2*sizeof(*mdct));
+  float *logfft=_ogg_malloc(frames*n2*sizeof(*logfft));
+  float *logmdct=_ogg_malloc(frames*n2*sizeof(*logmdct));
+  float *resid=_ogg_malloc(frames*n2*sizeof(*resid));
+  float *local=_ogg_malloc(frames*sizeof(*local));
+  float *seeds=_ogg_malloc(frames*tol*sizeof(*seeds));
+  float *masks=_ogg_malloc(frames*n2*sizeof(*masks));
+  float *work=_ogg_malloc(tol*sizeof(*work));
+  float *out=_ogg_malloc(n2*sizeof(*out));
+  float *cmdct=_ogg_malloc(frames*ch*n2*sizeof(*cmdct));
+  int *cfloor=_ogg_malloc(frames*ch*n2*sizeof(*cfloor));
+  int *iwork=_ogg_malloc(ch*n2*sizeof(*iwork));
+  float **mptr=_ogg_malloc(ch*sizeof(*mptr));
+  int **iptr=_ogg_malloc(ch*sizeof(*iptr));
+  int *nonzero=_ogg_malloc(ch*sizeof(*nonzero));
+  float global=-9999.f,scale=4.f/n,scale_dB=todB(&scale)+.345;
+  ogg_uint32_t sum_seed=0,sum_tone=0,sum_noise=0,sum_bark=0,sum_couple=0;
+  bench_stage stage[8]={
+    {"seed_loop",0,0},
+    {"seed_chase",0,0},
+    {"max_seeds",0,0},
+    {"_vp_tonemask",0,0},
+    {"_vp_noisemask",0,0},
+    {"bark_noise bark",0,0},
+    {"bark_noise fixed",0,0},
+    {"couple_quantize",0,0},
+  };
+  int f,r,i,j,c;
+  clock_t t;
+
+  /* analysis inputs, as mapping0_forward() builds them */
+  for(f=0;f<frames;f++){
+    int sig=f/BENCH_FRAMES;
+    long off=(f%BENCH_FRAMES)*n2;
+    float *lf=logfft+f*n2,*lm=logmdct+f*n2;
+
+    for(i=0;i<n;i++)pcm[i]=bench_signal(sig,off+i,vi->rate);
+    _vorbis_apply_window(pcm,b->window,ci->blocksizes,W,W,W);
+    mdct_forward(b->transform[W][0],pcm,mdct);
+    drft_forward(&b->fft_look[W],pcm);
+    lf[0]=scale_dB+todB(pcm)+.345;
+    local[f]=lf[0];
+    for(j=1;j<n-1;j+=2){
+      float temp=pcm[j]*pcm[j]+pcm[j+1]*pcm[j+1];
+      temp=lf[(j+1)>>1]=scale_dB+.5f*todB(&temp)+.345;
+      if(temp>local[f])local[f]=temp;
+    }
+    if(local[f]>0.f)local[f]=0.f;
+    if(local[f]>global)global=local[f];
+    for(j=0;j<n2;j++)lm[j]=todB(mdct+j)+.345;
+
+    /* the residual the second _vp_noisemask() pass fits */
+    bark_noise_hybridmp(n2,p->bark,lm,mdct,140.,-1);
+    for(j=0;j<n2;j++)resid[f*n2+j]=lm[j]-mdct[j];
+  }
+
+  /* per channel spectra, with the noise estimate standing in for the
+     floor1 curve, for _vp_couple_quantize_normalize() */
+  for(f=0;f<frames;f++){
+    long off=(f%BENCH_FRAMES)*n2;
+    for(c=0;c<ch;c++){
+      int sig=(f/BENCH_FRAMES+c)%BENCH_SIGNALS;
+      float *cm=cmdct+(f*ch+c)*n2;
+      int *cf=cfloor+(f*ch+c)*n2;
+
+      for(i=0;i<n;i++)pcm[i]=bench_signal(sig,off+i,vi->rate);
+      _vorbis_apply_window(pcm,b->window,ci->blocksizes,W,W,W);
+      mdct_forward(b->transform[W][0],pcm,cm);
+      for(j=0;j<n2;j++)out[j]=todB(cm+j)+.345;
+      bark_noise_hybridmp(n2,p->bark,out,mdct,140.,-1);
+      for(j=0;j<n2;j++){
+        int v=rint((mdct[j]+140.f)*(255.f/140.f));
+        cf[j]=(v<0?0:(v>255?255:v));
+      }
+    }
+  }
+
+  for(r=0;r<reps;r++){
+    /* seed_loop, including the reset _vp_tonemask does first */
+    t=clock();
+    for(f=0;f<frames;f++){
+      float *seed=seeds+f*tol,*mask=masks+f*n2;
+      float att=local[f]+p->vi->ath_adjatt;
+      if(att<p->vi->ath_maxatt)att=p->vi->ath_maxatt;
+      for(i=0;i<tol;i++)seed[i]=NEGINF;
+      for(i=0;i<n2;i++)mask[i]=p->ath[i]+att;
+      seed_loop(p,(const float ***)p->tonecurves,logfft+f*n2,mask,seed,global);
+    }
+    stage[0].seconds+=clock()-t;
+    stage[0].calls+=frames;
+
+    t=clock();
+    for(f=0;f<frames;f++){
+      memcpy(work,seeds+f*tol,tol*sizeof(*work));
+      seed_chase(work,p->eighth_octave_lines,tol);
+    }
+    stage[1].seconds+=clock()-t;
+    stage[1].calls+=frames;
+    if(r==0)
+      for(f=0;f<frames;f++){
+        memcpy(work,seeds+f*tol,tol*sizeof(*work));
+        seed_chase(work,p->eighth_octave_lines,tol);
+        sum_seed=bench_sum(sum_seed,work,tol);
+      }
+
+    /* max_seeds runs seed_chase itself */
+    t=clock();
+    for(f=0;f<frames;f++){
+      memcpy(work,seeds+f*tol,tol*sizeof(*work));
+      memcpy(out,masks+f*n2,n2*sizeof(*out));
+      max_seeds(p,work,out);
+    }
+    stage[2].seconds+=clock()-t;
+    stage[2].calls+=frames;
+
+    t=clock();
+    for(f=0;f<frames;f++){
+      _vp_tonemask(p,logfft+f*n2,out,global,local[f]);
+      if(r==0)sum_tone=bench_sum(sum_tone,out,n2);
+    }
+    stage[3].seconds+=clock()-t;
+    stage[3].calls+=frames;
+
+    t=clock();
+    for(f=0;f<frames;f++){
+      _vp_noisemask(p,logmdct+f*n2,out);
+      if(r==0)sum_noise=bench_sum(sum_noise,out,n2);
+    }
+    stage[4].seconds+=clock()-t;
+    stage[4].calls+=frames;
+
+    /* the two bark_noise_hybridmp() passes _vp_noisemask() makes */
+    t=clock();
+    for(f=0;f<frames;f++)
+      bark_noise_hybridmp(n2,p->bark,logmdct+f*n2,out,140.,-1);
+    stage[5].seconds+=clock()-t;
+    stage[5].calls+=frames;
+
+    t=clock();
+    for(f=0;f<frames;f++){
+      bark_noise_hybridmp(n2,p->bark,resid+f*n2,out,0.,
+                          p->vi->noisewindowfixed);
+      if(r==0)sum_bark=bench_sum(sum_bark,out,n2);
+    }
+    stage[6].seconds+=clock()-t;
+    stage[6].calls+=frames;
+
+    /* one packetblob's worth, as mapping0_forward() runs it */
+    t=clock();
+    for(f=0;f<frames;f++){
+      for(c=0;c<ch;c++){
+        mptr[c]=cmdct+(f*ch+c)*n2;
+        iptr[c]=iwork+c*n2;
+        memcpy(iptr[c],cfloor+(f*ch+c)*n2,n2*sizeof(*iwork));
+        nonzero[c]=1;
+      }
+      _vp_couple_quantize_normalize(PACKETBLOBS/2,&ci->psy_g_param,p,map,
+                                    mptr,iptr,nonzero,
+                                    ci->psy_g_param.sliding_lowpass[W][PACKETBLOBS/2],
+                                    ch);
+      if(r==0)sum_couple=bench_sum(sum_couple,iwork,ch*n2);
+    }
+    stage[7].seconds+=clock()-t;
+    stage[7].calls+=frames;
+  }
+
+  for(i=0;i<8;i++)
+    printf("%6ld  %-16s %10.2f\n",n,stage[i].name,
+           stage[i].seconds/CLOCKS_PER_SEC/stage[i].calls*1e6);
+  printf("%6ld  checksums seed %08lx tone %08lx noise %08lx bark %08lx "
+         "couple %08lx\n",n,(unsigned long)sum_seed,(unsigned long)sum_tone,
+         (unsigned long)sum_noise,(unsigned long)sum_bark,
+         (unsigned long)sum_couple);
+
+  _ogg_free(pcm);
+  _ogg_free(mdct);
+  _ogg_free(logfft);
+  _ogg_free(logmdct);
+  _ogg_free(resid);
+  _ogg_free(local);
+  _ogg_free(seeds);
+  _ogg_free(masks);
+  _ogg_free(work);
+  _ogg_free(out);
+  _ogg_free(cmdct);
+  _ogg_free(cfloor);
+  _ogg_free(iwork);
+  _ogg_free(mptr);
+  _ogg_free(iptr);
+  _ogg_free(nonzero);
+}
+
+int main(int argc,char **argv){
+  static const struct {
+    int channels;
+    long rate;
+    float quality;
+  } setup[]={
+    {2,44100,.1f},
+    {2,44100,.5f},
+    {2,48000,.9f},
+    {1,22050,.3f},
+    {6,48000,.5f},
+  };
+  int reps=argc>1?atoi(argv[1]):20;
+  int i;
+
+  if(reps<1)reps=1;
+  printf("  size  function         usec/call\n");
+  for(i=0;i<(int)(sizeof(setup)/sizeof(*setup));i++){
+    vorbis_info vi;
+    vorbis_dsp_state vd;
+
+    vorbis_info_init(&vi);
+    if(vorbis_encode_init_vbr(&vi,setup[i].channels,setup[i].rate,
+                              setup[i].quality)){
+      fprintf(stderr,"encoder setup failed\n");
+      return 1;
+    }
+    vorbis_analysis_init(&vd,&vi);
+
+    printf("%d channel %ldHz q%.1f\n",setup[i].channels,setup[i].rate,
+           setup[i].quality*10);
+    bench_blocksize(&vi,&vd,0,reps);
+    bench_blocksize(&vi,&vd,1,reps);
+
+    vorbis_dsp_clear(&vd);
+    vorbis_info_clear(&vi);
+  }
+  return 0;
+}
+
+#endif
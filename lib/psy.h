@@ -81,6 +81,13 @@ typedef struct{
   int   coupling_postpointamp[PACKETBLOBS];
   int   sliding_lowpass[2][PACKETBLOBS];
 
+  /* analysis shortcuts (OV_ECTL_SPEED_SET); 0 is full analysis */
+  int   speed;
+
+  /* short blocks only, with a fixed lookahead
+     (OV_ECTL_LOWLATENCY_SET) */
+  int   lowlatency;
+
 } vorbis_info_psy_global;
 
 typedef struct {
@@ -110,6 +117,7 @@ typedef struct {
   long  rate; /* cache it */
 
   float m_val; /* Masking compensation value */
+  int   speed; /* from vorbis_info_psy_global */
 
 } vorbis_look_psy;
 
@@ -54,6 +54,8 @@ typedef struct {
   long      phrasebits;
   long      frames;
 
+  int       booksready; /* every decode book built; see _res0_books() */
+
 #if defined(TRAIN_RES) || defined(TRAIN_RESAUX)
   int        train_seq;
   long      *training_data[8][64];
@@ -162,6 +164,7 @@ static int icount(unsigned int v){
 }
 
 
+#ifndef VORBIS_DECODE_ONLY
 void res0_pack(vorbis_info_residue *vr,oggpack_buffer *opb){
   vorbis_info_residue0 *info=(vorbis_info_residue0 *)vr;
   int j,acc=0;
@@ -190,6 +193,7 @@ void res0_pack(vorbis_info_residue *vr,oggpack_buffer *opb){
     oggpack_write(opb,info->booklist[j],8);
 
 }
+#endif
 
 /* vorbis_info is for range checking */
 vorbis_info_residue *res0_unpack(vorbis_info *vi,oggpack_buffer *opb){
@@ -316,6 +320,7 @@ vorbis_look_residue *res0_look(vorbis_dsp_state *vd,
   return(look);
 }
 
+#ifndef VORBIS_DECODE_ONLY
 /* break an abstraction and copy some code for performance purposes */
 static int local_book_besterror(codebook *book,int *a){
   int dim=book->dim;
@@ -642,6 +647,22 @@ static int _01forward(oggpack_buffer *opb,
 
   return(0);
 }
+#endif
+
+/* A decode book is built on first use (vorbis_book_ready()).  Once
+   every book of the residue is built, this decoder stops asking, so
+   the partition loops test only a local flag, and only until then. */
+static void _res0_books(vorbis_look_residue0 *look){
+  int j,k;
+  if(!vorbis_book_ready_p(look->phrasebook))return;
+  for(j=0;j<look->parts;j++){
+    int stages=ov_ilog(look->info->secondstages[j]);
+    for(k=0;k<stages;k++)
+      if(look->partbooks[j][k] && !vorbis_book_ready_p(look->partbooks[j][k]))
+        return;
+  }
+  look->booksready=1;
+}
 
 /* a truncated packet here just means 'stop working'; it's not an error */
 static int _01inverse(vorbis_block *vb,vorbis_look_residue *vl,
@@ -659,12 +680,15 @@ static int _01inverse(vorbis_block *vb,vorbis_look_residue *vl,
   int max=vb->pcmend>>1;
   int end=(info->end<max?info->end:max);
   int n=end-info->begin;
+  int ready=look->booksready;
 
   if(n>0){
     int partvals=n/samples_per_partition;
     int partwords=(partvals+partitions_per_word-1)/partitions_per_word;
     int ***partword=alloca(ch*sizeof(*partword));
 
+    if(!ready && vorbis_book_ready(look->phrasebook))return(0);
+
     for(j=0;j<ch;j++)
       partword[j]=_vorbis_block_alloc(vb,partwords*sizeof(*partword[j]));
 
@@ -691,6 +715,7 @@ static int _01inverse(vorbis_block *vb,vorbis_look_residue *vl,
             if(info->secondstages[partword[j][l][k]]&(1<<s)){
               codebook *stagebook=look->partbooks[partword[j][l][k]][s];
               if(stagebook){
+                if(!ready && vorbis_book_ready(stagebook))goto errout;
                 if(decodepart(stagebook,in[j]+offset,&vb->opb,
                               samples_per_partition)==-1)goto eopbreak;
               }
@@ -701,6 +726,7 @@ static int _01inverse(vorbis_block *vb,vorbis_look_residue *vl,
   }
  errout:
  eopbreak:
+  if(!ready)_res0_books(look);
   return(0);
 }
 
@@ -716,6 +742,7 @@ int res0_inverse(vorbis_block *vb,vorbis_look_residue *vl,
     return(0);
 }
 
+#ifndef VORBIS_DECODE_ONLY
 int res1_forward(oggpack_buffer *opb,vorbis_block *vb,vorbis_look_residue *vl,
                  int **in,int *nonzero,int ch, long **partword, int submap){
   int i,used=0;
@@ -747,6 +774,7 @@ long **res1_class(vorbis_block *vb,vorbis_look_residue *vl,
   else
     return(0);
 }
+#endif
 
 int res1_inverse(vorbis_block *vb,vorbis_look_residue *vl,
                  float **in,int *nonzero,int ch){
@@ -760,6 +788,7 @@ int res1_inverse(vorbis_block *vb,vorbis_look_residue *vl,
     return(0);
 }
 
+#ifndef VORBIS_DECODE_ONLY
 long **res2_class(vorbis_block *vb,vorbis_look_residue *vl,
                   int **in,int *nonzero,int ch){
   int i,used=0;
@@ -801,6 +830,7 @@ int res2_forward(oggpack_buffer *opb,
     return(0);
   }
 }
+#endif
 
 /* duplicate code here as speed is somewhat more important */
 int res2_inverse(vorbis_block *vb,vorbis_look_residue *vl,
@@ -815,6 +845,7 @@ int res2_inverse(vorbis_block *vb,vorbis_look_residue *vl,
   int max=(vb->pcmend*ch)>>1;
   int end=(info->end<max?info->end:max);
   int n=end-info->begin;
+  int ready=look->booksready;
 
   if(n>0){
     int partvals=n/samples_per_partition;
@@ -823,6 +854,7 @@ int res2_inverse(vorbis_block *vb,vorbis_look_residue *vl,
 
     for(i=0;i<ch;i++)if(nonzero[i])break;
     if(i==ch)return(0); /* no nonzero vectors */
+    if(!ready && vorbis_book_ready(look->phrasebook))return(0);
 
     for(s=0;s<look->stages;s++){
       for(i=0,l=0;i<partvals;l++){
@@ -841,6 +873,7 @@ int res2_inverse(vorbis_block *vb,vorbis_look_residue *vl,
             codebook *stagebook=look->partbooks[partword[l][k]][s];
 
             if(stagebook){
+              if(!ready && vorbis_book_ready(stagebook))goto errout;
               if(vorbis_book_decodevv_add(stagebook,in,
                                           i*samples_per_partition+info->begin,ch,
                                           &vb->opb,samples_per_partition)==-1)
@@ -852,6 +885,7 @@ int res2_inverse(vorbis_block *vb,vorbis_look_residue *vl,
   }
  errout:
  eopbreak:
+  if(!ready)_res0_books(look);
   return(0);
 }
 
@@ -867,6 +901,7 @@ const vorbis_func_residue residue0_exportbundle={
   &res0_inverse
 };
 
+#ifndef VORBIS_DECODE_ONLY
 const vorbis_func_residue residue1_exportbundle={
   &res0_pack,
   &res0_unpack,
@@ -888,3 +923,26 @@ const vorbis_func_residue residue2_exportbundle={
   &res2_forward,
   &res2_inverse
 };
+#else
+const vorbis_func_residue residue1_exportbundle={
+  NULL,
+  &res0_unpack,
+  &res0_look,
+  &res0_free_info,
+  &res0_free_look,
+  NULL,
+  NULL,
+  &res1_inverse
+};
+
+const vorbis_func_residue residue2_exportbundle={
+  NULL,
+  &res0_unpack,
+  &res0_look,
+  &res0_free_info,
+  &res0_free_look,
+  NULL,
+  NULL,
+  &res2_inverse
+};
+#endif
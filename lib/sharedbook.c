@@ -266,17 +266,21 @@ void vorbis_staticbook_destroy(static_codebook *b){
 
 void vorbis_book_clear(codebook *b){
   /* static book is not cleared; we're likely called on the lookup and
-     the static codebook belongs to the info struct */
-  if(b->valuelist)_ogg_free(b->valuelist);
-  if(b->codelist)_ogg_free(b->codelist);
-
-  if(b->dec_index)_ogg_free(b->dec_index);
-  if(b->dec_codelengths)_ogg_free(b->dec_codelengths);
-  if(b->dec_firsttable)_ogg_free(b->dec_firsttable);
+     the static codebook belongs to the info struct, unless a lazy
+     decode book took it over and hasn't yet freed it */
+  if(b->dec_source)vorbis_staticbook_destroy(b->dec_source);
+  if(b->dec_store){
+    /* decode book; every list lives in the one block */
+    _ogg_free(b->dec_store);
+  }else{
+    if(b->valuelist)_ogg_free(b->valuelist);
+    if(b->codelist)_ogg_free(b->codelist);
+  }
 
   memset(b,0,sizeof(*b));
 }
 
+#ifndef VORBIS_DECODE_ONLY
 int vorbis_book_init_encode(codebook *c,const static_codebook *s){
 
   memset(c,0,sizeof(*c));
@@ -292,6 +296,7 @@ int vorbis_book_init_encode(codebook *c,const static_codebook *s){
 
   return(0);
 }
+#endif
 
 static ogg_uint32_t bitreverse(ogg_uint32_t x){
   x=    ((x>>16)&0x0000ffffUL) | ((x<<16)&0xffff0000UL);
@@ -306,21 +311,45 @@ static int sort32a(const void *a,const void *b){
     ( **(ogg_uint32_t **)a<**(ogg_uint32_t **)b);
 }
 
-/* decode codebook arrangement is more heavily optimized than encode */
-int vorbis_book_init_decode(codebook *c,const static_codebook *s){
-  int i,j,n=0,tabn;
-  int *sortindex;
+/* returns the narrowest element size (1, 2 or 4 bytes) able to hold
+   every unquantized value exactly; 4 means keep the floats */
+static int _book_valuebytes(const float *r,long count){
+  int bytes=1;
+  long i;
+  for(i=0;i<count;i++){
+    float v=r[i],w;
+    if(v<-32768.f || v>32767.f)return 4;
+    w=(float)(int)v;
+    if(memcmp(&w,&v,sizeof(v)))return 4; /* fractional, or -0 */
+    if(v<-128.f || v>127.f)bytes=2;
+  }
+  return bytes;
+}
 
-  memset(c,0,sizeof(*c));
+/* round a byte offset up to keep each list in the block aligned */
+#define BOOK_ALIGN(x) (((x)+7)&~(size_t)7)
 
-  /* count actually used entries and find max length */
+/* count actually used entries */
+static long _book_used_entries(const static_codebook *s){
+  long i,n=0;
   for(i=0;i<s->entries;i++)
     if(s->lengthlist[i]>0)
       n++;
+  return(n);
+}
 
-  c->entries=s->entries;
-  c->used_entries=n;
-  c->dim=s->dim;
+/* builds the decode lists of a book whose entries, used_entries and
+   dim are already filled in; on failure nothing is left allocated */
+static int _book_build_decode(codebook *c,const static_codebook *s){
+  int i,j,n=c->used_entries,tabn;
+  int *sortindex;
+  float *values=NULL;
+
+  /* find max length */
+  c->dec_maxlength=0;
+  for(i=0;i<s->entries;i++)
+    if(s->lengthlist[i]>c->dec_maxlength)
+      c->dec_maxlength=s->lengthlist[i];
 
   if(n>0){
     /* two different remappings go on here.
@@ -336,6 +365,10 @@ int vorbis_book_init_decode(codebook *c,const static_codebook *s){
     /* perform sort */
     ogg_uint32_t *codes=_make_words(s->lengthlist,s->entries,c->used_entries);
     ogg_uint32_t **codep=alloca(sizeof(*codep)*n);
+    size_t off_code,off_values,off_index,off_lengths,size;
+    long valuen=0;
+    int valuebytes=4,indexbytes;
+    char *store;
 
     if(codes==NULL)goto err_out;
 
@@ -347,49 +380,93 @@ int vorbis_book_init_decode(codebook *c,const static_codebook *s){
     qsort(codep,n,sizeof(*codep),sort32a);
 
     sortindex=alloca(n*sizeof(*sortindex));
-    c->codelist=_ogg_malloc(n*sizeof(*c->codelist));
     /* the index is a reverse index */
     for(i=0;i<n;i++){
       int position=codep[i]-codes;
       sortindex[position]=i;
     }
 
+    values=_book_unquantize(s,n,sortindex);
+    if(values){
+      valuen=n*c->dim;
+      valuebytes=_book_valuebytes(values,valuen);
+    }
+    indexbytes=(s->entries<=65536?2:4);
+
+    if(n==1 && c->dec_maxlength==1){
+      c->dec_firsttablen=1;
+      tabn=2;
+    }else{
+      c->dec_firsttablen=ov_ilog(c->used_entries)-4; /* this is magic */
+      if(c->dec_firsttablen<5)c->dec_firsttablen=5;
+      if(c->dec_firsttablen>8)c->dec_firsttablen=8;
+      tabn=1<<c->dec_firsttablen;
+    }
+
+    /* lay the lists out widest first so the block needs no more
+       alignment than malloc already provides */
+    off_code=BOOK_ALIGN(tabn*sizeof(*c->dec_firsttable));
+    off_values=BOOK_ALIGN(off_code+n*sizeof(*c->codelist));
+    off_index=BOOK_ALIGN(off_values+valuen*valuebytes);
+    off_lengths=BOOK_ALIGN(off_index+n*indexbytes);
+    size=off_lengths+n*sizeof(*c->dec_codelengths);
+
+    store=c->dec_store=_ogg_malloc(size);
+    if(store==NULL){
+      _ogg_free(codes);
+      goto err_out;
+    }
+    memset(store,0,off_code);
+    c->dec_firsttable=(ogg_uint32_t *)store;
+    c->codelist=(ogg_uint32_t *)(store+off_code);
+    c->dec_codelengths=(unsigned char *)(store+off_lengths);
+
     for(i=0;i<n;i++)
       c->codelist[sortindex[i]]=codes[i];
     _ogg_free(codes);
 
-    c->valuelist=_book_unquantize(s,n,sortindex);
-    c->dec_index=_ogg_malloc(n*sizeof(*c->dec_index));
+    if(values){
+      switch(valuebytes){
+      case 1:
+        c->dec_values8=(signed char *)(store+off_values);
+        for(i=0;i<valuen;i++)c->dec_values8[i]=(signed char)values[i];
+        break;
+      case 2:
+        c->dec_values16=(ogg_int16_t *)(store+off_values);
+        for(i=0;i<valuen;i++)c->dec_values16[i]=(ogg_int16_t)values[i];
+        break;
+      default:
+        c->valuelist=(float *)(store+off_values);
+        memcpy(c->valuelist,values,valuen*sizeof(*values));
+        break;
+      }
+      _ogg_free(values);
+      values=NULL;
+    }
 
-    for(n=0,i=0;i<s->entries;i++)
-      if(s->lengthlist[i]>0)
-        c->dec_index[sortindex[n++]]=i;
+    if(indexbytes==2){
+      c->dec_index16=(ogg_uint16_t *)(store+off_index);
+      for(n=0,i=0;i<s->entries;i++)
+        if(s->lengthlist[i]>0)
+          c->dec_index16[sortindex[n++]]=i;
+    }else{
+      c->dec_index=(int *)(store+off_index);
+      for(n=0,i=0;i<s->entries;i++)
+        if(s->lengthlist[i]>0)
+          c->dec_index[sortindex[n++]]=i;
+    }
 
-    c->dec_codelengths=_ogg_malloc(n*sizeof(*c->dec_codelengths));
-    c->dec_maxlength=0;
     for(n=0,i=0;i<s->entries;i++)
-      if(s->lengthlist[i]>0){
+      if(s->lengthlist[i]>0)
         c->dec_codelengths[sortindex[n++]]=s->lengthlist[i];
-        if(s->lengthlist[i]>c->dec_maxlength)
-          c->dec_maxlength=s->lengthlist[i];
-      }
 
     if(n==1 && c->dec_maxlength==1){
       /* special case the 'single entry codebook' with a single bit
        fastpath table (that always returns entry 0 )in order to use
        unmodified decode paths. */
-      c->dec_firsttablen=1;
-      c->dec_firsttable=_ogg_calloc(2,sizeof(*c->dec_firsttable));
       c->dec_firsttable[0]=c->dec_firsttable[1]=1;
 
     }else{
-      c->dec_firsttablen=ov_ilog(c->used_entries)-4; /* this is magic */
-      if(c->dec_firsttablen<5)c->dec_firsttablen=5;
-      if(c->dec_firsttablen>8)c->dec_firsttablen=8;
-
-      tabn=1<<c->dec_firsttablen;
-      c->dec_firsttable=_ogg_calloc(tabn,sizeof(*c->dec_firsttable));
-
       for(i=0;i<n;i++){
         if(c->dec_codelengths[i]<=c->dec_firsttablen){
           ogg_uint32_t orig=bitreverse(c->codelist[i]);
@@ -430,10 +507,177 @@ int vorbis_book_init_decode(codebook *c,const static_codebook *s){
 
   return(0);
  err_out:
-  vorbis_book_clear(c);
+  if(values)_ogg_free(values);
   return(-1);
 }
 
+/* Decode books may also be set up lazily: vorbis_book_init_lazy()
+   checks the codeword lengths and fills in only the sizes, and the
+   floor and residue backends build the decode lists on first use
+   through vorbis_book_ready(), so books a stream never references are
+   never expanded.  Several decoders can share one vorbis_info, so a
+   book is built privately and then published with an atomic state
+   word; a decoder losing the race drops its copy.  The lazy book owns
+   its static book, and the last decoder to finish building from it
+   frees it once the book is published.  Without atomics the book is
+   built, and the static book freed, up front. */
+
+#define BOOK_PENDING    0
+#define BOOK_PUBLISHING 1
+#define BOOK_READY      2
+
+#ifdef VORBIS_ATOMICS
+/* the test _make_words() applies, without building the words: the
+   lengths must fill the codeword tree exactly (the Kraft sum is one),
+   bar the single-entry book of one length 1 codeword */
+static int _book_lengths_check(const static_codebook *s,long used){
+  double sum=0.;
+  long i;
+  if(used==0)return(0);
+  for(i=0;i<s->entries;i++)
+    if(s->lengthlist[i]>0){
+      if(s->lengthlist[i]>32)return(-1);
+      sum+=ldexp(1.,-s->lengthlist[i]);
+      if(sum>1.)return(-1);
+    }
+  if(sum<1. && !(used==1 && sum==.5))return(-1);
+  return(0);
+}
+#endif
+
+/* decode codebook arrangement is more heavily optimized than encode */
+int vorbis_book_init_decode(codebook *c,const static_codebook *s){
+  memset(c,0,sizeof(*c));
+  c->entries=s->entries;
+  c->used_entries=_book_used_entries(s);
+  c->dim=s->dim;
+
+  if(_book_build_decode(c,s)){
+    vorbis_book_clear(c);
+    return(-1);
+  }
+  c->dec_state=BOOK_READY;
+  return(0);
+}
+
+/* takes over the static book on success; on failure it stays with
+   the caller */
+int vorbis_book_init_lazy(codebook *c,static_codebook *s){
+  memset(c,0,sizeof(*c));
+  c->entries=s->entries;
+  c->used_entries=_book_used_entries(s);
+  c->dim=s->dim;
+  c->dec_source=s;
+  c->dec_state=BOOK_PENDING;
+
+#ifdef VORBIS_ATOMICS
+  /* an over- or underpopulated tree is a bad setup header; reject it
+     here as eager setup does, so only the table build waits */
+  if(_book_lengths_check(s,c->used_entries)){
+    c->dec_source=NULL;
+    return(-1);
+  }
+  return(0);
+#else
+  if(vorbis_book_ready(c)){
+    c->dec_source=NULL;
+    return(-1);
+  }
+  return(0);
+#endif
+}
+
+#ifdef VORBIS_ATOMICS
+static long _book_builders_add(codebook *c,long n){
+  long v;
+  do v=vorbis_atomic_load(&c->dec_builders);
+  while(!vorbis_atomic_cas(&c->dec_builders,v,v+n));
+  return(v+n);
+}
+
+/* a decoder done building from the static book; the last one out
+   frees it once the book is published.  Only decoders that saw the
+   book pending get here, and after the first one publishes no more
+   can, so the count reaches zero with the book ready only once. */
+static void _book_build_done(codebook *c){
+  if(_book_builders_add(c,-1)==0 &&
+     vorbis_atomic_load(&c->dec_state)==BOOK_READY){
+    vorbis_staticbook_destroy(c->dec_source);
+    c->dec_source=NULL;
+  }
+}
+#endif
+
+/* returns 0 once the book's decode lists exist, -1 if they can't be
+   built (out of memory; the lengths were checked at init) */
+int vorbis_book_ready(codebook *c){
+#ifdef VORBIS_ATOMICS
+  codebook b;
+  long state=vorbis_atomic_load(&c->dec_state);
+  if(state==BOOK_READY)return(0);
+
+  if(state==BOOK_PENDING){
+    /* count ourselves in before touching the static book, and only
+       build if it is still needed */
+    _book_builders_add(c,1);
+    if(vorbis_atomic_load(&c->dec_state)!=BOOK_PENDING){
+      _book_builders_add(c,-1);
+      goto wait;
+    }
+
+    memset(&b,0,sizeof(b));
+    b.entries=c->entries;
+    b.used_entries=c->used_entries;
+    b.dim=c->dim;
+    if(_book_build_decode(&b,c->dec_source)){
+      _book_build_done(c);
+      return(-1);
+    }
+
+    if(vorbis_atomic_cas(&c->dec_state,BOOK_PENDING,BOOK_PUBLISHING)){
+      c->valuelist=b.valuelist;
+      c->codelist=b.codelist;
+      c->dec_store=b.dec_store;
+      c->dec_values8=b.dec_values8;
+      c->dec_values16=b.dec_values16;
+      c->dec_index=b.dec_index;
+      c->dec_index16=b.dec_index16;
+      c->dec_codelengths=b.dec_codelengths;
+      c->dec_firsttable=b.dec_firsttable;
+      c->dec_firsttablen=b.dec_firsttablen;
+      c->dec_maxlength=b.dec_maxlength;
+      vorbis_atomic_store(&c->dec_state,BOOK_READY);
+      _book_build_done(c);
+      return(0);
+    }
+    vorbis_book_clear(&b);
+    _book_build_done(c);
+  }
+
+ wait:
+  /* another decoder won the race and is copying its pointers in;
+     there is no build left to wait for, only those few stores */
+  while(vorbis_atomic_load(&c->dec_state)!=BOOK_READY);
+  return(0);
+#else
+  if(c->dec_state==BOOK_READY)return(0);
+  if(_book_build_decode(c,c->dec_source))return(-1);
+  c->dec_state=BOOK_READY;
+  vorbis_staticbook_destroy(c->dec_source);
+  c->dec_source=NULL;
+  return(0);
+#endif
+}
+
+/* nonzero if the book's decode lists exist; builds nothing */
+int vorbis_book_ready_p(codebook *c){
+#ifdef VORBIS_ATOMICS
+  return(vorbis_atomic_load(&c->dec_state)==BOOK_READY);
+#else
+  return(c->dec_state==BOOK_READY);
+#endif
+}
+
 long vorbis_book_codeword(codebook *book,int entry){
   if(book->c) /* only use with encode; decode optimizations are
                  allowed to break this */
@@ -16,6 +16,7 @@
  ********************************************************************/
 
 #include <stdio.h>
+#include <string.h>
 #include <ogg/ogg.h>
 #include "vorbis/codec.h"
 #include "codec_internal.h"
@@ -23,17 +24,14 @@
 #include "misc.h"
 #include "os.h"
 
-int vorbis_synthesis(vorbis_block *vb,ogg_packet *op){
-  vorbis_dsp_state     *vd= vb ? vb->vd : 0;
-  private_state        *b= vd ? vd->backend_state : 0;
-  vorbis_info          *vi= vd ? vd->vi : 0;
-  codec_setup_info     *ci= vi ? vi->codec_setup : 0;
-  oggpack_buffer       *opb=vb ? &vb->opb : 0;
-  int                   type,mode,i;
-
-  if (!vd || !b || !vi || !ci || !opb) {
-    return OV_EBADPACKET;
-  }
+/* unpack the audio packet header into vb; shared by full and
+   track-only decode as well as batch decode */
+static int _synthesis_blockhead(vorbis_block *vb,ogg_packet *op){
+  vorbis_dsp_state     *vd=vb->vd;
+  private_state        *b=vd->backend_state;
+  codec_setup_info     *ci=vd->vi->codec_setup;
+  oggpack_buffer       *opb=&vb->opb;
+  int                   mode;
 
   /* first things first.  Make sure decode is ready */
   _vorbis_block_ripcord(vb);
@@ -76,62 +74,65 @@ int vorbis_synthesis(vorbis_block *vb,ogg_packet *op){
   vb->sequence=op->packetno;
   vb->eofflag=op->e_o_s;
 
+  return(0);
+}
+
+/* mapping decode resolved for one mode */
+typedef struct {
+  int (*inverse)(struct vorbis_block *,vorbis_info_mapping *);
+  vorbis_info_mapping *param;
+} synthesis_map;
+
+static void _synthesis_map(codec_setup_info *ci,int mode,synthesis_map *m){
+  /* unpack_header enforces range checking */
+  int map=ci->mode_param[mode]->mapping;
+  m->inverse=_mapping_P[ci->map_type[map]]->inverse;
+  m->param=ci->map_param[map];
+}
+
+/* decode the packet body once the header has been unpacked and the
+   caller has validated the state pointers.  maps, if not NULL, holds
+   the mapping already resolved for each mode */
+static int _synthesis_decode(vorbis_block *vb,ogg_packet *op,
+                             synthesis_map *maps){
+  vorbis_info          *vi=vb->vd->vi;
+  codec_setup_info     *ci=vi->codec_setup;
+  synthesis_map         m;
+  int                   ret,i;
+
+  ret=_synthesis_blockhead(vb,op);
+  if(ret)return(ret);
+
   /* alloc pcm passback storage */
   vb->pcmend=ci->blocksizes[vb->W];
   vb->pcm=_vorbis_block_alloc(vb,sizeof(*vb->pcm)*vi->channels);
   for(i=0;i<vi->channels;i++)
     vb->pcm[i]=_vorbis_block_alloc(vb,vb->pcmend*sizeof(*vb->pcm[i]));
 
-  /* unpack_header enforces range checking */
-  type=ci->map_type[ci->mode_param[mode]->mapping];
-
-  return(_mapping_P[type]->inverse(vb,ci->map_param[ci->mode_param[mode]->
-                                                   mapping]));
+  if(maps)
+    return(maps[vb->mode].inverse(vb,maps[vb->mode].param));
+  _synthesis_map(ci,vb->mode,&m);
+  return(m.inverse(vb,m.param));
 }
 
-/* used to track pcm position without actually performing decode.
-   Useful for sequential 'fast forward' */
-int vorbis_synthesis_trackonly(vorbis_block *vb,ogg_packet *op){
-  vorbis_dsp_state     *vd=vb->vd;
-  private_state        *b=vd->backend_state;
-  vorbis_info          *vi=vd->vi;
-  codec_setup_info     *ci=vi->codec_setup;
-  oggpack_buffer       *opb=&vb->opb;
-  int                   mode;
-
-  /* first things first.  Make sure decode is ready */
-  _vorbis_block_ripcord(vb);
-  oggpack_readinit(opb,op->packet,op->bytes);
+int vorbis_synthesis(vorbis_block *vb,ogg_packet *op){
+  vorbis_dsp_state     *vd= vb ? vb->vd : 0;
+  private_state        *b= vd ? vd->backend_state : 0;
+  vorbis_info          *vi= vd ? vd->vi : 0;
+  codec_setup_info     *ci= vi ? vi->codec_setup : 0;
 
-  /* Check the packet type */
-  if(oggpack_read(opb,1)!=0){
-    /* Oops.  This is not an audio data packet */
-    return(OV_ENOTAUDIO);
+  if (!vd || !b || !vi || !ci) {
+    return OV_EBADPACKET;
   }
 
-  /* read our mode and pre/post windowsize */
-  mode=oggpack_read(opb,b->modebits);
-  if(mode==-1)return(OV_EBADPACKET);
-
-  vb->mode=mode;
-  if(!ci->mode_param[mode]){
-    return(OV_EBADPACKET);
-  }
-  
-  vb->W=ci->mode_param[mode]->blockflag;
-  if(vb->W){
-    vb->lW=oggpack_read(opb,1);
-    vb->nW=oggpack_read(opb,1);
-    if(vb->nW==-1)   return(OV_EBADPACKET);
-  }else{
-    vb->lW=0;
-    vb->nW=0;
-  }
+  return(_synthesis_decode(vb,op,NULL));
+}
 
-  /* more setup */
-  vb->granulepos=op->granulepos;
-  vb->sequence=op->packetno;
-  vb->eofflag=op->e_o_s;
+/* used to track pcm position without actually performing decode.
+   Useful for sequential 'fast forward' */
+int vorbis_synthesis_trackonly(vorbis_block *vb,ogg_packet *op){
+  int ret=_synthesis_blockhead(vb,op);
+  if(ret)return(ret);
 
   /* no pcm */
   vb->pcmend=0;
@@ -140,6 +141,68 @@ int vorbis_synthesis_trackonly(vorbis_block *vb,ogg_packet *op){
   return(0);
 }
 
+/* decode a run of audio packets from one logical stream in one call.
+   The state checks and the mode to mapping lookups are done once for
+   the whole run and each block is lapped and copied straight out to
+   the caller's per-channel vectors, so the caller does not have to
+   cycle through synthesis/blockin/pcmout/read for every packet.  The
+   floor, residue and MDCT work per packet is unchanged; what is saved
+   is the per-call overhead around it.  Decode stops early once the
+   next block might not fit in the remaining output space.  Packets
+   that fail to decode are consumed and dropped, as vorbisfile does.
+   Returns the number of samples written per channel; the number of
+   packets consumed is returned in *consumed.  Output space too small
+   for even one block is OV_EINVAL, as the call could never make
+   progress. */
+int vorbis_synthesis_batch(vorbis_dsp_state *v,vorbis_block *vb,
+                           ogg_packet *op,int packets,
+                           float **pcm,int samples,int *consumed){
+  vorbis_info          *vi= v ? v->vi : 0;
+  codec_setup_info     *ci= vi ? vi->codec_setup : 0;
+  synthesis_map         maps[64];
+  int                   channels,maxblock,i,j;
+  int                   done=0;
+
+  if(consumed)*consumed=0;
+  if(!vb || vb->vd!=v || !v->backend_state || !ci || !pcm ||
+     packets<0 || samples<0 || ci->modes>64)
+    return(OV_EINVAL);
+
+  channels=vi->channels;
+  /* no block can return more than half a long window */
+  maxblock=ci->blocksizes[1]>>(ci->halfrate_flag+1);
+  if(packets>0 && samples<maxblock && !vorbis_synthesis_pcmout(v,NULL))
+    return(OV_EINVAL);
+
+  for(i=0;i<ci->modes;i++)
+    _synthesis_map(ci,i,maps+i);
+
+  for(i=0;;){
+    float **out;
+    int n;
+
+    /* hand back anything the dsp state is already holding */
+    while((n=vorbis_synthesis_pcmout(v,&out))>0){
+      if(n>samples-done)n=samples-done;
+      if(n<=0)break;
+      for(j=0;j<channels;j++)
+        memcpy(pcm[j]+done,out[j],n*sizeof(**pcm));
+      vorbis_synthesis_read(v,n);
+      done+=n;
+    }
+
+    if(i>=packets || samples-done<maxblock ||
+       vorbis_synthesis_pcmout(v,NULL))break;
+
+    if(_synthesis_decode(vb,op+i,maps)==0)
+      vorbis_synthesis_blockin(v,vb);
+    i++;
+    if(consumed)*consumed=i;
+  }
+
+  return(done);
+}
+
 long vorbis_packet_blocksize(vorbis_info *vi,ogg_packet *op){
   codec_setup_info     *ci=vi->codec_setup;
   oggpack_buffer       opb;
@@ -249,6 +249,8 @@ static void vorbis_encode_global_psych_setup(vorbis_info *vi,double s,
     g->postecho_thresh[i]=in[is].postecho_thresh[i]*(1.-ds)+in[is+1].postecho_thresh[i]*ds;
   }
   g->ampmax_att_per_sec=ci->hi.amplitude_track_dBpersec;
+  g->speed=ci->hi.speed;
+  g->lowlatency=ci->hi.lowlatency;
   return;
 }
 
@@ -265,7 +267,7 @@ static void vorbis_encode_global_stereo(vorbis_info *vi,
     memcpy(g->coupling_prepointamp,p[is].pre,sizeof(*p[is].pre)*PACKETBLOBS);
     memcpy(g->coupling_postpointamp,p[is].post,sizeof(*p[is].post)*PACKETBLOBS);
 
-    if(hi->managed){
+    if(hi->managed || hi->twopass){
       /* interpolate the kHz threshholds */
       for(i=0;i<PACKETBLOBS;i++){
         float kHz=p[is].kHz[i]*(1.-ds)+p[is+1].kHz[i]*ds;
@@ -473,7 +475,7 @@ static void vorbis_encode_residue_setup(vorbis_info *vi,
   {
     int booklist=0,k;
 
-    if(ci->hi.managed){
+    if(ci->hi.managed || ci->hi.twopass){
       for(i=0;i<r->partitions;i++)
         for(k=0;k<4;k++)
           if(res->books_base_managed->books[i][k])
@@ -532,7 +534,7 @@ static void vorbis_encode_residue_setup(vorbis_info *vi,
        not the lowpass. the floor is always lowpass limited. */
     switch(res->limit_type){
     case 1: /* point stereo limited */
-      if(ci->hi.managed)
+      if(ci->hi.managed || ci->hi.twopass)
         freq=ci->psy_g_param.coupling_pkHz[PACKETBLOBS-1]*1000.;
       else
         freq=ci->psy_g_param.coupling_pkHz[PACKETBLOBS/2]*1000.;
@@ -851,8 +853,11 @@ int vorbis_encode_setup_init(vorbis_info *vi){
       hi->bitrate_reservoir_bias;
 
     ci->bi.slew_damp=hi->bitrate_av_damp;
+    ci->bi.lookahead=hi->bitrate_lookahead;
 
   }
+  ci->bi.twopass=hi->twopass;
+  ci->bi.twopass_target=hi->twopass_target;
 
   return(0);
 
@@ -1156,6 +1161,20 @@ int vorbis_encode_ctl(vorbis_info *vi,int number,void *arg){
       }
       return 0;
 
+    case OV_ECTL_RATEMANAGE_LOOKAHEAD_GET:
+      {
+        int *iarg=(int *)arg;
+        *iarg=hi->bitrate_lookahead;
+      }
+      return(0);
+    case OV_ECTL_RATEMANAGE_LOOKAHEAD_SET:
+      {
+        int *iarg=(int *)arg;
+        if(*iarg<0 || *iarg>1024)return OV_EINVAL;
+        hi->bitrate_lookahead=*iarg;
+      }
+      return(0);
+
     case OV_ECTL_LOWPASS_GET:
       {
         double *farg=(double *)arg;
@@ -1217,6 +1236,72 @@ int vorbis_encode_ctl(vorbis_info *vi,int number,void *arg){
         vorbis_encode_setup_setting(vi,vi->channels,vi->rate);
       }
       return(0);
+    case OV_ECTL_SPEED_GET:
+      {
+        int *iarg=(int *)arg;
+        *iarg=hi->speed;
+      }
+      return(0);
+    case OV_ECTL_SPEED_SET:
+      {
+        int *iarg=(int *)arg;
+        hi->speed=*iarg;
+
+        if(hi->speed<0)hi->speed=0;
+        if(hi->speed>2)hi->speed=2;
+      }
+      return(0);
+    case OV_ECTL_LOWLATENCY_GET:
+      {
+        int *iarg=(int *)arg;
+        *iarg=hi->lowlatency;
+      }
+      return(0);
+    case OV_ECTL_LOWLATENCY_SET:
+      {
+        int *iarg=(int *)arg;
+        hi->lowlatency=((*iarg)!=0);
+      }
+      return(0);
+
+    case OV_ECTL_TWOPASS_GET:
+      {
+        struct ovectl_twopass_arg *ai=
+          (struct ovectl_twopass_arg *)arg;
+        if(!ai)return OV_EINVAL;
+
+        ai->pass=hi->twopass;
+        ai->target_bytes=hi->twopass_target;
+        ai->stats=ci->bi.twopass_stats;
+        ai->stats_bytes=ci->bi.twopass_stats_bytes;
+      }
+      return(0);
+    case OV_ECTL_TWOPASS_SET:
+      {
+        struct ovectl_twopass_arg *ai=
+          (struct ovectl_twopass_arg *)arg;
+        int pass=ai?ai->pass:0;
+
+        if(pass<0 || pass>2)return OV_EINVAL;
+        if(pass==2){
+          if(ai->target_bytes<=0)return OV_EINVAL;
+          if(vorbis_bitrate_twopass_check(vi,ai->stats,ai->stats_bytes))
+            return OV_EINVAL;
+        }
+
+        if(ci->bi.twopass_stats)_ogg_free(ci->bi.twopass_stats);
+        ci->bi.twopass_stats=NULL;
+        ci->bi.twopass_stats_bytes=0;
+        hi->twopass=pass;
+        hi->twopass_target=0;
+        if(pass==2){
+          ci->bi.twopass_stats=_ogg_malloc(ai->stats_bytes);
+          memcpy(ci->bi.twopass_stats,ai->stats,ai->stats_bytes);
+          ci->bi.twopass_stats_bytes=ai->stats_bytes;
+          hi->twopass_target=ai->target_bytes;
+        }
+      }
+      return(0);
     }
     return(OV_EIMPL);
   }
@@ -63,6 +63,9 @@
 */
 #define CHUNKSIZE 65536 /* greater-than-page-size granularity seeking */
 #define READSIZE 2048 /* a smaller read size is needed for low-rate streaming. */
+#define LINKSETUPS 8 /* default bound on unpacked link setups in a chain */
+#define SEEKSPAN 44100 /* read forward rather than bisect within this many samples */
+#define PAGECACHE 256 /* page positions remembered to narrow later seeks */
 
 static long _get_data(OggVorbis_File *vf){
   errno=0;
@@ -276,15 +279,152 @@ static ogg_int64_t _get_prev_page_serial(OggVorbis_File *vf, ogg_int64_t begin,
 
 }
 
+/* comments left in the file by a comment limit are tracked as
+   (link, comment, offset in the comment header, length) quads */
+static void _comment_skips_drop(OggVorbis_File *vf,int link){
+  long i,n=0;
+  for(i=0;i<vf->comment_skip_count;i++)
+    if(vf->comment_skips[i*4]!=link){
+      memmove(vf->comment_skips+n*4,vf->comment_skips+i*4,
+              4*sizeof(*vf->comment_skips));
+      n++;
+    }
+  vf->comment_skip_count=n;
+}
+
+static int _comment_skips_add(OggVorbis_File *vf,int link,long comment,
+                              long offset,long length){
+  ogg_int64_t *e=_ogg_realloc(vf->comment_skips,(vf->comment_skip_count+1)*
+                              4*sizeof(*vf->comment_skips));
+  if(!e)return(OV_EFAULT);
+  vf->comment_skips=e;
+  e+=vf->comment_skip_count*4;
+  e[0]=link;
+  e[1]=comment;
+  e[2]=offset;
+  e[3]=length;
+  vf->comment_skip_count++;
+  return(0);
+}
+
+static unsigned long _comment_read32(const unsigned char *p){
+  return(p[0]|(p[1]<<8)|((unsigned long)p[2]<<16)|((unsigned long)p[3]<<24));
+}
+
+/* unpacks a comment header as vorbis_synthesis_headerin() does, but
+   comments longer than the comment limit keep only their tag (up to
+   and including the '='); the rest is not copied out of the packet,
+   and where it lies is recorded for ov_comment_fetch().  The header
+   is byte aligned throughout, so it's read in place. */
+static int _unpack_comment_limit(OggVorbis_File *vf,vorbis_info *vi,
+                                 vorbis_comment *vc,ogg_packet *op,
+                                 int link){
+  const unsigned char *p=op->packet;
+  long bytes=op->bytes,pos=7,i;
+  unsigned long len;
+
+  /* the same ordering checks as vorbis_synthesis_headerin() */
+  if(vi->rate==0 || vc->vendor!=NULL)return(OV_EBADHEADER);
+  _comment_skips_drop(vf,link);
+
+  if(bytes-pos<4)goto err_out;
+  len=_comment_read32(p+pos);
+  pos+=4;
+  if(len>(unsigned long)(bytes-pos))goto err_out;
+  vc->vendor=_ogg_calloc(len+1,1);
+  memcpy(vc->vendor,p+pos,len);
+  pos+=len;
+
+  if(bytes-pos<4)goto err_out;
+  len=_comment_read32(p+pos);
+  pos+=4;
+  if(len>(unsigned long)((bytes-pos)>>2))goto err_out;
+  vc->comments=len;
+  vc->user_comments=_ogg_calloc(vc->comments+1,sizeof(*vc->user_comments));
+  vc->comment_lengths=_ogg_calloc(vc->comments+1,sizeof(*vc->comment_lengths));
+
+  for(i=0;i<vc->comments;i++){
+    long keep;
+    if(bytes-pos<4)goto err_out;
+    len=_comment_read32(p+pos);
+    pos+=4;
+    if(len>(unsigned long)(bytes-pos))goto err_out;
+
+    keep=len;
+    if(len>(unsigned long)vf->comment_limit){
+      const unsigned char *eq=memchr(p+pos,'=',len);
+      keep=(eq?eq-(p+pos)+1:0);
+      if(keep>vf->comment_limit)keep=vf->comment_limit;
+      if(_comment_skips_add(vf,link,i,pos,len))goto err_out;
+    }
+    vc->comment_lengths[i]=keep;
+    vc->user_comments[i]=_ogg_calloc(keep+1,1);
+    memcpy(vc->user_comments[i],p+pos,keep);
+    pos+=len;
+  }
+  if(pos>=bytes || !(p[pos]&1))goto err_out; /* EOP check */
+
+  return(0);
+ err_out:
+  vorbis_comment_clear(vc);
+  _comment_skips_drop(vf,link);
+  return(OV_EBADHEADER);
+}
+
+/* vorbis_synthesis_headerin(), or _headerskim() with skim set, save
+   that with a comment limit the comment header is unpacked here */
+static int _headerin(OggVorbis_File *vf,vorbis_info *vi,vorbis_comment *vc,
+                     ogg_packet *op,int link,int skim){
+  if(vf->comment_limit>0 && op->bytes>=7 && op->packet[0]==0x03 &&
+     !memcmp(op->packet+1,"vorbis",6))
+    return(_unpack_comment_limit(vf,vi,vc,op,link));
+  if(skim)
+    return(vorbis_synthesis_headerskim(vi,vc,op));
+  return(vorbis_synthesis_headerin(vi,vc,op));
+}
+
+/* streaming, whether setup header op, of a link whose id header is
+   in vi, is that of the current link with the same channels and
+   blocksizes, so that the decoder built for the current link can
+   carry on into the new one */
+static int _link_setup_same(OggVorbis_File *vf,vorbis_info *vi,
+                            ogg_packet *op){
+  if(vf->link_setup_bytes==0 || vf->link_setup_bytes!=op->bytes)return(0);
+  if(vf->vi->channels!=vi->channels ||
+     vorbis_info_blocksize(vf->vi,0)!=vorbis_info_blocksize(vi,0) ||
+     vorbis_info_blocksize(vf->vi,1)!=vorbis_info_blocksize(vi,1))
+    return(0);
+  return(!memcmp(vf->link_setup,op->packet,op->bytes));
+}
+
+static int _link_setup_keep(OggVorbis_File *vf,ogg_packet *op){
+  if(op->bytes>vf->link_setup_storage){
+    unsigned char *p=_ogg_realloc(vf->link_setup,op->bytes);
+    if(!p)return(OV_EFAULT);
+    vf->link_setup=p;
+    vf->link_setup_storage=op->bytes;
+  }
+  memcpy(vf->link_setup,op->packet,op->bytes);
+  vf->link_setup_bytes=op->bytes;
+  return(0);
+}
+
 /* uses the local ogg_stream storage in vf; this is important for
-   non-streaming input sources */
+   non-streaming input sources.  With skim set, the setup header is
+   only checked and kept (see vorbis_synthesis_headerskim()).  link is
+   the link the headers belong to, for the comment limit.
+
+   Streaming, the setup header is kept in vf to compare the next
+   link's with.  If it is the same as the current link's, it is not
+   unpacked into vi and 1 is returned (see _fetch_link_headers()) */
 static int _fetch_headers(OggVorbis_File *vf,vorbis_info *vi,vorbis_comment *vc,
                           long **serialno_list, int *serialno_n,
-                          ogg_page *og_ptr){
+                          ogg_page *og_ptr, int link, int skim){
   ogg_page og;
   ogg_packet op;
   int i,ret;
   int allbos=0;
+  int same=0;
 
   if(!og_ptr){
     ogg_int64_t llret=_get_next_page(vf,&og,CHUNKSIZE);
@@ -371,8 +511,16 @@ static int _fetch_headers(OggVorbis_File *vf,vorbis_info *vi,vorbis_comment *vc,
           goto bail_header;
         }
 
-        if((ret=vorbis_synthesis_headerin(vi,vc,&op)))
-          goto bail_header;
+        if(i==1 && !vf->seekable){
+          /* the setup header */
+          same=_link_setup_same(vf,vi,&op);
+          if(!same){
+            ret=_headerin(vf,vi,vc,&op,link,skim);
+            if(!ret)ret=_link_setup_keep(vf,&op);
+          }
+        }else
+          ret=_headerin(vf,vi,vc,&op,link,skim);
+        if(ret)goto bail_header;
 
         i++;
       }
@@ -403,12 +551,24 @@ static int _fetch_headers(OggVorbis_File *vf,vorbis_info *vi,vorbis_comment *vc,
       }
     }
 
-    return 0;
+    /* the stream storage grew to hold any comments left in the
+       file; audio starts on a fresh page, so nothing is lost by
+       letting it go */
+    if(vf->comment_limit>0 && vf->os.body_storage>CHUNKSIZE &&
+       ogg_stream_packetpeek(&vf->os,NULL)==0){
+      long serialno=vf->os.serialno;
+      ogg_stream_clear(&vf->os);
+      ogg_stream_init(&vf->os,serialno);
+      ogg_stream_reset(&vf->os);
+    }
+
+    return same;
   }
 
  bail_header:
   vorbis_info_clear(vi);
   vorbis_comment_clear(vc);
+  _comment_skips_drop(vf,link);
   vf->ready_state=OPENED;
 
   return ret;
@@ -506,6 +666,7 @@ static int _bisect_forward_serialno(OggVorbis_File *vf,
     if(vf->offsets)_ogg_free(vf->offsets);
     if(vf->serialnos)_ogg_free(vf->serialnos);
     if(vf->dataoffsets)_ogg_free(vf->dataoffsets);
+    if(vf->link_used)_ogg_free(vf->link_used);
 
     vf->offsets=_ogg_malloc((vf->links+1)*sizeof(*vf->offsets));
     vf->vi=_ogg_realloc(vf->vi,vf->links*sizeof(*vf->vi));
@@ -513,6 +674,7 @@ static int _bisect_forward_serialno(OggVorbis_File *vf,
     vf->serialnos=_ogg_malloc(vf->links*sizeof(*vf->serialnos));
     vf->dataoffsets=_ogg_malloc(vf->links*sizeof(*vf->dataoffsets));
     vf->pcmlengths=_ogg_malloc(vf->links*2*sizeof(*vf->pcmlengths));
+    vf->link_used=_ogg_calloc(vf->links,sizeof(*vf->link_used));
 
     vf->offsets[m+1]=end;
     vf->offsets[m]=begin;
@@ -565,7 +727,9 @@ static int _bisect_forward_serialno(OggVorbis_File *vf,
     ret=_seek_helper(vf,next);
     if(ret)return(ret);
 
-    ret=_fetch_headers(vf,&vi,&vc,&next_serialno_list,&next_serialnos,NULL);
+    /* the setups of later links are unpacked when they're entered */
+    ret=_fetch_headers(vf,&vi,&vc,&next_serialno_list,&next_serialnos,NULL,
+                       m+1,1);
     if(ret)return(ret);
     serialno = vf->os.serialno;
     dataoffset = vf->offset;
@@ -595,10 +759,65 @@ static int _bisect_forward_serialno(OggVorbis_File *vf,
   return(0);
 }
 
+/* The setups of links past the first are only skimmed at open and
+   unpacked by vorbis_synthesis_init() as each link is entered.  Marks
+   link 'keep' as most recently entered and releases the least
+   recently entered setups beyond the cache bound.  The first link's
+   setup is unpacked at open and always kept. */
+static void _link_setups_trim(OggVorbis_File *vf,int keep){
+  int limit=(vf->link_cache>0?vf->link_cache:LINKSETUPS);
+
+  if(!vf->link_used)return;
+  if(keep>0)vf->link_used[keep]=++vf->link_clock;
+
+  while(1){
+    int i,resident=0,oldest=-1;
+    for(i=1;i<vf->links;i++)
+      if(vf->link_used[i]){
+        resident++;
+        if(i!=keep && (oldest<0 || vf->link_used[i]<vf->link_used[oldest]))
+          oldest=i;
+      }
+    if(resident<=limit || oldest<0)break;
+
+    vorbis_synthesis_unload(vf->vi+oldest);
+    vf->link_used[oldest]=0;
+  }
+}
+
+/* Remembers the position of a page with a granulepos, met while
+   seeking or decoding, so later seeks can start their bisection
+   closer in.  The cache is a ring of (offset, granulepos, serialno)
+   triples.  Bisection revisits pages, and callers reread regions, so
+   a page already in the cache isn't added again. */
+static void _page_cache_add(OggVorbis_File *vf,ogg_int64_t offset,
+                            ogg_page *og){
+  ogg_int64_t granulepos=ogg_page_granulepos(og);
+  ogg_int64_t *e;
+  long i,n;
+
+  if(!vf->seekable || granulepos==-1)return;
+  if(!vf->page_cache){
+    vf->page_cache=_ogg_malloc(PAGECACHE*3*sizeof(*vf->page_cache));
+    if(!vf->page_cache)return;
+  }
+
+  n=(vf->page_cache_count<PAGECACHE?vf->page_cache_count:PAGECACHE);
+  for(i=0;i<n;i++)
+    if(vf->page_cache[i*3]==offset)return;
+
+  e=vf->page_cache+(vf->page_cache_count%PAGECACHE)*3;
+  e[0]=offset;
+  e[1]=granulepos;
+  e[2]=ogg_page_serialno(og);
+  vf->page_cache_count++;
+}
+
 static int _make_decode_ready(OggVorbis_File *vf){
   if(vf->ready_state>STREAMSET)return 0;
   if(vf->ready_state<STREAMSET)return OV_EFAULT;
   if(vf->seekable){
+    _link_setups_trim(vf,vf->current_link);
     if(vorbis_synthesis_init(&vf->vd,vf->vi+vf->current_link))
       return OV_EBADLINK;
   }else{
@@ -658,9 +877,189 @@ static int _open_seekable2(OggVorbis_File *vf){
 static void _decode_clear(OggVorbis_File *vf){
   vorbis_dsp_clear(&vf->vd);
   vorbis_block_clear(&vf->vb);
+  vf->packet_blocksize=0;
   vf->ready_state=OPENED;
 }
 
+/* streaming, reads the headers of the link beginning with og, a BOS
+   page, in place of those of the link just left.  If the new setup
+   header is the one the current link's decoder was built from, as
+   from link to link of a stream with a single encoder, it isn't
+   unpacked; the vorbis_dsp_state and vorbis_block are restarted and
+   carry on.  Otherwise they are cleared, and _make_decode_ready()
+   builds them afresh for the new setup.  The halfrate setting carries
+   over either way.
+
+   The header pages are submitted to the stream state here */
+static int _fetch_link_headers(OggVorbis_File *vf,ogg_page *og){
+  vorbis_info vi;
+  vorbis_comment vc;
+  int state=vf->ready_state;
+  int hs=(vf->vi->codec_setup?vorbis_synthesis_halfrate_p(vf->vi):0);
+  int ret=_fetch_headers(vf,&vi,&vc,NULL,NULL,og,0,0);
+
+  if(ret<0){
+    _decode_clear(vf);
+    vorbis_info_clear(vf->vi);
+    vorbis_comment_clear(vf->vc);
+    vf->link_setup_bytes=0;
+    return(ret);
+  }
+
+  if(ret){
+    /* the same setup; take what the decoder doesn't depend on */
+    vf->vi->version=vi.version;
+    vf->vi->rate=vi.rate;
+    vf->vi->bitrate_upper=vi.bitrate_upper;
+    vf->vi->bitrate_nominal=vi.bitrate_nominal;
+    vf->vi->bitrate_lower=vi.bitrate_lower;
+    vf->vi->bitrate_window=vi.bitrate_window;
+    vorbis_info_clear(&vi);
+
+    if(state==INITSET){
+      vorbis_synthesis_restart(&vf->vd);
+      vf->bittrack=0.f;
+      vf->samptrack=0.f;
+    }
+    vf->packet_blocksize=0;
+    vf->ready_state=state;
+  }else{
+    _decode_clear(vf);
+    vorbis_info_clear(vf->vi);
+    *vf->vi=vi;
+    if(hs)vorbis_synthesis_halfrate(vf->vi,hs);
+    vf->ready_state=STREAMSET;
+  }
+  vorbis_comment_clear(vf->vc);
+  *vf->vc=vc;
+
+  vf->current_serialno=vf->os.serialno;
+  vf->current_link++;
+  return(0);
+}
+
+/* fetch the next page of the logical bitstream being read and submit
+   it to the stream state.  Handles the case where we're at a bitstream
+   boundary and dumps the decoding machine; streaming, the headers of
+   the next link are read.  Decoding and packet reads (see
+   ov_read_packet()) both get their pages here.
+
+   return: <0) error or OV_EOF
+            0) need more data (only if readp==0)
+            1) submitted a page
+*/
+
+static int _fetch_page(OggVorbis_File *vf,int readp,int spanp){
+  ogg_page og;
+
+  while(1){
+
+    if(vf->ready_state>=OPENED){
+      ogg_int64_t ret;
+
+      while(1){
+        /* the loop is not strictly necessary, but there's no sense in
+           doing the extra checks of the larger loop for the common
+           case in a multiplexed bistream where the page is simply
+           part of a different logical bitstream; keep reading until
+           we get one with the correct serialno */
+
+        if(!readp)return(0);
+        if((ret=_get_next_page(vf,&og,-1))<0){
+          return(OV_EOF); /* eof. leave unitialized */
+        }
+        _page_cache_add(vf,ret,&og);
+
+        /* bitrate tracking; add the header's bytes here, the body bytes
+           are done by the packet readers */
+        vf->bittrack+=og.header_len*8;
+
+        if(vf->ready_state>=STREAMSET){
+          if(vf->current_serialno!=ogg_page_serialno(&og)){
+
+            /* two possibilities:
+               1) our decoding just traversed a bitstream boundary
+               2) another stream is multiplexed into this logical section */
+
+            if(ogg_page_bos(&og)){
+              /* boundary case */
+              if(!spanp)
+                return(OV_EOF);
+
+              if(!vf->seekable){
+                /* the headers of the next link are read, and their
+                   pages submitted, here */
+                ret=_fetch_link_headers(vf,&og);
+                if(ret)return(ret);
+                return(1);
+              }
+
+              _decode_clear(vf);
+              break;
+
+            }else
+              continue; /* possibility #2 */
+          }
+        }
+
+        break;
+      }
+    }
+
+    /* Do we need to load a new machine before submitting the page? */
+    /* This is different in the seekable and non-seekable cases.
+
+       In the seekable case, we already have all the header
+       information loaded and cached; we just initialize the machine
+       with it and continue on our merry way.
+
+       In the non-seekable (streaming) case, we'll only be at a
+       boundary if we just left the previous logical bitstream and
+       we're now nominally at the header of the next bitstream
+    */
+
+    if(vf->ready_state!=INITSET){
+      int link;
+
+      if(vf->ready_state<STREAMSET){
+        if(vf->seekable){
+          long serialno = ogg_page_serialno(&og);
+
+          /* match the serialno to bitstream section.  We use this rather than
+             offset positions to avoid problems near logical bitstream
+             boundaries */
+
+          for(link=0;link<vf->links;link++)
+            if(vf->serialnos[link]==serialno)break;
+
+          if(link==vf->links) continue; /* not the desired Vorbis
+                                           bitstream section; keep
+                                           trying */
+
+          vf->current_serialno=serialno;
+          vf->current_link=link;
+
+          ogg_stream_reset_serialno(&vf->os,vf->current_serialno);
+          vf->ready_state=STREAMSET;
+
+        }else{
+          /* we're streaming */
+          /* fetch the three header packets, build the info struct */
+
+          int ret=_fetch_link_headers(vf,&og);
+          if(ret)return(ret);
+          return(1); /* the header pages are in */
+        }
+      }
+    }
+
+    /* the buffered page is the data we want, and we're ready for it;
+       add it to the stream state */
+    ogg_stream_pagein(&vf->os,&og);
+    return(1);
+  }
+}
+
 /* fetch and process a packet.  Handles the case where we're at a
    bitstream boundary and dumps the decoding machine.  If the decoding
    machine is unloaded, it loads it.  It also keeps pcm_offset up to
@@ -676,7 +1075,6 @@ static int _fetch_and_process_packet(OggVorbis_File *vf,
                                      ogg_packet *op_in,
                                      int readp,
                                      int spanp){
-  ogg_page og;
 
   /* handle one packet.  Try to fetch it from current stream state */
   /* extract packets from page */
@@ -763,107 +1161,10 @@ static int _fetch_and_process_packet(OggVorbis_File *vf,
       }
     }
 
-    if(vf->ready_state>=OPENED){
-      ogg_int64_t ret;
-
-      while(1){
-        /* the loop is not strictly necessary, but there's no sense in
-           doing the extra checks of the larger loop for the common
-           case in a multiplexed bistream where the page is simply
-           part of a different logical bitstream; keep reading until
-           we get one with the correct serialno */
-
-        if(!readp)return(0);
-        if((ret=_get_next_page(vf,&og,-1))<0){
-          return(OV_EOF); /* eof. leave unitialized */
-        }
-
-        /* bitrate tracking; add the header's bytes here, the body bytes
-           are done by packet above */
-        vf->bittrack+=og.header_len*8;
-
-        if(vf->ready_state==INITSET){
-          if(vf->current_serialno!=ogg_page_serialno(&og)){
-
-            /* two possibilities:
-               1) our decoding just traversed a bitstream boundary
-               2) another stream is multiplexed into this logical section */
-
-            if(ogg_page_bos(&og)){
-              /* boundary case */
-              if(!spanp)
-                return(OV_EOF);
-
-              _decode_clear(vf);
-
-              if(!vf->seekable){
-                vorbis_info_clear(vf->vi);
-                vorbis_comment_clear(vf->vc);
-              }
-              break;
-
-            }else
-              continue; /* possibility #2 */
-          }
-        }
-
-        break;
-      }
-    }
-
-    /* Do we need to load a new machine before submitting the page? */
-    /* This is different in the seekable and non-seekable cases.
-
-       In the seekable case, we already have all the header
-       information loaded and cached; we just initialize the machine
-       with it and continue on our merry way.
-
-       In the non-seekable (streaming) case, we'll only be at a
-       boundary if we just left the previous logical bitstream and
-       we're now nominally at the header of the next bitstream
-    */
-
-    if(vf->ready_state!=INITSET){
-      int link;
-
-      if(vf->ready_state<STREAMSET){
-        if(vf->seekable){
-          long serialno = ogg_page_serialno(&og);
-
-          /* match the serialno to bitstream section.  We use this rather than
-             offset positions to avoid problems near logical bitstream
-             boundaries */
-
-          for(link=0;link<vf->links;link++)
-            if(vf->serialnos[link]==serialno)break;
-
-          if(link==vf->links) continue; /* not the desired Vorbis
-                                           bitstream section; keep
-                                           trying */
-
-          vf->current_serialno=serialno;
-          vf->current_link=link;
-
-          ogg_stream_reset_serialno(&vf->os,vf->current_serialno);
-          vf->ready_state=STREAMSET;
-
-        }else{
-          /* we're streaming */
-          /* fetch the three header packets, build the info struct */
-
-          int ret=_fetch_headers(vf,vf->vi,vf->vc,NULL,NULL,&og);
-          if(ret)return(ret);
-          vf->current_serialno=vf->os.serialno;
-          vf->current_link++;
-          link=0;
-        }
-      }
+    {
+      int ret=_fetch_page(vf,readp,spanp);
+      if(ret<=0)return(ret);
     }
-
-    /* the buffered page is the data we want, and we're ready for it;
-       add it to the stream state */
-    ogg_stream_pagein(&vf->os,&og);
-
   }
 }
 
@@ -875,7 +1176,7 @@ static int _fseek64_wrap(FILE *f,ogg_int64_t off,int whence){
 }
 
 static int _ov_open1(void *f,OggVorbis_File *vf,const char *initial,
-                     long ibytes, ov_callbacks callbacks){
+                     long ibytes, ov_callbacks callbacks,long comment_limit){
   int offsettest=((f && callbacks.seek_func)?callbacks.seek_func(f,0,SEEK_CUR):-1);
   long *serialno_list=NULL;
   int serialno_list_size=0;
@@ -884,6 +1185,7 @@ static int _ov_open1(void *f,OggVorbis_File *vf,const char *initial,
   memset(vf,0,sizeof(*vf));
   vf->datasource=f;
   vf->callbacks = callbacks;
+  vf->comment_limit=comment_limit;
 
   /* init the framing state */
   ogg_sync_init(&vf->oy);
@@ -910,7 +1212,7 @@ static int _ov_open1(void *f,OggVorbis_File *vf,const char *initial,
 
   /* Fetch all BOS pages, store the vorbis header and all seen serial
      numbers, load subsequent vorbis setup headers */
-  if((ret=_fetch_headers(vf,vf->vi,vf->vc,&serialno_list,&serialno_list_size,NULL))<0){
+  if((ret=_fetch_headers(vf,vf->vi,vf->vc,&serialno_list,&serialno_list_size,NULL,0,0))<0){
     vf->datasource=NULL;
     ov_clear(vf);
   }else{
@@ -970,6 +1272,11 @@ int ov_clear(OggVorbis_File *vf){
     if(vf->pcmlengths)_ogg_free(vf->pcmlengths);
     if(vf->serialnos)_ogg_free(vf->serialnos);
     if(vf->offsets)_ogg_free(vf->offsets);
+    if(vf->link_used)_ogg_free(vf->link_used);
+    if(vf->page_cache)_ogg_free(vf->page_cache);
+    if(vf->lap_pcm)_ogg_free(vf->lap_pcm);
+    if(vf->comment_skips)_ogg_free(vf->comment_skips);
+    if(vf->link_setup)_ogg_free(vf->link_setup);
     ogg_sync_clear(&vf->oy);
     if(vf->datasource && vf->callbacks.close_func)
       (vf->callbacks.close_func)(vf->datasource);
@@ -991,7 +1298,20 @@ int ov_clear(OggVorbis_File *vf){
 
 int ov_open_callbacks(void *f,OggVorbis_File *vf,
     const char *initial,long ibytes,ov_callbacks callbacks){
-  int ret=_ov_open1(f,vf,initial,ibytes,callbacks);
+  int ret=_ov_open1(f,vf,initial,ibytes,callbacks,0);
+  if(ret)return ret;
+  return _ov_open2(vf);
+}
+
+/* as ov_open_callbacks(), but comments longer than comment_limit
+   bytes are not read into the vorbis_comment; only their tags are
+   kept, and ov_comment_fetch() reads the rest back on demand */
+int ov_open_callbacks_limit(void *f,OggVorbis_File *vf,
+    const char *initial,long ibytes,ov_callbacks callbacks,
+    long comment_limit){
+  int ret;
+  if(comment_limit<0)return(OV_EINVAL);
+  ret=_ov_open1(f,vf,initial,ibytes,callbacks,comment_limit);
   if(ret)return ret;
   return _ov_open2(vf);
 }
@@ -1063,7 +1383,7 @@ int ov_halfrate_p(OggVorbis_File *vf){
 int ov_test_callbacks(void *f,OggVorbis_File *vf,
     const char *initial,long ibytes,ov_callbacks callbacks)
 {
-  return _ov_open1(f,vf,initial,ibytes,callbacks);
+  return _ov_open1(f,vf,initial,ibytes,callbacks,0);
 }
 
 int ov_test(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes){
@@ -1082,6 +1402,26 @@ int ov_test_open(OggVorbis_File *vf){
   return _ov_open2(vf);
 }
 
+/* Sets how many link setups of a chained file may be unpacked at
+   once, besides the first link's; the rest are unpacked again when
+   their link is next entered */
+int ov_link_cache(OggVorbis_File *vf,int links){
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  if(links<1)return(OV_EINVAL);
+  vf->link_cache=links;
+  _link_setups_trim(vf,vf->current_link);
+  return(0);
+}
+
+/* how often the page cache narrowed a seek's bisection past its
+   first step (hits) or did not (misses) */
+int ov_page_cache_stats(OggVorbis_File *vf,long *hits,long *misses){
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  if(hits)*hits=vf->page_cache_hits;
+  if(misses)*misses=vf->page_cache_misses;
+  return(0);
+}
+
 /* How many logical bitstreams in this physical bitstream? */
 long ov_streams(OggVorbis_File *vf){
   return vf->links;
@@ -1182,44 +1522,392 @@ ogg_int64_t ov_raw_total(OggVorbis_File *vf,int i){
   }else{
     return(vf->offsets[i+1]-vf->offsets[i]);
   }
-}
+}
+
+/* returns: total PCM length (samples) of content if i==-1 PCM length
+            (samples) of that logical bitstream for i==0 to n
+            OV_EINVAL if the stream is not seekable (we can't know the
+            length) or only partially open
+*/
+ogg_int64_t ov_pcm_total(OggVorbis_File *vf,int i){
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  if(!vf->seekable || i>=vf->links)return(OV_EINVAL);
+  if(i<0){
+    ogg_int64_t acc=0;
+    int i;
+    for(i=0;i<vf->links;i++)
+      acc+=ov_pcm_total(vf,i);
+    return(acc);
+  }else{
+    return(vf->pcmlengths[i*2+1]);
+  }
+}
+
+/* returns: total seconds of content if i==-1
+            seconds in that logical bitstream for i==0 to n
+            OV_EINVAL if the stream is not seekable (we can't know the
+            length) or only partially open
+*/
+double ov_time_total(OggVorbis_File *vf,int i){
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  if(!vf->seekable || i>=vf->links)return(OV_EINVAL);
+  if(i<0){
+    double acc=0;
+    int i;
+    for(i=0;i<vf->links;i++)
+      acc+=ov_time_total(vf,i);
+    return(acc);
+  }else{
+    return((double)(vf->pcmlengths[i*2+1])/vf->vi[i].rate);
+  }
+}
+
+/* ov_scan() reads a stream through once and looks only at page
+   headers; the bodies of audio pages are stepped over by their segment
+   tables, without checksumming them or copying them into an ogg_sync
+   framer.  The packets of a link are only gathered up to its first
+   granulepos past the headers, for the setup and the initial pcm
+   offset as _initial_pcmoffset() finds it.  The comment header is
+   stepped over too; an empty one stands in for it.  A page cut off by
+   the end of the stream is left out, as the framer would leave it */
+
+typedef struct {
+  void          *datasource;
+  ov_callbacks   callbacks;
+  unsigned char *data;
+  long           fill;   /* bytes in data */
+  long           pos;    /* cursor in data */
+  ogg_int64_t    offset; /* of data[0] in the stream */
+
+  /* the link being scanned */
+  ov_scan_link   link;
+  vorbis_info    vi;
+  vorbis_comment vc;
+  int            headers;     /* header packets seen; 3 once in the audio */
+  long           packetbytes; /* of the packet continuing on the next page */
+  int            dropping;    /* the rest of a packet begun before a hole */
+  unsigned char  firstbyte;   /* all vorbis_packet_blocksize() reads */
+  unsigned char *setup;
+  long           setup_bytes;
+  long           setup_storage;
+  long           lastblock;
+  ogg_int64_t    accumulated;
+  ogg_int64_t    pcmoffset;   /* -1 until the first granulepos in the audio */
+  ogg_int64_t    granulepos;  /* -1 until one is seen */
+} scan_state;
+
+/* makes n bytes (at most CHUNKSIZE) available at the cursor; returns
+   the bytes available, fewer only at the end of the stream, or
+   OV_EREAD */
+static long _scan_need(scan_state *s,long n){
+  if(s->fill-s->pos>=n)return(s->fill-s->pos);
+  if(s->pos){
+    memmove(s->data,s->data+s->pos,s->fill-s->pos);
+    s->offset+=s->pos;
+    s->fill-=s->pos;
+    s->pos=0;
+  }
+  while(s->fill<n){
+    long bytes;
+    errno=0;
+    bytes=(s->callbacks.read_func)(s->data+s->fill,1,CHUNKSIZE-s->fill,
+                                   s->datasource);
+    if(bytes==0){
+      if(errno)return(OV_EREAD);
+      break;
+    }
+    s->fill+=bytes;
+  }
+  return(s->fill);
+}
+
+static void _scan_link_begin(scan_state *s,ogg_int64_t offset){
+  memset(&s->link,0,sizeof(s->link));
+  s->link.serialno=-1;
+  s->link.offset=offset;
+  vorbis_info_init(&s->vi);
+  vorbis_comment_init(&s->vc);
+  s->headers=0;
+  s->packetbytes=0;
+  s->dropping=0;
+  s->setup_bytes=0;
+  s->lastblock=-1;
+  s->accumulated=0;
+  s->pcmoffset=-1;
+  s->granulepos=-1;
+}
+
+/* closes the link being scanned at end, and stores it if there's
+   room */
+static int _scan_link_end(scan_state *s,ogg_int64_t end,
+                          ov_scan_link *links,long n,long count){
+  ov_scan_link *l=&s->link;
+  int ret=0;
+
+  if(s->headers==0)ret=OV_ENOTVORBIS;
+  else if(s->headers<3)ret=OV_EBADHEADER;
+  else{
+    l->rate=s->vi.rate;
+    l->channels=s->vi.channels;
+    l->end=end;
+    l->pcmlength=(s->granulepos<0?0:s->granulepos)-
+      (s->pcmoffset<0?0:s->pcmoffset);
+    if(l->pcmlength<0)l->pcmlength=0;
+    if(l->pcmlength>0)
+      l->bitrate=rint((l->end-l->dataoffset)*8/
+                      ((double)l->pcmlength/l->rate));
+    if(count<n)links[count]=*l;
+  }
+  vorbis_info_clear(&s->vi);
+  vorbis_comment_clear(&s->vc);
+  return(ret);
+}
+
+/* gathers the packets of a page of the link's vorbis stream that the
+   scan needs */
+static int _scan_packets(scan_state *s,ogg_page *og){
+  int segments=og->header[26];
+  unsigned char *body=og->body;
+  int i;
+
+  if(!ogg_page_continued(og)){
+    /* a lost header is fatal; a lost audio packet just isn't counted */
+    if(s->packetbytes && s->headers<3)return(OV_EBADHEADER);
+    s->packetbytes=0;
+    s->dropping=0;
+  }else if(s->packetbytes==0)
+    s->dropping=1;
+
+  for(i=0;i<segments;i++){
+    int val=og->header[27+i];
+
+    if(s->dropping){
+      body+=val;
+      if(val<255)s->dropping=0;
+      continue;
+    }
+
+    if(s->headers==2){
+      if(s->setup_bytes+val>s->setup_storage){
+        long storage=(s->setup_bytes+val)*2;
+        unsigned char *ret=_ogg_realloc(s->setup,storage);
+        if(!ret)return(OV_EFAULT);
+        s->setup=ret;
+        s->setup_storage=storage;
+      }
+      memcpy(s->setup+s->setup_bytes,body,val);
+      s->setup_bytes+=val;
+    }else if(s->packetbytes==0 && val>0)
+      s->firstbyte=body[0];
+    s->packetbytes+=val;
+    body+=val;
+    if(val==255)continue;
+
+    /* a packet ends */
+    if(s->headers==1){
+      static unsigned char empty[16]=
+        {0x03,'v','o','r','b','i','s',0,0,0,0,0,0,0,0,1};
+      ogg_packet op;
+      memset(&op,0,sizeof(op));
+      op.packet=empty;
+      op.bytes=sizeof(empty);
+      op.packetno=1;
+      if(vorbis_synthesis_headerin(&s->vi,&s->vc,&op))return(OV_EFAULT);
+      s->headers=2;
+    }else if(s->headers==2){
+      ogg_packet op;
+      memset(&op,0,sizeof(op));
+      op.packet=s->setup;
+      op.bytes=s->setup_bytes;
+      op.packetno=2;
+      if(vorbis_synthesis_headerskim(&s->vi,&s->vc,&op))
+        return(OV_EBADHEADER);
+      s->headers=3;
+    }else if(s->pcmoffset==-1 && s->packetbytes>0){
+      ogg_packet op;
+      long thisblock;
+      memset(&op,0,sizeof(op));
+      op.packet=&s->firstbyte;
+      op.bytes=1;
+      thisblock=vorbis_packet_blocksize(&s->vi,&op);
+      if(thisblock>=0){
+        if(s->lastblock!=-1)
+          s->accumulated+=(s->lastblock+thisblock)>>2;
+        s->lastblock=thisblock;
+      }
+    }
+    s->packetbytes=0;
+  }
+  return(0);
+}
+
+/* reads a stream through from its current position and finds the
+   links in it, the exact pcm length of each and the average bitrate
+   of its audio, looking at no more than it must (see above).  The
+   stream needn't be seekable.  The first n links are stored in links.
+
+   returns the number of links in the stream, which may be more than
+   n, or <0 for an error */
+long ov_scan_callbacks(void *datasource,ov_callbacks callbacks,
+                       ov_scan_link *links,long n){
+  scan_state s;
+  ogg_int64_t pageend=0; /* of the last whole page */
+  long count=0;
+  int inlink=0;
+  int bosgroup=0;
+  int verify=0;
+  long ret=0;
+
+  if(!callbacks.read_func || n<0 || (n>0 && !links))return(OV_EINVAL);
+
+  memset(&s,0,sizeof(s));
+  s.datasource=datasource;
+  s.callbacks=callbacks;
+  s.data=_ogg_malloc(CHUNKSIZE);
+  if(!s.data)return(OV_EFAULT);
+
+  while(1){
+    ogg_page og;
+    ogg_int64_t pageoffset;
+    long bodybytes=0,avail;
+    int segments,i;
+
+    avail=_scan_need(&s,27);
+    if(avail<27)break;
+    og.header=s.data+s.pos;
+
+    /* out of sync: look for a page, and believe it only if its
+       checksum is good */
+    if(memcmp(og.header,"OggS",4) || og.header[4]!=0){
+      unsigned char *next=memchr(og.header+1,'O',s.fill-s.pos-1);
+      s.pos=(next?next-s.data:s.fill);
+      verify=1;
+      continue;
+    }
+
+    segments=og.header[26];
+    avail=_scan_need(&s,27+segments);
+    if(avail<27+segments)break;
+    og.header=s.data+s.pos;
+    og.header_len=27+segments;
+    for(i=0;i<segments;i++)
+      bodybytes+=og.header[27+i];
+    og.body_len=bodybytes;
+    pageoffset=s.offset+s.pos;
+
+    avail=_scan_need(&s,og.header_len+og.body_len);
+    if(avail<og.header_len+og.body_len)break;
+    og.header=s.data+s.pos;
+    og.body=og.header+og.header_len;
+
+    if(verify){
+      unsigned char crc[4];
+      memcpy(crc,og.header+22,4);
+      ogg_page_checksum_set(&og);
+      if(memcmp(crc,og.header+22,4)){
+        memcpy(og.header+22,crc,4);
+        s.pos++;
+        continue;
+      }
+      verify=0;
+    }
+
+    if(ogg_page_bos(&og)){
+      if(!bosgroup){
+        /* a new link begins */
+        if(inlink){
+          ret=_scan_link_end(&s,pageoffset,links,n,count);
+          inlink=0;
+          if(ret)goto done;
+          count++;
+        }
+        _scan_link_begin(&s,count?pageoffset:0);
+        inlink=1;
+        bosgroup=1;
+      }
+
+      /* the first vorbis stream of the link is the one scanned */
+      if(s.headers==0){
+        ogg_packet op;
+        memset(&op,0,sizeof(op));
+        op.packet=og.body;
+        for(i=0;i<segments;i++){
+          op.bytes+=og.header[27+i];
+          if(og.header[27+i]<255)break;
+        }
+        op.b_o_s=1;
+        if(vorbis_synthesis_idheader(&op)){
+          if(vorbis_synthesis_headerin(&s.vi,&s.vc,&op)){
+            ret=OV_EBADHEADER;
+            goto done;
+          }
+          s.link.serialno=ogg_page_serialno(&og);
+          s.headers=1;
+        }
+      }
+    }else{
+      if(!inlink){
+        ret=OV_ENOTVORBIS;
+        goto done;
+      }
+      bosgroup=0;
+
+      if(ogg_page_serialno(&og)==s.link.serialno && s.headers>0){
+        ogg_int64_t granulepos=ogg_page_granulepos(&og);
+        /* the packets are only looked into for the headers and up to
+           the first granulepos */
+        if(s.headers<3 || s.pcmoffset==-1){
+          int headers=s.headers;
+          ret=_scan_packets(&s,&og);
+          if(ret)goto done;
+          if(headers<3 && s.headers==3)
+            s.link.dataoffset=pageoffset+og.header_len+og.body_len;
+          else if(s.headers==3 && granulepos!=-1){
+            /* pcm offset of last packet on the first audio page */
+            s.pcmoffset=granulepos-s.accumulated;
+            if(s.pcmoffset<0)s.pcmoffset=0;
+          }
+        }
+        if(granulepos!=-1)s.granulepos=granulepos;
+      }
+    }
+
+    s.pos+=og.header_len+og.body_len;
+    pageend=s.offset+s.pos;
+  }
 
-/* returns: total PCM length (samples) of content if i==-1 PCM length
-            (samples) of that logical bitstream for i==0 to n
-            OV_EINVAL if the stream is not seekable (we can't know the
-            length) or only partially open
-*/
-ogg_int64_t ov_pcm_total(OggVorbis_File *vf,int i){
-  if(vf->ready_state<OPENED)return(OV_EINVAL);
-  if(!vf->seekable || i>=vf->links)return(OV_EINVAL);
-  if(i<0){
-    ogg_int64_t acc=0;
-    int i;
-    for(i=0;i<vf->links;i++)
-      acc+=ov_pcm_total(vf,i);
-    return(acc);
-  }else{
-    return(vf->pcmlengths[i*2+1]);
+  /* a cut off page at the end isn't part of the link */
+  if(inlink){
+    ret=_scan_link_end(&s,pageend,links,n,count);
+    inlink=0;
+    if(!ret)ret=++count;
+  }else
+    ret=OV_ENOTVORBIS;
+
+ done:
+  if(inlink){
+    vorbis_info_clear(&s.vi);
+    vorbis_comment_clear(&s.vc);
   }
+  if(s.setup)_ogg_free(s.setup);
+  _ogg_free(s.data);
+  return(ret);
 }
 
-/* returns: total seconds of content if i==-1
-            seconds in that logical bitstream for i==0 to n
-            OV_EINVAL if the stream is not seekable (we can't know the
-            length) or only partially open
-*/
-double ov_time_total(OggVorbis_File *vf,int i){
-  if(vf->ready_state<OPENED)return(OV_EINVAL);
-  if(!vf->seekable || i>=vf->links)return(OV_EINVAL);
-  if(i<0){
-    double acc=0;
-    int i;
-    for(i=0;i<vf->links;i++)
-      acc+=ov_time_total(vf,i);
-    return(acc);
-  }else{
-    return((double)(vf->pcmlengths[i*2+1])/vf->vi[i].rate);
-  }
+long ov_scan(const char *path,ov_scan_link *links,long n){
+  ov_callbacks callbacks = {
+    (size_t (*)(void *, size_t, size_t, void *))  fread,
+    (int (*)(void *, ogg_int64_t, int))              NULL,
+    (int (*)(void *))                             NULL,
+    (long (*)(void *))                            NULL
+  };
+  long ret;
+  FILE *f = fopen(path,"rb");
+  if(!f) return -1;
+
+  ret = ov_scan_callbacks((void *)f, callbacks, links, n);
+  fclose(f);
+  return ret;
 }
 
 /* seek to an offset relative to the *compressed* data. This also
@@ -1253,6 +1941,7 @@ int ov_raw_seek(OggVorbis_File *vf,ogg_int64_t pos){
   ogg_stream_reset_serialno(&vf->os,
                             vf->current_serialno); /* must set serialno */
   vorbis_synthesis_restart(&vf->vd);
+  vf->packet_blocksize=0;
 
   ret=_seek_helper(vf,pos);
   if(ret)goto seek_error;
@@ -1443,6 +2132,49 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
 
     ogg_page og;
 
+    /* start from the nearest pages on either side of the target that
+       earlier seeks and reads have seen */
+    if(vf->page_cache){
+      long i,n=(vf->page_cache_count<PAGECACHE?
+                vf->page_cache_count:PAGECACHE);
+      for(i=0;i<n;i++){
+        ogg_int64_t *e=vf->page_cache+i*3;
+        if(e[2]!=vf->serialnos[link] || e[0]<begin || e[0]>=end)continue;
+        if(e[1]<target){
+          if(e[0]>begin || e[1]>begintime){
+            begin=e[0];
+            begintime=e[1];
+          }
+        }else{
+          end=e[0];
+          endtime=e[1];
+        }
+      }
+    }
+
+    /* a hit is a bracket narrower than what the first bisection step
+       over the whole link would leave; which side of that step the
+       target falls on is judged from its place in the bracket */
+    {
+      ogg_int64_t b0=vf->dataoffsets[link],e0=vf->offsets[link+1];
+      ogg_int64_t length=vf->pcmlengths[link*2+1];
+      ogg_int64_t guess=b0,at=begin;
+
+      if(e0-b0>=CHUNKSIZE && length>0){
+        guess=b0+(ogg_int64_t)((double)(target-vf->pcmlengths[link*2])*
+                               (e0-b0)/length)-CHUNKSIZE;
+        if(guess<b0+CHUNKSIZE)guess=b0;
+      }
+      if(endtime>begintime)
+        at=begin+(ogg_int64_t)((double)(target-begintime)*(end-begin)/
+                               (endtime-begintime));
+      if((begin>b0 || end<e0) &&
+         end-begin<(at<guess?guess-b0:e0-guess))
+        vf->page_cache_hits++;
+      else
+        vf->page_cache_misses++;
+    }
+
     /* if we have only one page, there will be no bisection.  Grab the page here */
     if(begin==end){
       result=_seek_helper(vf,begin);
@@ -1507,6 +2239,7 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
           /* only consider pages with the granulepos set */
           granulepos=ogg_page_granulepos(&og);
           if(granulepos==-1)continue;
+          _page_cache_add(vf,result,&og);
 
           if(granulepos<target){
             /* this page is a successful candidate! Set state */
@@ -1517,7 +2250,7 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
 
             /* if we're before our target but within a short distance,
                don't bisect; read forward */
-            if(target-begintime>44100)break;
+            if(target-begintime>SEEKSPAN)break;
 
             bisect=begin; /* *not* begin + 1 as above */
           }else{
@@ -1580,6 +2313,7 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
 
         }else{
           vorbis_synthesis_restart(&vf->vd);
+          vf->packet_blocksize=0;
         }
 
         ogg_stream_reset_serialno(&vf->os,vf->current_serialno);
@@ -1613,6 +2347,7 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
 
       }else{
         vorbis_synthesis_restart(&vf->vd);
+        vf->packet_blocksize=0;
       }
 
       ogg_stream_reset_serialno(&vf->os,vf->current_serialno);
@@ -1672,17 +2407,18 @@ int ov_pcm_seek_page(OggVorbis_File *vf,ogg_int64_t pos){
   return (int)result;
 }
 
-/* seek to a sample offset relative to the decompressed pcm stream
-   returns zero on success, nonzero on failure */
-
-int ov_pcm_seek(OggVorbis_File *vf,ogg_int64_t pos){
-  int thisblock,lastblock=0;
-  int ret=ov_pcm_seek_page(vf,pos);
-  if(ret<0)return(ret);
-  if((ret=_make_decode_ready(vf)))return ret;
+/* brings a decoder forward to pos.  Either it was restarted at a page
+   boundary (lastblock is zero), or it has returned all its samples and
+   lastblock is the blocksize of the last packet it took in */
+static int _ov_pcm_seek_packets(OggVorbis_File *vf,ogg_int64_t pos,
+                                int lastblock){
+  int thisblock;
 
   /* discard leading packets we don't need for the lapping of the
-     position we want; don't decode them */
+     position we want; don't decode them.  A packet is needed once the
+     packet after it returns samples past pos.  That depends on the
+     next packet's blocksize; if the next packet isn't buffered yet,
+     assume it's a long block */
 
   while(1){
     ogg_packet op;
@@ -1690,23 +2426,40 @@ int ov_pcm_seek(OggVorbis_File *vf,ogg_int64_t pos){
 
     int ret=ogg_stream_packetpeek(&vf->os,&op);
     if(ret>0){
-      thisblock=vorbis_packet_blocksize(vf->vi+vf->current_link,&op);
+      vorbis_info *vi=vf->vi+vf->current_link;
+      int needed=0;
+
+      thisblock=vorbis_packet_blocksize(vi,&op);
       if(thisblock<0){
         ogg_stream_packetout(&vf->os,NULL);
         continue; /* non audio packet */
       }
       if(lastblock)vf->pcm_offset+=(lastblock+thisblock)>>2;
 
-      if(vf->pcm_offset+((thisblock+
-                          vorbis_info_blocksize(vf->vi,1))>>2)>=pos)break;
+      /* remove the packet from packet queue; its data stays put until
+         the next page is submitted */
+      ogg_stream_packetout(&vf->os,&op);
+
+      if(vf->pcm_offset+((thisblock+vorbis_info_blocksize(vi,1))>>2)>pos){
+        ogg_packet next;
+        long nextblock=-1;
+        if(ogg_stream_packetpeek(&vf->os,&next)>0)
+          nextblock=vorbis_packet_blocksize(vi,&next);
+        needed=(nextblock<0 ||
+                vf->pcm_offset+((thisblock+nextblock)>>2)>pos);
+      }
 
-      /* remove the packet from packet queue and track its granulepos */
-      ogg_stream_packetout(&vf->os,NULL);
-      vorbis_synthesis_trackonly(&vf->vb,&op);  /* set up a vb with
-                                                   only tracking, no
-                                                   pcm_decode */
+      /* decode it, or set up a vb with only tracking, no pcm_decode */
+      if(!needed || vorbis_synthesis(&vf->vb,&op))
+        vorbis_synthesis_trackonly(&vf->vb,&op);
       vorbis_synthesis_blockin(&vf->vd,&vf->vb);
 
+      /* if the decoder wasn't restarted, the first packet decoded is
+         lapped onto what the tracked ones left behind; those samples
+         all lie before pos */
+      if(needed)
+        vorbis_synthesis_read(&vf->vd,vorbis_synthesis_pcmout(&vf->vd,NULL));
+
       /* end of logical stream case is hard, especially with exact
          length positioning. */
 
@@ -1719,13 +2472,18 @@ int ov_pcm_seek(OggVorbis_File *vf,ogg_int64_t pos){
           vf->pcm_offset+=vf->pcmlengths[i*2+1];
       }
 
+      if(needed)break;
       lastblock=thisblock;
 
     }else{
       if(ret<0 && ret!=OV_HOLE)break;
 
       /* suck in a new page */
-      if(_get_next_page(vf,&og,-1)<0)break;
+      {
+        ogg_int64_t offset=_get_next_page(vf,&og,-1);
+        if(offset<0)break;
+        _page_cache_add(vf,offset,&og);
+      }
       if(ogg_page_bos(&og))_decode_clear(vf);
 
       if(vf->ready_state<STREAMSET){
@@ -1773,6 +2531,121 @@ int ov_pcm_seek(OggVorbis_File *vf,ogg_int64_t pos){
   return 0;
 }
 
+/* seek to a sample offset relative to the decompressed pcm stream
+   returns zero on success, nonzero on failure */
+
+int ov_pcm_seek(OggVorbis_File *vf,ogg_int64_t pos){
+  int ret=ov_pcm_seek_page(vf,pos);
+  if(ret<0)return(ret);
+  if((ret=_make_decode_ready(vf)))return ret;
+  return(_ov_pcm_seek_packets(vf,pos,0));
+}
+
+/* moves a decoder at pcm_offset ahead to pos in the same link by
+   reading on through the stream rather than seeking; the packets in
+   between are tracked, not decoded */
+static int _ov_pcm_skip(OggVorbis_File *vf,ogg_int64_t pos){
+  int hs=vorbis_synthesis_halfrate_p(vf->vi);
+  vorbis_info *vi=vf->vi+vf->current_link;
+
+  while(1){
+    long samples=vorbis_synthesis_pcmout(&vf->vd,NULL);
+    int ret;
+
+    /* pos is among the samples already decoded; drop those before it */
+    if(vf->pcm_offset+(samples<<hs)>pos){
+      samples=(pos-vf->pcm_offset)>>hs;
+      vorbis_synthesis_read(&vf->vd,samples);
+      vf->pcm_offset+=samples<<hs;
+      return(0);
+    }
+    vorbis_synthesis_read(&vf->vd,samples);
+    vf->pcm_offset+=samples<<hs;
+
+    /* once pos is past what the next packet returns, the packets up
+       to it need only be tracked, as after a page seek.  The decoder
+       isn't restarted; it keeps its granulepos for trimming the end
+       of the link.  Before it has seen a granulepos, pcm_offset may
+       yet be trimmed at the start of a link, so decode on until then */
+    if(vf->vd.granulepos!=-1){
+      int lastblock=vorbis_info_blocksize(vi,vf->vd.W);
+      if(vf->pcm_offset+((lastblock+vorbis_info_blocksize(vi,1))>>2)<=pos)
+        return(_ov_pcm_seek_packets(vf,pos,lastblock));
+    }
+
+    ret=_fetch_and_process_packet(vf,NULL,1,1);
+    if(ret==OV_HOLE)continue;
+    if(ret<=0)return(ret?ret:OV_EOF);
+  }
+}
+
+/* reads the PCM of a list of sample ranges, given as pairs of start
+   and end positions (ranges[i*2] up to but not including
+   ranges[i*2+1]) in order of start.  Each range is handed to the
+   callback in one or more runs, as ov_read_float() returns them.  A
+   range starting close ahead of the decoder is reached by reading on
+   through the buffered stream; a further one is seeked to, and the
+   page cache spares most of the bisection.
+   returns zero on success, nonzero on failure */
+int ov_read_ranges(OggVorbis_File *vf,const ogg_int64_t *ranges,int n,
+                   void (*callback)(int range,float **pcm,long channels,
+                                    long samples,void *param),
+                   void *param){
+  ogg_int64_t total=ov_pcm_total(vf,-1);
+  int i;
+
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  if(!vf->seekable)return(OV_ENOSEEK);
+  if(n<0 || (n>0 && !ranges) || !callback)return(OV_EINVAL);
+
+  for(i=0;i<n;i++){
+    if(ranges[i*2]<0 || ranges[i*2+1]<ranges[i*2] || ranges[i*2+1]>total)
+      return(OV_EINVAL);
+    if(i>0 && ranges[i*2]<ranges[i*2-2])return(OV_EINVAL);
+  }
+
+  for(i=0;i<n;i++){
+    ogg_int64_t pos=ranges[i*2];
+    ogg_int64_t end=ranges[i*2+1];
+    ogg_int64_t linkend=0;
+    ogg_int64_t left;
+    int link,ret;
+
+    if(pos==end)continue;
+
+    for(link=0;link<=vf->current_link;link++)
+      linkend+=vf->pcmlengths[link*2+1];
+
+    if(vf->ready_state==INITSET && pos>=vf->pcm_offset && pos<linkend &&
+       pos-vf->pcm_offset<=SEEKSPAN){
+      ret=_ov_pcm_skip(vf,pos);
+    }else{
+      ret=ov_pcm_seek_page(vf,pos);
+      if(!ret)ret=_make_decode_ready(vf);
+      if(!ret)ret=_ov_pcm_seek_packets(vf,pos,0);
+    }
+    if(ret)return(ret);
+
+    /* count the samples off rather than watch pcm_offset; the first
+       granulepos of a link may still move that */
+    left=(end-pos)>>vorbis_synthesis_halfrate_p(vf->vi);
+    while(left>0){
+      float **pcm;
+      long samples;
+      /* no more than a block's worth is ready at once anyway */
+      int want=(left>8192?8192:(int)left);
+
+      samples=ov_read_float(vf,&pcm,want,NULL);
+      if(samples==OV_HOLE)continue;
+      if(samples<=0)return(samples?samples:OV_EOF);
+
+      callback(i,pcm,vf->vi[vf->current_link].channels,samples,param);
+      left-=samples;
+    }
+  }
+  return(0);
+}
+
 /* seek to a playback time relative to the decompressed pcm stream
    returns zero on success, nonzero on failure */
 int ov_time_seek(OggVorbis_File *vf,double seconds){
@@ -1911,6 +2784,79 @@ vorbis_comment *ov_comment(OggVorbis_File *vf,int link){
   }
 }
 
+/* reads a comment left in the file by the comment limit back out of
+   the comment header of the link; the decode position is kept */
+static long _comment_reread(OggVorbis_File *vf,int link,ogg_int64_t offset,
+                            long bytes,char *buffer,long length){
+  ogg_stream_state os;
+  ogg_page og;
+  ogg_packet op;
+  ogg_int64_t pos=vf->offset;
+  int packets=0;
+  long ret;
+
+  ret=_seek_helper(vf,vf->offsets[link]);
+  if(ret)return(ret);
+  ogg_stream_init(&os,vf->serialnos[link]);
+
+  /* the comment header is the second packet of the link's stream */
+  while(1){
+    int result=ogg_stream_packetout(&os,&op);
+    if(result>0){
+      if(++packets==2)break;
+      continue;
+    }
+    if(result<0 || vf->offset>vf->dataoffsets[link] ||
+       _get_next_page(vf,&og,-1)<0){
+      ret=OV_EBADHEADER;
+      goto done;
+    }
+    ogg_stream_pagein(&os,&og);
+  }
+
+  if(op.bytes<offset+bytes){
+    ret=OV_EBADHEADER;
+    goto done;
+  }
+  memcpy(buffer,op.packet+offset,length<bytes?length:bytes);
+  ret=bytes;
+
+ done:
+  ogg_stream_clear(&os);
+  if(_seek_helper(vf,pos))return(OV_EREAD);
+  return(ret);
+}
+
+/* the whole of comment 'comment' of a link (-1 for the current one),
+   including those the comment limit left in the file.  Copies up to
+   length bytes of it to buffer and returns its full length; with no
+   buffer, only the length is returned */
+long ov_comment_fetch(OggVorbis_File *vf,int link,int comment,
+                      char *buffer,long length){
+  vorbis_comment *vc;
+  long i;
+
+  if(vf->ready_state<OPENED)return(OV_EINVAL);
+  vc=ov_comment(vf,link);
+  if(!vc || comment<0 || comment>=vc->comments)return(OV_EINVAL);
+  link=vc-vf->vc;
+
+  for(i=0;i<vf->comment_skip_count;i++){
+    ogg_int64_t *e=vf->comment_skips+i*4;
+    if(e[0]==link && e[1]==comment){
+      if(!buffer || length<=0)return(e[3]);
+      if(!vf->seekable)return(OV_ENOSEEK);
+      return(_comment_reread(vf,link,e[2],e[3],buffer,length));
+    }
+  }
+
+  if(buffer && length>0)
+    memcpy(buffer,vc->user_comments[comment],
+           length<vc->comment_lengths[comment]?
+           length:vc->comment_lengths[comment]);
+  return(vc->comment_lengths[comment]);
+}
+
 static int host_is_big_endian() {
   ogg_int32_t pattern = 0xfeedface; /* deadbeef */
   unsigned char *bytewise = (unsigned char *)&pattern;
@@ -2142,41 +3088,136 @@ long ov_read_float(OggVorbis_File *vf,float ***pcm_channels,int length,
   }
 }
 
-extern const float *vorbis_window(vorbis_dsp_state *v,int W);
+/* reads the next audio packet as it is in the stream, for remuxing;
+   nothing is decoded and no synthesis state is set up.
 
-static void _ov_splice(float **pcm,float **lappcm,
-                       int n1, int n2,
-                       int ch1, int ch2,
-                       const float *w1, const float *w2){
-  int i,j;
-  const float *w=w1;
-  int n=n1;
+   input values: op) filled in with the packet.  Its data belongs to
+                 the stream state and stays good until the next read
+                 or seek.  granulepos is set on every packet, to the
+                 granule position it ends at as a page would carry it
+
+   return values: <0) error/hole in data (OV_HOLE), partial open (OV_EINVAL)
+                   0) EOF
+                   1) got a packet
+
+          *blocksize) set to the blocksize of the packet
+            *samples) set to the number of samples the packet completes;
+                      the first packet after a seek or at the start of
+                      a link only primes the overlap and completes none
+          *bitstream) set to the logical bitstream number */
 
-  if(n1>n2){
-    n=n2;
-    w=w2;
+int ov_read_packet(OggVorbis_File *vf,ogg_packet *op,long *blocksize,
+                   long *samples,int *bitstream){
+
+  if(vf->ready_state<OPENED || !op)return(OV_EINVAL);
+
+  /* after decoding, carry on from the last packet the decoder took
+     in; its samples end after those it still holds.  The decoder
+     doesn't see the packets read here, so restart it */
+  if(vf->ready_state==INITSET){
+    if(vf->vd.pcm_returned!=-1){
+      int hs=vorbis_synthesis_halfrate_p(vf->vi);
+      vorbis_info *vi=vf->vi+(vf->seekable?vf->current_link:0);
+      vf->packet_blocksize=vorbis_info_blocksize(vi,vf->vd.W);
+      if(vf->pcm_offset!=-1)
+        vf->pcm_offset+=vorbis_synthesis_pcmout(&vf->vd,NULL)<<hs;
+    }
+    vorbis_synthesis_restart(&vf->vd);
   }
 
-  /* splice */
-  for(j=0;j<ch1 && j<ch2;j++){
-    float *s=lappcm[j];
-    float *d=pcm[j];
+  while(1){
+    if(vf->ready_state>=STREAMSET){
+      int link=(vf->seekable?vf->current_link:0);
+      vorbis_info *vi=vf->vi+link;
+
+      while(1){
+        int result=ogg_stream_packetout(&vf->os,op);
+        long thisblock,n;
+        int i;
+
+        if(result==-1)return(OV_HOLE); /* hole in the data. */
+        if(result==0)break;
+
+        /* the header packets aren't audio; skip them, as synthesis
+           would reject them */
+        thisblock=vorbis_packet_blocksize(vi,op);
+        if(thisblock<0)continue;
+
+        n=(vf->packet_blocksize?(vf->packet_blocksize+thisblock)>>2:0);
+        vf->packet_blocksize=thisblock;
+        if(vf->pcm_offset!=-1)vf->pcm_offset+=n;
+
+        if(op->granulepos!=-1){
+          /* always believe the stream markers; the one ending a link
+             may cut its last packet short */
+          ogg_int64_t pos=op->granulepos;
+          if(vf->seekable){
+            pos-=vf->pcmlengths[link*2];
+            if(pos<0)pos=0;
+            for(i=0;i<link;i++)
+              pos+=vf->pcmlengths[i*2+1];
+          }
+          if(op->e_o_s && vf->pcm_offset!=-1 && pos<vf->pcm_offset){
+            n-=vf->pcm_offset-pos;
+            if(n<0)n=0;
+          }
+          vf->pcm_offset=pos;
+        }else if(vf->pcm_offset!=-1){
+          op->granulepos=vf->pcm_offset;
+          if(vf->seekable){
+            for(i=0;i<link;i++)
+              op->granulepos-=vf->pcmlengths[i*2+1];
+            op->granulepos+=vf->pcmlengths[link*2];
+          }
+        }
+
+        vf->bittrack+=op->bytes*8;
+        vf->samptrack+=n;
+        if(blocksize)*blocksize=thisblock;
+        if(samples)*samples=n;
+        if(bitstream)*bitstream=vf->current_link;
+        return(1);
+      }
+    }
+
+    /* suck in another page */
+    {
+      int link=vf->current_link;
+      int ret=_fetch_page(vf,1,1);
+      if(ret==OV_EOF)return(0);
+      if(ret<0)return(ret);
 
-    for(i=0;i<n;i++){
+      /* streaming, each link counts its granule positions from its
+         own start */
+      if(!vf->seekable && vf->current_link!=link)vf->pcm_offset=0;
+    }
+  }
+}
+
+extern const float *vorbis_window(vorbis_dsp_state *v,int W);
+
+/* laps count samples of lapping data s, taken from offset off of the
+   lap, into the head of d; n samples of d are lapped in all, with
+   window w.  Without s, d is windowed from zero. */
+static void _ov_splice(float *d,const float *s,int off,int count,int n,
+                       const float *w){
+  int i;
+  if(count>n-off)count=n-off;
+  d+=off;
+  w+=off;
+
+  if(s){
+    for(i=0;i<count;i++){
       float wd=w[i]*w[i];
       float ws=1.-wd;
       d[i]=d[i]*wd + s[i]*ws;
     }
-  }
-  /* window from zero */
-  for(;j<ch2;j++){
-    float *d=pcm[j];
-    for(i=0;i<n;i++){
+  }else{
+    for(i=0;i<count;i++){
       float wd=w[i]*w[i];
       d[i]=d[i]*wd;
     }
   }
-
 }
 
 /* make sure vf is INITSET */
@@ -2210,55 +3251,49 @@ static int _ov_initprime(OggVorbis_File *vf){
   return 0;
 }
 
-/* grab enough data for lapping from vf; this may be in the form of
+/* takes the next run of up to lapsize samples of lapping data from vf,
+   leaving *pcm pointing at it in the decoder's buffer; this may be
    unreturned, already-decoded pcm, remaining PCM we will need to
-   decode, or synthetic postextrapolation from last packets. */
-static void _ov_getlap(OggVorbis_File *vf,vorbis_info *vi,vorbis_dsp_state *vd,
-                       float **lappcm,int lapsize){
-  int lapcount=0,i;
-  float **pcm;
+   decode, or synthetic postextrapolation from last packets.  *lapout
+   starts out zero and is set once the latter has been taken.  Returns
+   zero once there is no more. */
+static int _ov_getlap(OggVorbis_File *vf,float ***pcm,int lapsize,
+                      int *lapout){
+  int samples;
+
+  if(*lapout)return(0);
 
   /* try first to decode the lapping data */
-  while(lapcount<lapsize){
-    int samples=vorbis_synthesis_pcmout(vd,&pcm);
+  while(1){
+    samples=vorbis_synthesis_pcmout(&vf->vd,pcm);
     if(samples){
-      if(samples>lapsize-lapcount)samples=lapsize-lapcount;
-      for(i=0;i<vi->channels;i++)
-        memcpy(lappcm[i]+lapcount,pcm[i],sizeof(**pcm)*samples);
-      lapcount+=samples;
-      vorbis_synthesis_read(vd,samples);
-    }else{
-    /* suck in another packet */
-      int ret=_fetch_and_process_packet(vf,NULL,1,0); /* do *not* span */
-      if(ret==OV_EOF)break;
-    }
-  }
-  if(lapcount<lapsize){
-    /* failed to get lapping data from normal decode; pry it from the
-       postextrapolation buffering, or the second half of the MDCT
-       from the last packet */
-    int samples=vorbis_synthesis_lapout(&vf->vd,&pcm);
-    if(samples==0){
-      for(i=0;i<vi->channels;i++)
-        memset(lappcm[i]+lapcount,0,sizeof(**pcm)*lapsize-lapcount);
-      lapcount=lapsize;
-    }else{
-      if(samples>lapsize-lapcount)samples=lapsize-lapcount;
-      for(i=0;i<vi->channels;i++)
-        memcpy(lappcm[i]+lapcount,pcm[i],sizeof(**pcm)*samples);
-      lapcount+=samples;
+      if(samples>lapsize)samples=lapsize;
+      vorbis_synthesis_read(&vf->vd,samples);
+      return(samples);
     }
+    /* suck in another packet */
+    if(_fetch_and_process_packet(vf,NULL,1,0)==OV_EOF)break; /* do *not* span */
   }
+
+  /* failed to get lapping data from normal decode; pry it from the
+     postextrapolation buffering, or the second half of the MDCT
+     from the last packet */
+  *lapout=1;
+  samples=vorbis_synthesis_lapout(&vf->vd,pcm);
+  return(samples>lapsize?lapsize:samples);
 }
 
 /* this sets up crosslapping of a sample by using trailing data from
-   sample 1 and lapping it into the windowing buffer of sample 2 */
+   sample 1 and lapping it into the windowing buffer of sample 2.  The
+   lapping data is spliced in straight from the decode buffer of
+   sample 1, as it is decoded. */
 int ov_crosslap(OggVorbis_File *vf1, OggVorbis_File *vf2){
   vorbis_info *vi1,*vi2;
   float **lappcm;
   float **pcm;
-  const float *w1,*w2;
-  int n1,n2,i,ret,hs1,hs2;
+  const float *w;
+  int n1,n2,n,ch,i,ret,hs1,hs2;
+  int lapcount=0,lapout=0;
 
   if(vf1==vf2)return(0); /* degenerate case */
   if(vf1->ready_state<OPENED)return(OV_EINVAL);
@@ -2278,20 +3313,13 @@ int ov_crosslap(OggVorbis_File *vf1, OggVorbis_File *vf2){
   hs1=ov_halfrate_p(vf1);
   hs2=ov_halfrate_p(vf2);
 
-  lappcm=alloca(sizeof(*lappcm)*vi1->channels);
   n1=vorbis_info_blocksize(vi1,0)>>(1+hs1);
   n2=vorbis_info_blocksize(vi2,0)>>(1+hs2);
-  w1=vorbis_window(&vf1->vd,0);
-  w2=vorbis_window(&vf2->vd,0);
-
-  for(i=0;i<vi1->channels;i++)
-    lappcm[i]=alloca(sizeof(**lappcm)*n1);
-
-  _ov_getlap(vf1,vi1,&vf1->vd,lappcm,n1);
+  n=(n1>n2?n2:n1);
+  w=(n1>n2?vorbis_window(&vf2->vd,0):vorbis_window(&vf1->vd,0));
+  ch=(vi1->channels>vi2->channels?vi2->channels:vi1->channels);
 
-  /* have a lapping buffer from vf1; now to splice it into the lapping
-     buffer of vf2 */
-  /* consolidate and expose the buffer. */
+  /* consolidate and expose the buffer of vf2. */
   vorbis_synthesis_lapout(&vf2->vd,&pcm);
 
 #if 0
@@ -2299,21 +3327,32 @@ int ov_crosslap(OggVorbis_File *vf1, OggVorbis_File *vf2){
   _analysis_output_always("pcmR",0,pcm[1],n1*2,0,0,0);
 #endif
 
-  /* splice */
-  _ov_splice(pcm,lappcm,n1,n2,vi1->channels,vi2->channels,w1,w2);
+  /* splice; vf1 gives up a full short block's lap either way */
+  while(lapcount<n1){
+    int samples=_ov_getlap(vf1,&lappcm,n1-lapcount,&lapout);
+    if(!samples)break;
+    for(i=0;i<ch;i++)
+      _ov_splice(pcm[i],lappcm[i],lapcount,samples,n,w);
+    lapcount+=samples;
+  }
+  /* window from zero what vf1 has no lapping data for */
+  for(i=0;i<vi2->channels;i++)
+    if(i<ch)
+      _ov_splice(pcm[i],NULL,lapcount,n,n,w);
+    else
+      _ov_splice(pcm[i],NULL,0,n,n,w);
 
   /* done */
   return(0);
 }
 
-static int _ov_64_seek_lap(OggVorbis_File *vf,ogg_int64_t pos,
-                           int (*localseek)(OggVorbis_File *,ogg_int64_t)){
+/* takes the lapping data of vf ahead of a lap seek, into storage kept
+   in vf from one lap seek to the next */
+static int _ov_seek_lap_save(OggVorbis_File *vf,int *ch1,int *n1,
+                             const float **w1){
   vorbis_info *vi;
   float **lappcm;
-  float **pcm;
-  const float *w1,*w2;
-  int n1,n2,ch1,ch2,hs;
-  int i,ret;
+  int i,ret,hs,lapcount=0,lapout=0;
 
   if(vf->ready_state<OPENED)return(OV_EINVAL);
   ret=_ov_initset(vf);
@@ -2321,26 +3360,50 @@ static int _ov_64_seek_lap(OggVorbis_File *vf,ogg_int64_t pos,
   vi=ov_info(vf,-1);
   hs=ov_halfrate_p(vf);
 
-  ch1=vi->channels;
-  n1=vorbis_info_blocksize(vi,0)>>(1+hs);
-  w1=vorbis_window(&vf->vd,0);  /* window arrays from libvorbis are
-                                   persistent; even if the decode state
-                                   from this link gets dumped, this
-                                   window array continues to exist */
+  *ch1=vi->channels;
+  *n1=vorbis_info_blocksize(vi,0)>>(1+hs);
+  *w1=vorbis_window(&vf->vd,0);  /* window arrays from libvorbis are
+                                    persistent; even if the decode state
+                                    from this link gets dumped, this
+                                    window array continues to exist */
+
+  if(vf->lap_size<*ch1 * *n1){
+    float *lap=_ogg_realloc(vf->lap_pcm,*ch1 * *n1 * sizeof(*lap));
+    if(!lap)return(OV_EFAULT);
+    vf->lap_pcm=lap;
+    vf->lap_size=*ch1 * *n1;
+  }
 
-  lappcm=alloca(sizeof(*lappcm)*ch1);
-  for(i=0;i<ch1;i++)
-    lappcm[i]=alloca(sizeof(**lappcm)*n1);
-  _ov_getlap(vf,vi,&vf->vd,lappcm,n1);
+  while(lapcount<*n1){
+    int samples=_ov_getlap(vf,&lappcm,*n1-lapcount,&lapout);
+    if(!samples)break;
+    for(i=0;i<*ch1;i++)
+      memcpy(vf->lap_pcm+i * *n1+lapcount,lappcm[i],
+             samples*sizeof(*vf->lap_pcm));
+    lapcount+=samples;
+  }
+  for(i=0;i<*ch1;i++)
+    memset(vf->lap_pcm+i * *n1+lapcount,0,
+           (*n1-lapcount)*sizeof(*vf->lap_pcm));
+
+  return(0);
+}
+
+/* primes vf after a lap seek and splices in the lapping data saved by
+   _ov_seek_lap_save() */
+static int _ov_seek_lap_splice(OggVorbis_File *vf,int ch1,int n1,
+                               const float *w1){
+  vorbis_info *vi;
+  float **pcm;
+  const float *w2;
+  int n2,ch2,i,ret,hs;
 
-  /* have lapping data; seek and prime the buffer */
-  ret=localseek(vf,pos);
-  if(ret)return ret;
   ret=_ov_initprime(vf);
   if(ret)return(ret);
 
  /* Guard against cross-link changes; they're perfectly legal */
   vi=ov_info(vf,-1);
+  hs=ov_halfrate_p(vf);
   ch2=vi->channels;
   n2=vorbis_info_blocksize(vi,0)>>(1+hs);
   w2=vorbis_window(&vf->vd,0);
@@ -2349,12 +3412,28 @@ static int _ov_64_seek_lap(OggVorbis_File *vf,ogg_int64_t pos,
   vorbis_synthesis_lapout(&vf->vd,&pcm);
 
   /* splice */
-  _ov_splice(pcm,lappcm,n1,n2,ch1,ch2,w1,w2);
+  for(i=0;i<ch2;i++)
+    _ov_splice(pcm[i],i<ch1?vf->lap_pcm+i*n1:NULL,0,n1,
+               (n1>n2?n2:n1),(n1>n2?w2:w1));
 
   /* done */
   return(0);
 }
 
+static int _ov_64_seek_lap(OggVorbis_File *vf,ogg_int64_t pos,
+                           int (*localseek)(OggVorbis_File *,ogg_int64_t)){
+  const float *w1;
+  int n1,ch1,ret;
+
+  ret=_ov_seek_lap_save(vf,&ch1,&n1,&w1);
+  if(ret)return(ret);
+
+  /* have lapping data; seek and prime the buffer */
+  ret=localseek(vf,pos);
+  if(ret)return ret;
+  return(_ov_seek_lap_splice(vf,ch1,n1,w1));
+}
+
 int ov_raw_seek_lap(OggVorbis_File *vf,ogg_int64_t pos){
   return _ov_64_seek_lap(vf,pos,ov_raw_seek);
 }
@@ -2369,51 +3448,16 @@ int ov_pcm_seek_page_lap(OggVorbis_File *vf,ogg_int64_t pos){
 
 static int _ov_d_seek_lap(OggVorbis_File *vf,double pos,
                            int (*localseek)(OggVorbis_File *,double)){
-  vorbis_info *vi;
-  float **lappcm;
-  float **pcm;
-  const float *w1,*w2;
-  int n1,n2,ch1,ch2,hs;
-  int i,ret;
+  const float *w1;
+  int n1,ch1,ret;
 
-  if(vf->ready_state<OPENED)return(OV_EINVAL);
-  ret=_ov_initset(vf);
+  ret=_ov_seek_lap_save(vf,&ch1,&n1,&w1);
   if(ret)return(ret);
-  vi=ov_info(vf,-1);
-  hs=ov_halfrate_p(vf);
-
-  ch1=vi->channels;
-  n1=vorbis_info_blocksize(vi,0)>>(1+hs);
-  w1=vorbis_window(&vf->vd,0);  /* window arrays from libvorbis are
-                                   persistent; even if the decode state
-                                   from this link gets dumped, this
-                                   window array continues to exist */
-
-  lappcm=alloca(sizeof(*lappcm)*ch1);
-  for(i=0;i<ch1;i++)
-    lappcm[i]=alloca(sizeof(**lappcm)*n1);
-  _ov_getlap(vf,vi,&vf->vd,lappcm,n1);
 
   /* have lapping data; seek and prime the buffer */
   ret=localseek(vf,pos);
   if(ret)return ret;
-  ret=_ov_initprime(vf);
-  if(ret)return(ret);
-
- /* Guard against cross-link changes; they're perfectly legal */
-  vi=ov_info(vf,-1);
-  ch2=vi->channels;
-  n2=vorbis_info_blocksize(vi,0)>>(1+hs);
-  w2=vorbis_window(&vf->vd,0);
-
-  /* consolidate and expose the buffer. */
-  vorbis_synthesis_lapout(&vf->vd,&pcm);
-
-  /* splice */
-  _ov_splice(pcm,lappcm,n1,n2,ch1,ch2,w1,w2);
-
-  /* done */
-  return(0);
+  return(_ov_seek_lap_splice(vf,ch1,n1,w1));
 }
 
 int ov_time_seek_lap(OggVorbis_File *vf,double pos){
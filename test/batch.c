@@ -0,0 +1,243 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: batch decode test; vorbis_synthesis_batch() matches the
+           per-packet decode loop
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* A stream switching between short and long blocks is decoded packet
+   by packet (synthesis/blockin/pcmout/read) and with
+   vorbis_synthesis_batch() into output buffers of awkward sizes.  The
+   two must give the same samples, bit for bit.  Output space too
+   small for a block must be refused rather than loop without
+   progress. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vorbis/codec.h>
+#include <vorbis/vorbisenc.h>
+
+#define RATE     44100
+#define CHANNELS 2
+#define SAMPLES  (RATE*4)
+
+typedef struct {
+  ogg_packet *packets;
+  long        count;
+  long        storage;
+} packet_list;
+
+static void add_packet(packet_list *l,ogg_packet *op){
+  ogg_packet *p;
+  if(l->count>=l->storage){
+    l->storage=l->storage*2+64;
+    l->packets=realloc(l->packets,l->storage*sizeof(*l->packets));
+  }
+  p=l->packets+l->count++;
+  *p=*op;
+  p->packet=malloc(op->bytes);
+  memcpy(p->packet,op->packet,op->bytes);
+}
+
+static void clear_packets(packet_list *l){
+  long i;
+  for(i=0;i<l->count;i++)free(l->packets[i].packet);
+  free(l->packets);
+  memset(l,0,sizeof(*l));
+}
+
+/* tones with noise bursts, for a mix of short and long blocks */
+static void encode(packet_list *out){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op,h[3];
+  unsigned long lcg=1;
+  long pos=0;
+  int i,ended=0;
+
+  vorbis_info_init(&vi);
+  vorbis_encode_init_vbr(&vi,CHANNELS,RATE,.4f);
+  vorbis_comment_init(&vc);
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  vorbis_analysis_headerout(&vd,&vc,h,h+1,h+2);
+  for(i=0;i<3;i++)add_packet(out,h+i);
+
+  while(!ended){
+    if(pos<SAMPLES){
+      float **buffer=vorbis_analysis_buffer(&vd,1024);
+      long j,n=SAMPLES-pos;
+      if(n>1024)n=1024;
+      for(j=0;j<n;j++){
+        double t=(double)(pos+j)/RATE;
+        double burst=fmod(t+.1,.3)<.02?.5:0.;
+        double noise;
+        lcg=lcg*1664525UL+1013904223UL;
+        noise=((lcg>>8)&0xffff)/32768.-1.;
+        buffer[0][j]=.3*sin(2.*M_PI*440.*t)+burst*noise;
+        buffer[1][j]=.3*sin(2.*M_PI*660.*t)+burst*noise*.7;
+      }
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else{
+      vorbis_analysis_wrote(&vd,0);
+      ended=1;
+    }
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op))
+        add_packet(out,&op);
+    }
+  }
+
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+}
+
+static int setup(packet_list *l,vorbis_info *vi,vorbis_comment *vc,
+                 vorbis_dsp_state *vd,vorbis_block *vb){
+  int i;
+  vorbis_info_init(vi);
+  vorbis_comment_init(vc);
+  for(i=0;i<3;i++)
+    if(vorbis_synthesis_headerin(vi,vc,l->packets+i))return -1;
+  vorbis_synthesis_init(vd,vi);
+  vorbis_block_init(vd,vb);
+  return 0;
+}
+
+static void teardown(vorbis_info *vi,vorbis_comment *vc,
+                     vorbis_dsp_state *vd,vorbis_block *vb){
+  vorbis_block_clear(vb);
+  vorbis_dsp_clear(vd);
+  vorbis_comment_clear(vc);
+  vorbis_info_clear(vi);
+}
+
+static long decode_loop(packet_list *l,float **out,long max){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  long i,got=0;
+  int j;
+
+  if(setup(l,&vi,&vc,&vd,&vb))return -1;
+  for(i=3;i<l->count;i++){
+    float **pcm;
+    long n;
+    if(vorbis_synthesis(&vb,l->packets+i)==0)
+      vorbis_synthesis_blockin(&vd,&vb);
+    while((n=vorbis_synthesis_pcmout(&vd,&pcm))>0){
+      if(got+n>max)n=max-got;
+      for(j=0;j<CHANNELS;j++)
+        memcpy(out[j]+got,pcm[j],n*sizeof(**pcm));
+      got+=n;
+      vorbis_synthesis_read(&vd,n);
+      if(got==max)break;
+    }
+  }
+  teardown(&vi,&vc,&vd,&vb);
+  return got;
+}
+
+/* batch decode, cycling through output space sizes from exactly one
+   long block up */
+static long decode_batch(packet_list *l,float **out,long max,int *refused){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  long got=0,i=3;
+  int maxblock,call=0,j;
+
+  if(setup(l,&vi,&vc,&vd,&vb))return -1;
+  maxblock=vorbis_info_blocksize(&vi,1)/2;
+
+  *refused=vorbis_synthesis_batch(&vd,&vb,l->packets+i,l->count-i,
+                                  out,maxblock-1,NULL)==OV_EINVAL;
+
+  while(i<l->count || vorbis_synthesis_pcmout(&vd,NULL)>0){
+    static const int extra[]={0,1,37,700,3000};
+    float *pcm[CHANNELS];
+    long space=maxblock+extra[call++%5];
+    int consumed,ret;
+
+    if(space>max-got)space=max-got;
+    if(space<maxblock)break;
+    for(j=0;j<CHANNELS;j++)pcm[j]=out[j]+got;
+    ret=vorbis_synthesis_batch(&vd,&vb,l->packets+i,l->count-i,
+                               pcm,space,&consumed);
+    if(ret<0 || (ret==0 && consumed==0)){
+      got=-1;
+      break;
+    }
+    got+=ret;
+    i+=consumed;
+  }
+  teardown(&vi,&vc,&vd,&vb);
+  return got;
+}
+
+int main(void){
+  float *loop[CHANNELS],*batch[CHANNELS];
+  packet_list l;
+  long n,m,max=SAMPLES+8192;
+  int j,refused=0,errors=0;
+
+  memset(&l,0,sizeof(l));
+  encode(&l);
+  for(j=0;j<CHANNELS;j++){
+    loop[j]=calloc(max,sizeof(*loop[j]));
+    batch[j]=calloc(max,sizeof(*batch[j]));
+  }
+
+  n=decode_loop(&l,loop,max);
+  m=decode_batch(&l,batch,max,&refused);
+  printf("    %ld packets          : %ld samples per packet, %ld batched\n",
+         l.count,n,m);
+
+  if(!refused){
+    printf("Error : output space below one block not refused\n");
+    errors++;
+  }
+  if(n<SAMPLES || m!=n){
+    printf("Error : batch decoded %ld samples, per packet %ld\n",m,n);
+    errors++;
+  }else
+    for(j=0;j<CHANNELS;j++)
+      if(memcmp(loop[j],batch[j],n*sizeof(**loop))){
+        printf("Error : batch output differs in channel %d\n",j);
+        errors++;
+      }
+
+  clear_packets(&l);
+  for(j=0;j<CHANNELS;j++){
+    free(loop[j]);
+    free(batch[j]);
+  }
+
+  if(errors)
+    exit(1);
+  puts("    ok");
+  return 0;
+}
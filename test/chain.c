@@ -0,0 +1,532 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: chained file test; the vorbisfile read paths agree with
+           a linear decode
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* A chain of eight links at mixed rates and channel counts, with runs
+   of links sharing a setup, is encoded to memory and decoded straight
+   through with ov_read_float().  Everything else must give the same
+   samples, bit for bit, or the same lengths:
+
+   - random ov_pcm_seek()s followed by a short read, then the same
+     again with ov_link_cache() keeping a single link setup unpacked;
+   - ov_read_ranges() over sorted ranges, some crossing links;
+   - the sample counts of ov_read_packet(), summed per link, against
+     ov_pcm_total();
+   - the lengths ov_scan_callbacks() finds;
+   - an unseekable read of the whole chain, which keeps the decoder
+     across links that share a setup.
+
+   Each link also carries a comment longer than the limit given to
+   ov_open_callbacks_limit(); ov_comment_fetch() must read it back in
+   full from a seekable file, and refuse with OV_ENOSEEK on an
+   unseekable one. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vorbis/codec.h>
+#include <vorbis/vorbisenc.h>
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#include <vorbis/vorbisfile.h>
+
+#define LINKS  8
+#define SEEKS  3000
+#define RANGES 200
+#define READ   300 /* samples compared after each seek */
+#define LIMIT  1024 /* comment limit; each link's long comment is over */
+
+typedef struct {
+  long  rate;
+  int   channels;
+  float quality;
+  long  samples;
+} link_setup;
+
+/* links 2-4 and 6-7 share a setup */
+static const link_setup setups[LINKS]={
+  {44100,2,.4f,30011},
+  {22050,1,.1f,17003},
+  {48000,2,.3f,24001},
+  {48000,2,.3f,19997},
+  {48000,2,.3f,28813},
+  {32000,1,.6f,16411},
+  {44100,2,.5f,22051},
+  {44100,2,.5f,9001}
+};
+
+/* an Ogg stream in memory */
+typedef struct {
+  unsigned char *data;
+  long bytes;
+  long storage;
+  long pos;
+} stream;
+
+static void append(stream *s,const unsigned char *p,long n){
+  if(s->bytes+n>s->storage){
+    s->storage=(s->bytes+n)*2;
+    s->data=realloc(s->data,s->storage);
+  }
+  memcpy(s->data+s->bytes,p,n);
+  s->bytes+=n;
+}
+
+static size_t read_func(void *ptr,size_t size,size_t nmemb,void *datasource){
+  stream *s=datasource;
+  long n=size*nmemb;
+  if(n>s->bytes-s->pos)n=s->bytes-s->pos;
+  memcpy(ptr,s->data+s->pos,n);
+  s->pos+=n;
+  return n/size;
+}
+
+static int seek_func(void *datasource,ogg_int64_t offset,int whence){
+  stream *s=datasource;
+  if(whence==SEEK_CUR)offset+=s->pos;
+  if(whence==SEEK_END)offset+=s->bytes;
+  if(offset<0 || offset>s->bytes)return -1;
+  s->pos=offset;
+  return 0;
+}
+
+static long tell_func(void *datasource){
+  return ((stream *)datasource)->pos;
+}
+
+static void write_pages(ogg_stream_state *os,stream *s,int flush){
+  ogg_page og;
+  while(flush?ogg_stream_flush(os,&og):ogg_stream_pageout(os,&og)){
+    append(s,og.header,og.header_len);
+    append(s,og.body,og.body_len);
+  }
+}
+
+/* the long comment of a link, zero terminated; returns its length */
+static long long_comment(int link,char *buffer){
+  long n=LIMIT+1000*link+37,i;
+  strcpy(buffer,"PICTURE=");
+  for(i=8;i<n;i++)buffer[i]='a'+(i*7+link)%26;
+  buffer[n]=0;
+  return n;
+}
+
+/* a tone that moves from link to link with noise bursts, so that
+   blocks switch between short and long */
+static void encode_link(stream *s,int link){
+  const link_setup *ls=setups+link;
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_stream_state os;
+  ogg_packet       op,h[3];
+  unsigned long lcg=link+1;
+  long pos=0;
+  int i,ended=0;
+  char comment[LIMIT+1000*LINKS+64];
+
+  vorbis_info_init(&vi);
+  vorbis_encode_init_vbr(&vi,ls->channels,ls->rate,ls->quality);
+  vorbis_comment_init(&vc);
+  vorbis_comment_add_tag(&vc,"TITLE","chain test");
+  long_comment(link,comment);
+  vorbis_comment_add(&vc,comment);
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  ogg_stream_init(&os,1000+link);
+  vorbis_analysis_headerout(&vd,&vc,h,h+1,h+2);
+  for(i=0;i<3;i++)ogg_stream_packetin(&os,h+i);
+  write_pages(&os,s,1);
+
+  while(!ended){
+    if(pos<ls->samples){
+      float **buffer=vorbis_analysis_buffer(&vd,1024);
+      long j,n=ls->samples-pos;
+      if(n>1024)n=1024;
+      for(j=0;j<n;j++){
+        double t=(double)(pos+j)/ls->rate;
+        double burst=fmod(t+.05*link,.25)<.02?.4:0.;
+        double noise;
+        lcg=lcg*1664525UL+1013904223UL;
+        noise=((lcg>>8)&0xffff)/32768.-1.;
+        for(i=0;i<ls->channels;i++)
+          buffer[i][j]=.3*sin(2.*M_PI*(220.*(link+1)+110.*i)*t)+
+            burst*noise;
+      }
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else{
+      vorbis_analysis_wrote(&vd,0);
+      ended=1;
+    }
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        ogg_stream_packetin(&os,&op);
+        write_pages(&os,s,0);
+      }
+    }
+  }
+  write_pages(&os,s,1);
+
+  ogg_stream_clear(&os);
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+}
+
+/* the linear decode: each link's samples, channel by channel */
+typedef struct {
+  float      *pcm[LINKS][2];
+  long        length[LINKS];
+  ogg_int64_t start[LINKS+1]; /* of each link in the whole chain */
+} decode;
+
+static int open_seekable(stream *s,OggVorbis_File *vf){
+  ov_callbacks callbacks={read_func,seek_func,NULL,tell_func};
+  s->pos=0;
+  return ov_open_callbacks(s,vf,NULL,0,callbacks);
+}
+
+static int linear(stream *s,decode *d){
+  OggVorbis_File vf;
+  int i,j;
+
+  memset(d,0,sizeof(*d));
+  if(open_seekable(s,&vf))return -1;
+  if(ov_streams(&vf)!=LINKS){
+    ov_clear(&vf);
+    return -1;
+  }
+  for(i=0;i<LINKS;i++){
+    for(j=0;j<setups[i].channels;j++)
+      d->pcm[i][j]=malloc(ov_pcm_total(&vf,i)*sizeof(float));
+    d->start[i+1]=d->start[i]+ov_pcm_total(&vf,i);
+  }
+
+  for(;;){
+    float **pcm;
+    int link;
+    long n=ov_read_float(&vf,&pcm,1024,&link);
+    if(n==0)break;
+    if(n<0 || link<0 || link>=LINKS ||
+       d->length[link]+n>ov_pcm_total(&vf,link)){
+      ov_clear(&vf);
+      return -1;
+    }
+    for(j=0;j<setups[link].channels;j++)
+      memcpy(d->pcm[link][j]+d->length[link],pcm[j],n*sizeof(**pcm));
+    d->length[link]+=n;
+  }
+  ov_clear(&vf);
+  return 0;
+}
+
+static int link_of(decode *d,ogg_int64_t pos){
+  int i;
+  for(i=0;i<LINKS-1 && pos>=d->start[i+1];i++);
+  return i;
+}
+
+/* do n samples at chain position pos match the linear decode? */
+static int matches(decode *d,ogg_int64_t pos,float **pcm,long channels,
+                   long n){
+  int link=link_of(d,pos),j;
+  long off=pos-d->start[link];
+  if(channels!=setups[link].channels || off+n>d->length[link])return 0;
+  for(j=0;j<channels;j++)
+    if(memcmp(d->pcm[link][j]+off,pcm[j],n*sizeof(**pcm)))return 0;
+  return 1;
+}
+
+/* link_cache is passed to ov_link_cache(), unless zero */
+static int seeks(stream *s,decode *d,int link_cache){
+  OggVorbis_File vf;
+  ogg_int64_t total=d->start[LINKS];
+  unsigned long lcg=12345;
+  int i,j,bad=0;
+
+  if(open_seekable(s,&vf))return SEEKS;
+  if(link_cache && ov_link_cache(&vf,link_cache)){
+    ov_clear(&vf);
+    return SEEKS;
+  }
+  for(i=0;i<SEEKS;i++){
+    ogg_int64_t pos,want;
+    int resident=0;
+    lcg=lcg*1664525UL+1013904223UL;
+    pos=(ogg_int64_t)((lcg>>8)%(total*16))/16;
+    want=READ;
+    if(ov_pcm_seek(&vf,pos)){
+      bad++;
+      continue;
+    }
+    while(want>0){
+      float **pcm;
+      int link;
+      long n=ov_read_float(&vf,&pcm,want,&link);
+      if(n<=0)break;
+      if(ov_pcm_tell(&vf)!=pos+n || link!=link_of(d,pos) ||
+         !matches(d,pos,pcm,ov_info(&vf,-1)->channels,n)){
+        bad++;
+        break;
+      }
+      pos+=n;
+      want-=n;
+    }
+
+    /* besides the first link's, no more setups than the cache holds */
+    for(j=1;j<LINKS;j++)
+      if(vf.link_used[j])resident++;
+    if(link_cache && resident>link_cache)bad++;
+  }
+  ov_clear(&vf);
+  return bad;
+}
+
+typedef struct {
+  decode      *d;
+  ogg_int64_t *ranges;
+  ogg_int64_t  pos;    /* in the range being handed over */
+  int          range;
+  int          bad;
+} range_check;
+
+static void range_callback(int range,float **pcm,long channels,long samples,
+                           void *param){
+  range_check *rc=param;
+  if(range!=rc->range){
+    if(rc->range>=0 && rc->pos!=rc->ranges[rc->range*2+1])rc->bad++;
+    rc->range=range;
+    rc->pos=rc->ranges[range*2];
+  }
+  if(!matches(rc->d,rc->pos,pcm,channels,samples))rc->bad++;
+  rc->pos+=samples;
+}
+
+static int ranges(stream *s,decode *d){
+  OggVorbis_File vf;
+  ogg_int64_t r[RANGES*2],total=d->start[LINKS],pos=0;
+  unsigned long lcg=777;
+  range_check rc;
+  int i;
+
+  /* mostly short hops, with the odd range running over a link end */
+  for(i=0;i<RANGES;i++){
+    long len;
+    lcg=lcg*1664525UL+1013904223UL;
+    pos+=(lcg>>8)%(total/RANGES);
+    lcg=lcg*1664525UL+1013904223UL;
+    len=1+(lcg>>8)%(i%7?2000:20000);
+    if(pos+len>total)len=total-pos;
+    if(len<1){
+      pos=total-1;
+      len=1;
+    }
+    r[i*2]=pos;
+    r[i*2+1]=pos+len;
+  }
+
+  memset(&rc,0,sizeof(rc));
+  rc.d=d;
+  rc.ranges=r;
+  rc.range=-1;
+  if(open_seekable(s,&vf))return 1;
+  if(ov_read_ranges(&vf,r,RANGES,range_callback,&rc))rc.bad++;
+  if(rc.range!=RANGES-1 || rc.pos!=r[RANGES*2-1])rc.bad++;
+  ov_clear(&vf);
+  return rc.bad;
+}
+
+static int packets(stream *s){
+  OggVorbis_File vf;
+  ogg_int64_t sum[LINKS];
+  int i,bad=0;
+
+  memset(sum,0,sizeof(sum));
+  if(open_seekable(s,&vf))return 1;
+  for(;;){
+    ogg_packet op;
+    long samples;
+    int link,ret=ov_read_packet(&vf,&op,NULL,&samples,&link);
+    if(ret==0)break;
+    if(ret<0 || link<0 || link>=LINKS){
+      bad++;
+      break;
+    }
+    sum[link]+=samples;
+  }
+  for(i=0;i<LINKS;i++)
+    if(sum[i]!=ov_pcm_total(&vf,i)){
+      printf("Error : link %d packets complete %ld samples, not %ld\n",
+             i,(long)sum[i],(long)ov_pcm_total(&vf,i));
+      bad++;
+    }
+  ov_clear(&vf);
+  return bad;
+}
+
+static int scan(stream *s,decode *d){
+  ov_callbacks callbacks={read_func,NULL,NULL,NULL};
+  ov_scan_link links[LINKS];
+  int i,bad=0;
+
+  s->pos=0;
+  if(ov_scan_callbacks(s,callbacks,links,LINKS)!=LINKS)return 1;
+  for(i=0;i<LINKS;i++)
+    if(links[i].pcmlength!=d->length[i] ||
+       links[i].rate!=setups[i].rate ||
+       links[i].channels!=setups[i].channels ||
+       links[i].serialno!=1000+i){
+      printf("Error : link %d scans as %ld samples, decodes to %ld\n",
+             i,(long)links[i].pcmlength,d->length[i]);
+      bad++;
+    }
+  return bad;
+}
+
+static int streaming(stream *s,decode *d){
+  ov_callbacks callbacks={read_func,NULL,NULL,NULL};
+  OggVorbis_File vf;
+  long got[LINKS];
+  int link=0,bad=0;
+
+  memset(got,0,sizeof(got));
+  s->pos=0;
+  if(ov_open_callbacks(s,&vf,NULL,0,callbacks))return 1;
+  for(;;){
+    float **pcm;
+    int bitstream;
+    long n=ov_read_float(&vf,&pcm,1024,&bitstream);
+    if(n==0)break;
+    if(n==OV_HOLE)continue;
+    if(n<0){
+      bad++;
+      break;
+    }
+    /* an unseekable stream numbers the links it has met */
+    if(bitstream!=link){
+      if(got[link]!=d->length[link])bad++;
+      link++;
+      if(link>=LINKS){
+        bad++;
+        break;
+      }
+    }
+    if(!matches(d,d->start[link]+got[link],pcm,ov_info(&vf,-1)->channels,
+                n)){
+      bad++;
+      break;
+    }
+    got[link]+=n;
+  }
+  if(link!=LINKS-1 || got[link]!=d->length[link])bad++;
+  ov_clear(&vf);
+  return bad;
+}
+
+/* comment 1 of each link is the long one */
+static int comments(stream *s){
+  ov_callbacks seekable={read_func,seek_func,NULL,tell_func};
+  ov_callbacks unseekable={read_func,NULL,NULL,NULL};
+  OggVorbis_File vf;
+  char want[LIMIT+1000*LINKS+64],got[LIMIT+1000*LINKS+64];
+  int i,bad=0;
+
+  s->pos=0;
+  if(ov_open_callbacks_limit(s,&vf,NULL,0,seekable,LIMIT))return 1;
+  for(i=0;i<LINKS;i++){
+    vorbis_comment *vc=ov_comment(&vf,i);
+    long n=long_comment(i,want);
+    if(vc->comments!=2 ||
+       strcmp(vc->user_comments[0],"TITLE=chain test") ||
+       strcmp(vc->user_comments[1],"PICTURE=") ||
+       ov_comment_fetch(&vf,i,1,NULL,0)!=n ||
+       ov_comment_fetch(&vf,i,1,got,sizeof(got))!=n ||
+       memcmp(got,want,n)){
+      printf("Error : link %d long comment not fetched whole\n",i);
+      bad++;
+    }
+  }
+  ov_clear(&vf);
+
+  s->pos=0;
+  if(ov_open_callbacks_limit(s,&vf,NULL,0,unseekable,LIMIT))return bad+1;
+  if(ov_comment_fetch(&vf,-1,1,NULL,0)!=long_comment(0,want) ||
+     ov_comment_fetch(&vf,-1,1,got,sizeof(got))!=OV_ENOSEEK){
+    printf("Error : long comment fetched from an unseekable stream\n");
+    bad++;
+  }
+  ov_clear(&vf);
+  return bad;
+}
+
+int main(void){
+  stream s;
+  decode d;
+  int i,j,bad,errors=0;
+
+  memset(&s,0,sizeof(s));
+  for(i=0;i<LINKS;i++)encode_link(&s,i);
+  if(linear(&s,&d)){
+    printf("Error : linear decode of the chain failed\n");
+    exit(1);
+  }
+  printf("    %d links              : %ld bytes, %ld samples\n",LINKS,
+         s.bytes,(long)d.start[LINKS]);
+
+  bad=seeks(&s,&d,0);
+  printf("    %d seeks           : %d mismatched\n",SEEKS,bad);
+  errors+=bad;
+
+  bad=seeks(&s,&d,1);
+  printf("    %d seeks, 1 setup  : %d mismatched\n",SEEKS,bad);
+  errors+=bad;
+
+  bad=ranges(&s,&d);
+  printf("    %d ranges           : %d mismatched\n",RANGES,bad);
+  errors+=bad;
+
+  bad=packets(&s);
+  printf("    packet sample sums   : %d mismatched\n",bad);
+  errors+=bad;
+
+  bad=scan(&s,&d);
+  printf("    scanned lengths      : %d mismatched\n",bad);
+  errors+=bad;
+
+  bad=streaming(&s,&d);
+  printf("    unseekable decode    : %d mismatched\n",bad);
+  errors+=bad;
+
+  bad=comments(&s);
+  printf("    limited comments     : %d mismatched\n",bad);
+  errors+=bad;
+
+  for(i=0;i<LINKS;i++)
+    for(j=0;j<2;j++)free(d.pcm[i][j]);
+  free(s.data);
+
+  if(errors)
+    exit(1);
+  puts("    ok");
+  return 0;
+}
@@ -0,0 +1,151 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: bitrate management lookahead test; a lookahead does not
+           swing the bitrate more than none
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* Audio alternating between sparse tones and dense noise every few
+   seconds is encoded in ABR mode with several
+   OV_ECTL_RATEMANAGE_LOOKAHEAD_SET settings.  The standard deviation
+   of the bitrate over one second windows with each lookahead must be
+   no more than that without one, and the average must still meet the
+   target. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vorbis/codec.h>
+#include <vorbis/vorbisenc.h>
+
+#define RATE     44100
+#define SAMPLES  (RATE*30)
+#define TARGET   96000
+#define SLACK    1.05  /* for float differences between builds */
+
+static void synth(float **buffer,long pos,long n,unsigned long *lcg){
+  long i;
+  for(i=0;i<n;i++){
+    double t=(double)(pos+i)/RATE;
+    int dense=((long)(t*.7+sin(t*.3))&1);
+    float noise;
+    *lcg=*lcg*1664525UL+1013904223UL;
+    noise=((*lcg>>8)&0xffff)/32768.f-1.f;
+    if(dense){
+      buffer[0][i]=.2f*noise+.1f*sin(2.*M_PI*880.*t);
+      buffer[1][i]=.2f*noise*(1.+sin(2.*M_PI*3.*t))*.5f;
+    }else{
+      buffer[0][i]=.3f*sin(2.*M_PI*440.*t)+.01f*noise;
+      buffer[1][i]=.3f*sin(2.*M_PI*660.*t)+.01f*noise;
+    }
+  }
+}
+
+/* returns the one second stddev in kbps, or -1 on failure */
+static double encode(int lookahead,double *kbps){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op,h[3];
+  unsigned long lcg=1;
+  long pos=0,bytes=0,window=0,windowbits=0;
+  double sum=0.,sumsq=0.,mean;
+  int ended=0;
+
+  vorbis_info_init(&vi);
+  if(vorbis_encode_setup_managed(&vi,2,RATE,-1,TARGET,-1) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_RATEMANAGE_LOOKAHEAD_SET,&lookahead) ||
+     vorbis_encode_setup_init(&vi)){
+    vorbis_info_clear(&vi);
+    return -1;
+  }
+  vorbis_comment_init(&vc);
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  vorbis_analysis_headerout(&vd,&vc,h,h+1,h+2);
+
+  while(!ended){
+    if(pos<SAMPLES){
+      long n=SAMPLES-pos;
+      if(n>1024)n=1024;
+      synth(vorbis_analysis_buffer(&vd,n),pos,n,&lcg);
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else
+      vorbis_analysis_wrote(&vd,0);
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        bytes+=op.bytes;
+        /* the partial last window is left out */
+        while(op.granulepos>=(window+1)*(ogg_int64_t)RATE){
+          sum+=windowbits/1000.;
+          sumsq+=windowbits/1000.*(windowbits/1000.);
+          windowbits=0;
+          window++;
+        }
+        windowbits+=op.bytes*8;
+        if(op.e_o_s)ended=1;
+      }
+    }
+  }
+
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+
+  *kbps=bytes*8./SAMPLES*RATE/1000.;
+  if(!window)return -1;
+  mean=sum/window;
+  return sqrt(sumsq/window-mean*mean);
+}
+
+int main(void){
+  static const int lookahead[]={0,4,16,64};
+  double none=0.;
+  int i,errors=0;
+
+  for(i=0;i<(int)(sizeof(lookahead)/sizeof(*lookahead));i++){
+    double kbps,sd=encode(lookahead[i],&kbps);
+    printf("    lookahead %-3d        : %.1f kbps, 1s stddev %.2f\n",
+           lookahead[i],kbps,sd);
+    if(sd<0){
+      printf("Error : encode failed\n");
+      errors++;
+      continue;
+    }
+    if(fabs(kbps*1000.-TARGET)>TARGET*.02){
+      printf("Error : average %.1f kbps misses the target\n",kbps);
+      errors++;
+    }
+    if(i==0)
+      none=sd;
+    else if(sd>none*SLACK){
+      printf("Error : 1s stddev %.2f exceeds %.2f without lookahead\n",
+             sd,none);
+      errors++;
+    }
+  }
+
+  if(errors)
+    exit(1);
+  puts("    ok");
+  return 0;
+}
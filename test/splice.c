@@ -0,0 +1,354 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: chunked encoding test; splices decode without a seam
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* The same audio is encoded by one encoder and in chunks by an
+   encoder each (vorbis_analysis_prime()/vorbis_analysis_splice()),
+   the chunks are joined into one stream (vorbis_analysis_join()) and
+   both streams are decoded.  The chunked stream must decode to the
+   same length, with granulepos continuous.  A seam shows as coding
+   error around the splice points far above the single encoder's
+   typical error; the short blocks on the splice cost a few times
+   that at most. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vorbis/codec.h>
+#include <vorbis/vorbisenc.h>
+
+#define RATE     44100
+#define CHANNELS 2
+#define SAMPLES  (RATE*8)
+#define CHUNKS   5
+#define WINDOW   512
+
+typedef struct {
+  ogg_packet *packets;
+  long        count;
+  long        storage;
+} packet_list;
+
+static void add_packet(packet_list *l,ogg_packet *op){
+  ogg_packet *p;
+  if(l->count>=l->storage){
+    l->storage=l->storage*2+64;
+    l->packets=realloc(l->packets,l->storage*sizeof(*l->packets));
+  }
+  p=l->packets+l->count++;
+  *p=*op;
+  p->packet=malloc(op->bytes);
+  memcpy(p->packet,op->packet,op->bytes);
+}
+
+static void clear_packets(packet_list *l){
+  long i;
+  for(i=0;i<l->count;i++)free(l->packets[i].packet);
+  free(l->packets);
+  memset(l,0,sizeof(*l));
+}
+
+/* tones, a slow sweep and noise bursts, so that the encoder switches
+   between short and long blocks.  The bursts keep well clear of the
+   splice points, where the error is measured. */
+static void gen_input(float **pcm){
+  unsigned long lcg=1;
+  long i;
+  for(i=0;i<SAMPLES;i++){
+    double t=(double)i/RATE;
+    double burst=fmod(t+.2,.4)<.02?.5:0.;
+    double noise;
+    lcg=lcg*1664525UL+1013904223UL;
+    noise=((lcg>>8)&0xffff)/32768.-1.;
+    pcm[0][i]=.3*sin(2.*M_PI*440.*t)+.1*sin(2.*M_PI*(200.+300.*t)*t)+
+      burst*noise;
+    pcm[1][i]=.3*sin(2.*M_PI*660.*t)+.1*sin(2.*M_PI*3000.*t)+
+      burst*noise*.7;
+  }
+}
+
+/* encode input [begin,end) with its own encoder; begin>0 primes it,
+   end<SAMPLES splices it */
+static int encode_chunk(vorbis_info *vi,float **pcm,long begin,long end,
+                        packet_list *out,packet_list *headers){
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op;
+  long pos=begin;
+  int i,ret=0,ended=0;
+
+  vorbis_analysis_init(&vd,vi);
+  vorbis_block_init(&vd,&vb);
+
+  if(headers){
+    vorbis_comment   vc;
+    ogg_packet       h[3];
+    vorbis_comment_init(&vc);
+    vorbis_analysis_headerout(&vd,&vc,h,h+1,h+2);
+    for(i=0;i<3;i++)add_packet(headers,h+i);
+    vorbis_comment_clear(&vc);
+  }
+
+  if(begin>0){
+    float *history[CHANNELS];
+    for(i=0;i<CHANNELS;i++)history[i]=pcm[i];
+    if(vorbis_analysis_prime(&vd,history,begin,begin)){
+      printf("vorbis_analysis_prime failed\n");
+      ret=1;
+      goto done;
+    }
+  }
+
+  for(;;){
+    if(pos<end){
+      long n=end-pos;
+      float **buffer;
+      if(n>1024)n=1024;
+      buffer=vorbis_analysis_buffer(&vd,n);
+      for(i=0;i<CHANNELS;i++)
+        memcpy(buffer[i],pcm[i]+pos,n*sizeof(**buffer));
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else if(ended)
+      break;
+    else if(end<SAMPLES){
+      float *lookahead[CHANNELS];
+      long n=SAMPLES-end;
+      for(i=0;i<CHANNELS;i++)lookahead[i]=pcm[i]+end;
+      if(n>2048)n=2048;
+      if(vorbis_analysis_splice(&vd,lookahead,n)){
+        printf("vorbis_analysis_splice failed\n");
+        ret=1;
+        goto done;
+      }
+      ended=1;
+    }else{
+      vorbis_analysis_wrote(&vd,0);
+      ended=1;
+    }
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op))
+        add_packet(out,&op);
+    }
+  }
+
+ done:
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  return ret;
+}
+
+/* run the packets through an Ogg stream and decode the pages */
+static long decode(packet_list *l,float **out,ogg_int64_t *lastgranule){
+  ogg_stream_state os,is;
+  ogg_sync_state   oy;
+  ogg_page         og;
+  ogg_packet       op;
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  long i,got=0;
+  int packets=0;
+
+  ogg_stream_init(&os,1);
+  ogg_stream_init(&is,1);
+  ogg_sync_init(&oy);
+  vorbis_info_init(&vi);
+  vorbis_comment_init(&vc);
+  *lastgranule=-1;
+
+  for(i=0;i<l->count;i++){
+    ogg_stream_packetin(&os,l->packets+i);
+    while(i<3?ogg_stream_flush(&os,&og):ogg_stream_pageout(&os,&og)){
+      char *buffer=ogg_sync_buffer(&oy,og.header_len+og.body_len);
+      memcpy(buffer,og.header,og.header_len);
+      memcpy(buffer+og.header_len,og.body,og.body_len);
+      ogg_sync_wrote(&oy,og.header_len+og.body_len);
+    }
+  }
+  while(ogg_stream_flush(&os,&og)){
+    char *buffer=ogg_sync_buffer(&oy,og.header_len+og.body_len);
+    memcpy(buffer,og.header,og.header_len);
+    memcpy(buffer+og.header_len,og.body,og.body_len);
+    ogg_sync_wrote(&oy,og.header_len+og.body_len);
+  }
+
+  while(ogg_sync_pageout(&oy,&og)==1){
+    ogg_stream_pagein(&is,&og);
+    while(ogg_stream_packetout(&is,&op)==1){
+      if(packets<3){
+        if(vorbis_synthesis_headerin(&vi,&vc,&op))return -1;
+        if(++packets==3){
+          vorbis_synthesis_init(&vd,&vi);
+          vorbis_block_init(&vd,&vb);
+        }
+        continue;
+      }
+      if(op.granulepos!=-1)*lastgranule=op.granulepos;
+      if(vorbis_synthesis(&vb,&op)==0)
+        vorbis_synthesis_blockin(&vd,&vb);
+      {
+        float **pcm;
+        long n;
+        while((n=vorbis_synthesis_pcmout(&vd,&pcm))>0){
+          if(got+n>SAMPLES)n=SAMPLES-got;
+          for(i=0;i<CHANNELS;i++)
+            memcpy(out[i]+got,pcm[i],n*sizeof(**pcm));
+          got+=n;
+          vorbis_synthesis_read(&vd,n);
+          if(got==SAMPLES)break;
+        }
+      }
+    }
+  }
+
+  if(packets==3){
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+  }
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  ogg_sync_clear(&oy);
+  ogg_stream_clear(&is);
+  ogg_stream_clear(&os);
+  return got;
+}
+
+/* rms coding error of the WINDOW samples from pos */
+static double window_error(float **in,float **out,long pos){
+  double sum=0.;
+  long i;
+  int j;
+  for(j=0;j<CHANNELS;j++)
+    for(i=pos;i<pos+WINDOW;i++){
+      double d=out[j][i]-in[j][i];
+      sum+=d*d;
+    }
+  return sqrt(sum/(WINDOW*CHANNELS));
+}
+
+static int compare_double(const void *a,const void *b){
+  double da=*(const double *)a,db=*(const double *)b;
+  return (da>db)-(da<db);
+}
+
+int main(void){
+  float *in[CHANNELS],*single[CHANNELS],*chunked[CHANNELS];
+  packet_list one,joined;
+  packet_list chunks[CHUNKS];
+  long splice[CHUNKS+1];
+  vorbis_info vi;
+  ogg_int64_t granule;
+  double *errors_single,typical,worst_splice=0.;
+  long half,i,n;
+  int j,k,errors=0;
+
+  for(j=0;j<CHANNELS;j++){
+    in[j]=malloc(SAMPLES*sizeof(*in[j]));
+    single[j]=calloc(SAMPLES,sizeof(*single[j]));
+    chunked[j]=calloc(SAMPLES,sizeof(*chunked[j]));
+  }
+  gen_input(in);
+  memset(&one,0,sizeof(one));
+  memset(&joined,0,sizeof(joined));
+  memset(chunks,0,sizeof(chunks));
+
+  vorbis_info_init(&vi);
+  if(vorbis_encode_init_vbr(&vi,CHANNELS,RATE,.4f)){
+    printf("vorbis_encode_init_vbr failed\n");
+    return 1;
+  }
+
+  /* splice points on the short block grid */
+  half=vorbis_info_blocksize(&vi,0)/2;
+  for(k=0;k<=CHUNKS;k++)
+    splice[k]=(long)SAMPLES*k/CHUNKS/half*half;
+  splice[CHUNKS]=SAMPLES;
+
+  printf("    single encoder       : ");
+  if(encode_chunk(&vi,in,0,SAMPLES,&one,&one))return 1;
+  n=decode(&one,single,&granule);
+  printf("%ld packets, %ld samples\n",one.count,n);
+
+  printf("    %d chunks            : ",CHUNKS);
+  for(k=0;k<CHUNKS;k++)
+    if(encode_chunk(&vi,in,splice[k],splice[k+1],chunks+k,
+                    k==0?&joined:NULL))return 1;
+
+  /* join; the packet data moves to the joined list */
+  for(k=0;k<CHUNKS;k++){
+    if(k>0 && vorbis_analysis_join(&vi,joined.packets+joined.count-1,
+                                   chunks[k].packets)){
+      printf("vorbis_analysis_join failed at chunk %d\n",k);
+      errors++;
+    }
+    for(i=0;i<chunks[k].count;i++){
+      add_packet(&joined,chunks[k].packets+i);
+      if(i>0 && chunks[k].packets[i].granulepos<
+         chunks[k].packets[i-1].granulepos)
+        errors++;
+    }
+    clear_packets(chunks+k);
+  }
+  n=decode(&joined,chunked,&granule);
+  printf("%ld packets, %ld samples\n",joined.count,n);
+
+  if(n!=SAMPLES || granule!=SAMPLES){
+    printf("Error : decoded %ld samples, last granulepos %ld, expected %d\n",
+           n,(long)granule,SAMPLES);
+    errors++;
+  }
+
+  /* typical coding error of the single encoder, and the worst of the
+     chunked one around the splices */
+  errors_single=malloc(SAMPLES/WINDOW*sizeof(*errors_single));
+  for(n=0,i=WINDOW;i+2*WINDOW<SAMPLES;i+=WINDOW)
+    errors_single[n++]=window_error(in,single,i);
+  qsort(errors_single,n,sizeof(*errors_single),compare_double);
+  typical=errors_single[n/2];
+  free(errors_single);
+  for(k=1;k<CHUNKS;k++)
+    for(i=splice[k]-2*WINDOW;i<splice[k]+2*WINDOW;i+=WINDOW/4){
+      double e=window_error(in,chunked,i);
+      if(e>worst_splice)worst_splice=e;
+    }
+  printf("    rms error            : %f single median, %f at splices\n",
+         typical,worst_splice);
+  if(worst_splice>typical*15){
+    printf("Error : audible seam at a splice point\n");
+    errors++;
+  }
+
+  clear_packets(&one);
+  clear_packets(&joined);
+  vorbis_info_clear(&vi);
+  for(j=0;j<CHANNELS;j++){
+    free(in[j]);
+    free(single[j]);
+    free(chunked[j]);
+  }
+
+  if(errors)
+    exit(1);
+  puts("    ok");
+  return 0;
+}
@@ -0,0 +1,165 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis SOFTWARE CODEC SOURCE CODE.   *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis SOURCE CODE IS (C) COPYRIGHT 1994-2015             *
+ * by the Xiph.Org Foundation http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: two pass encoding test; the second pass meets its target
+           size
+ last mod: $Id$
+
+ ********************************************************************/
+
+/* Tones over noise with louder bursts are encoded in two passes at several
+   nominal bitrates, the second pass targeting that bitrate over the
+   whole stream.  The audio packets must total the target within a
+   small tolerance.  A second pass over different audio than the first
+   saw must still finish, coding the blocks that no longer match the
+   statistics at the plan's lower level rather than chasing or padding
+   up to the target. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vorbis/codec.h>
+#include <vorbis/vorbisenc.h>
+
+#define RATE      44100
+#define SAMPLES   (RATE*10)
+#define TOLERANCE .005 /* of the target */
+
+/* noise under the tones throughout, so that every nominal bitrate
+   tested lies within the range the quality steps cover */
+static void synth(float **buffer,long pos,long n,double burstat){
+  unsigned long lcg=pos*2654435761UL+1;
+  long i;
+  for(i=0;i<n;i++){
+    double t=(double)(pos+i)/RATE;
+    double level=fmod(t+burstat,.7)<.1?.4:.1;
+    double noise;
+    lcg=lcg*1664525UL+1013904223UL;
+    noise=((lcg>>8)&0xffff)/32768.-1.;
+    buffer[0][i]=.3*sin(2.*M_PI*440.*t)+level*noise;
+    buffer[1][i]=.3*sin(2.*M_PI*660.*t)+level*noise*.7;
+  }
+}
+
+/* returns the audio bytes of the stream, or -1 on failure */
+static ogg_int64_t encode(int pass,long kbps,ogg_int64_t target,
+                          double burstat,void **stats,long *stats_bytes){
+  vorbis_info      vi;
+  vorbis_comment   vc;
+  vorbis_dsp_state vd;
+  vorbis_block     vb;
+  ogg_packet       op,h[3];
+  struct ovectl_twopass_arg tp;
+  ogg_int64_t bytes=0;
+  long pos=0;
+  int ended=0;
+
+  memset(&tp,0,sizeof(tp));
+  tp.pass=pass;
+  tp.target_bytes=target;
+  if(pass==2){
+    tp.stats=*stats;
+    tp.stats_bytes=*stats_bytes;
+  }
+
+  vorbis_info_init(&vi);
+  if(vorbis_encode_setup_managed(&vi,2,RATE,-1,kbps*1000,-1) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_RATEMANAGE2_SET,NULL) ||
+     vorbis_encode_ctl(&vi,OV_ECTL_TWOPASS_SET,&tp) ||
+     vorbis_encode_setup_init(&vi)){
+    vorbis_info_clear(&vi);
+    return -1;
+  }
+  vorbis_comment_init(&vc);
+  vorbis_analysis_init(&vd,&vi);
+  vorbis_block_init(&vd,&vb);
+  vorbis_analysis_headerout(&vd,&vc,h,h+1,h+2);
+
+  while(!ended){
+    if(pos<SAMPLES){
+      long n=SAMPLES-pos;
+      if(n>1024)n=1024;
+      synth(vorbis_analysis_buffer(&vd,n),pos,n,burstat);
+      vorbis_analysis_wrote(&vd,n);
+      pos+=n;
+    }else
+      vorbis_analysis_wrote(&vd,0);
+
+    while(vorbis_analysis_blockout(&vd,&vb)==1){
+      vorbis_analysis(&vb,NULL);
+      vorbis_bitrate_addblock(&vb);
+      while(vorbis_bitrate_flushpacket(&vd,&op)){
+        bytes+=op.bytes;
+        if(op.e_o_s)ended=1;
+      }
+    }
+  }
+
+  if(pass==1){
+    *stats_bytes=vorbis_bitrate_twopass_stats(&vd,NULL,0);
+    *stats=malloc(*stats_bytes);
+    if(*stats_bytes<=0 ||
+       vorbis_bitrate_twopass_stats(&vd,*stats,*stats_bytes)!=*stats_bytes)
+      bytes=-1;
+  }
+
+  vorbis_block_clear(&vb);
+  vorbis_dsp_clear(&vd);
+  vorbis_comment_clear(&vc);
+  vorbis_info_clear(&vi);
+  return bytes;
+}
+
+int main(void){
+  static const long kbps[]={64,128,192};
+  int i,errors=0;
+
+  for(i=0;i<(int)(sizeof(kbps)/sizeof(*kbps));i++){
+    ogg_int64_t target=(ogg_int64_t)kbps[i]*1000/8*SAMPLES/RATE;
+    ogg_int64_t first,second,other;
+    void *stats=NULL;
+    long stats_bytes=0;
+    double off;
+
+    first=encode(1,kbps[i],0,0.,&stats,&stats_bytes);
+    second=encode(2,kbps[i],target,0.,&stats,&stats_bytes);
+    other=encode(2,kbps[i],target,.35,&stats,&stats_bytes);
+    free(stats);
+    if(first<0 || second<0 || other<0){
+      printf("Error : %ld kbps encode failed\n",kbps[i]);
+      errors++;
+      continue;
+    }
+
+    off=(double)(second-target)/target;
+    printf("    %3ld kbps             : first pass %ld, target %ld, "
+           "second pass %ld (%+.2f%%), other audio %ld\n",
+           kbps[i],(long)first,(long)target,(long)second,off*100.,
+           (long)other);
+    if(fabs(off)>TOLERANCE){
+      printf("Error : second pass misses the target by %.2f%%\n",off*100.);
+      errors++;
+    }
+    if(other>target){
+      printf("Error : second pass over other audio overshoots to %ld\n",
+             (long)other);
+      errors++;
+    }
+  }
+
+  if(errors)
+    exit(1);
+  puts("    ok");
+  return 0;
+}